@@ -4,25 +4,28 @@
  */
 
 #include "../include/medical_vision/image_preprocessor.hpp"
+#include "../include/medical_vision/pipeline.hpp"
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <iostream>
 #include <filesystem>
 #include <vector>
 #include <algorithm>
-
-// Processing method to test
-void processImage(medical_vision::ImagePreprocessor& processor) {
-    // Example: Chain of processing methods
-    processor.normalize();
-    processor.clahe(2.0);
-    processor.sharpen(1.2);
-    
-    // Alternative examples (commented out):
-    // processor.denoise(medical_vision::ImagePreprocessor::NoiseReductionMethod::BILATERAL);
-    // processor.histogramProcessing(medical_vision::ImagePreprocessor::HistogramMethod::EQUALIZATION);
-    // processor.unsharpMask(1.0, 1.5);
-}
+#include <memory>
+
+// Processing chain to test, used when no spec file is given
+const char* DEFAULT_PIPELINE = R"({
+    "steps": [
+        { "op": "normalize", "min": 0, "max": 255 },
+        { "op": "clahe", "clip_limit": 2.0 },
+        { "op": "sharpen", "strength": 1.2 }
+    ]
+})";
+
+// Alternative steps:
+//     { "op": "bilateral" }
+//     { "op": "equalize" }
+//     { "op": "unsharp_mask", "sigma": 1.0, "strength": 1.5 }
 
 /**
  * @brief Create side-by-side comparison view
@@ -73,7 +76,17 @@ cv::Mat createComparisonView(const cv::Mat& original, const cv::Mat& processed,
     return output;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Pipeline from the spec file given on the command line, if any
+    medical_vision::PipelineSpec spec;
+    try {
+        spec = argc > 1 ? medical_vision::PipelineSpec::load(argv[1])
+                        : medical_vision::PipelineSpec::parse(DEFAULT_PIPELINE);
+    } catch (const std::exception& e) {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+
     // Create window with fixed size
     cv::namedWindow("Display", cv::WINDOW_NORMAL);
     cv::resizeWindow("Display", 1280, 1024);
@@ -98,6 +111,7 @@ int main() {
     }
 
     medical_vision::ImagePreprocessor processor;
+    std::unique_ptr<medical_vision::PipelinePlan> plan;
     size_t currentImageIndex = 0;
     
     // Main processing loop
@@ -108,13 +122,25 @@ int main() {
             continue;
         }
 
-        // Process image
-        processImage(processor);
+        // Plan once, again only when the image format changes
+        const cv::Mat& original = processor.getOriginalImage();
+        cv::Mat processed;
+        try {
+            medical_vision::ImageFormat format = medical_vision::ImageFormat::of(original);
+            if (!plan || plan->inputFormat() != format) {
+                plan = std::make_unique<medical_vision::PipelinePlan>(spec, format, original.size());
+                std::cout << plan->describe() << std::endl;
+            }
+            processed = plan->run(original);
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return -1;
+        }
 
         // Create comparison view
         cv::Mat display = createComparisonView(
-            processor.getOriginalImage(),
-            processor.getImage(),
+            original,
+            processed,
             "Original",
             "Processed"
         );
@@ -0,0 +1,46 @@
+#include "analysis_worker.hpp"
+
+AnalysisWorker::AnalysisWorker(QObject* parent)
+    : QObject(parent) {
+    qRegisterMetaType<medical_vision::ChestXRayAnalyzer::AnalysisResult>();
+}
+
+void AnalysisWorker::loadModel(const medical_vision::ChestXRayAnalyzer::ModelConfig& config) {
+    try {
+        if (chest_analyzer.loadModel(config)) {
+            emit modelLoaded(true, tr("Model loaded successfully"));
+            return;
+        }
+        emit modelLoaded(false, tr("Failed to load model"));
+    }
+    catch (const std::exception& e) {
+        emit modelLoaded(false, tr("Failed to load model: %1").arg(e.what()));
+    }
+}
+
+void AnalysisWorker::analyze(const cv::Mat& image, quint64 requestId, bool lungsOnly) {
+    // Superseded while waiting in the queue
+    if (requestId != latestRequest.load()) return;
+
+    // No lungs found leaves an empty region, the full image
+    cv::Rect region;
+    if (lungsOnly) {
+        try {
+            region = medical_vision::Segmentation::maskBounds(segmentation.lungMask(image), LUNG_MARGIN);
+        }
+        catch (const std::exception&) {
+            // Analyzed in full, as without lungsOnly
+        }
+    }
+
+    auto result = chest_analyzer.analyze(image, region, [this, requestId](float fraction) {
+        emit progressChanged(requestId, static_cast<int>(fraction * 100.0f));
+        return requestId == latestRequest.load();
+    });
+
+    emit analysisFinished(requestId, result);
+}
+
+void AnalysisWorker::setConfidenceThreshold(float threshold) {
+    chest_analyzer.setConfidenceThreshold(threshold);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QtCore/QMetaType>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <atomic>
+#include "../include/medical_vision/chest_x_ray_analyzer.hpp"
+#include "../include/medical_vision/segmentation.hpp"
+
+Q_DECLARE_METATYPE(medical_vision::ChestXRayAnalyzer::AnalysisResult)
+
+/**
+ * @brief Runs ChestXRayAnalyzer on a dedicated thread
+ *
+ * The worker owns the analyzer and must be moved to a worker thread. Slots
+ * are invoked through queued connections and results come back as queued
+ * signals. Every analysis is tagged with a request id; a request is cancelled
+ * as soon as it is no longer the latest one (see setLatestRequest).
+ * With lungsOnly, only the bounds of Segmentation::lungMask are analyzed.
+ */
+class AnalysisWorker : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AnalysisWorker(QObject* parent = nullptr);
+    ~AnalysisWorker() = default;
+
+    // Thread-safe: marks which request is wanted, 0 cancels everything
+    void setLatestRequest(quint64 requestId) { latestRequest.store(requestId); }
+
+public slots:
+    void loadModel(const medical_vision::ChestXRayAnalyzer::ModelConfig& config);
+    void analyze(const cv::Mat& image, quint64 requestId, bool lungsOnly = false);
+    void setConfidenceThreshold(float threshold);
+
+signals:
+    void modelLoaded(bool success, const QString& message);
+    void progressChanged(quint64 requestId, int percent);
+    void analysisFinished(quint64 requestId,
+                          const medical_vision::ChestXRayAnalyzer::AnalysisResult& result);
+
+private:
+    medical_vision::ChestXRayAnalyzer chest_analyzer;
+    medical_vision::Segmentation segmentation;
+    std::atomic<quint64> latestRequest{0};
+
+    // Context kept around the lungs, in pixels
+    static constexpr int LUNG_MARGIN = 16;
+};
@@ -0,0 +1,213 @@
+#include "folder_indexer.hpp"
+#include "../include/medical_vision/dicom_image.hpp"
+#include "../include/medical_vision/image_cache.hpp"
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QThread>
+#include <QtGui/QImageReader>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+namespace {
+// PNG text key holding the full resolution size of a cached thumbnail
+const char* SOURCE_SIZE_KEY = "SourceSize";
+}
+
+FolderIndexer::FolderIndexer(QObject* parent)
+    : QObject(parent) {
+    // Leave one core to the GUI and the processing pipeline
+    pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+
+    cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + "/thumbnails";
+    QDir().mkpath(cacheDirectory);
+}
+
+FolderIndexer::~FolderIndexer() {
+    cancel();
+    pool.waitForDone();
+}
+
+QStringList FolderIndexer::nameFilters() {
+    return {"*.jpg", "*.jpeg", "*.png", "*.tif", "*.tiff", "*.dcm", "*.dicom", "*.mvc"};
+}
+
+void FolderIndexer::open(const QString& directory) {
+    cancel();
+    folderEntries.clear();
+    pendingThumbnails = 0;
+
+    const quint64 generation = currentGeneration.load();
+    pool.start([this, directory, generation]() {
+        scanFolder(directory, generation);
+    });
+}
+
+void FolderIndexer::cancel() {
+    // Queued tasks are dropped, running ones notice the generation change
+    ++currentGeneration;
+    pool.clear();
+}
+
+void FolderIndexer::scanFolder(const QString& directory, quint64 generation) {
+    QDir selectedDir(directory);
+    const QFileInfoList files = selectedDir.entryInfoList(
+        nameFilters(), QDir::Files, QDir::Name);
+
+    QVector<Entry> scanned;
+    scanned.reserve(files.size());
+    for (const QFileInfo& info : files) {
+        if (generation != currentGeneration.load()) return;
+        scanned.push_back({info.absoluteFilePath(),
+                           info.lastModified().toMSecsSinceEpoch(),
+                           QSize()});
+    }
+
+    QMetaObject::invokeMethod(this, [this, scanned, generation]() {
+        if (generation != currentGeneration.load()) return;
+
+        folderEntries = scanned;
+        QStringList paths;
+        paths.reserve(folderEntries.size());
+        for (const auto& entry : folderEntries) {
+            paths << entry.path;
+        }
+        emit folderScanned(paths);
+        scheduleThumbnails(generation);
+    }, Qt::QueuedConnection);
+}
+
+void FolderIndexer::scheduleThumbnails(quint64 generation) {
+    pendingThumbnails = folderEntries.size();
+    if (pendingThumbnails == 0) {
+        emit indexingFinished();
+        return;
+    }
+
+    for (int i = 0; i < folderEntries.size(); ++i) {
+        Entry entry = folderEntries[i];
+        pool.start([this, i, entry, generation]() {
+            indexEntry(i, entry, generation);
+        });
+    }
+}
+
+void FolderIndexer::indexEntry(int index, const Entry& entry, quint64 generation) {
+    if (generation != currentGeneration.load()) return;
+
+    QSize imageSize;
+    QImage thumbnail;
+    const QString cachePath = cacheFilePath(entry);
+
+    // Cached thumbnails carry the source size when it is known, no need to
+    // touch the image. An empty cache file marks an image that could not be
+    // read, which is not retried until the file changes.
+    const QFileInfo cacheInfo(cachePath);
+    bool cached = false;
+    if (cacheInfo.exists()) {
+        cached = cacheInfo.size() == 0 || thumbnail.load(cachePath, "PNG");
+        const QStringList dims = thumbnail.text(SOURCE_SIZE_KEY).split('x');
+        if (dims.size() == 2) {
+            imageSize = QSize(dims[0].toInt(), dims[1].toInt());
+        }
+    }
+
+    if (!cached) {
+        thumbnail = loadThumbnail(entry.path, imageSize);
+        if (thumbnail.isNull()) {
+            QFile(cachePath).open(QIODevice::WriteOnly);
+        } else {
+            if (imageSize.isValid()) {
+                thumbnail.setText(SOURCE_SIZE_KEY,
+                    QString("%1x%2").arg(imageSize.width()).arg(imageSize.height()));
+            }
+            thumbnail.save(cachePath, "PNG");
+        }
+    }
+
+    QMetaObject::invokeMethod(this, [this, index, imageSize, thumbnail, generation]() {
+        if (generation != currentGeneration.load()) return;
+
+        if (index < folderEntries.size()) {
+            folderEntries[index].imageSize = imageSize;
+            emit entryIndexed(index, imageSize);
+        }
+        if (!thumbnail.isNull()) {
+            emit thumbnailReady(index, thumbnail);
+        }
+        if (--pendingThumbnails == 0) {
+            emit indexingFinished();
+        }
+    }, Qt::QueuedConnection);
+}
+
+QString FolderIndexer::cacheFilePath(const Entry& entry) const {
+    QByteArray key = entry.path.toUtf8();
+    key += '|' + QByteArray::number(entry.modified);
+    key += '|' + QByteArray::number(THUMBNAIL_SIZE);
+
+    const QByteArray hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return cacheDirectory + '/' + QString::fromLatin1(hash) + ".png";
+}
+
+QImage FolderIndexer::loadThumbnail(const QString& path, QSize& imageSize) {
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    const bool isJpeg = suffix == "jpg" || suffix == "jpeg";
+
+    cv::Mat image;
+    if (medical_vision::DicomImage::isDicomFile(path.toStdString())) {
+        // Windowed like the viewer shows it, the pixels are only mapped
+        medical_vision::DicomImage dicom;
+        try {
+            dicom.open(path.toStdString());
+            image = dicom.window();
+        }
+        catch (const std::exception&) {
+            return QImage();
+        }
+        imageSize = QSize(dicom.info().cols, dicom.info().rows);
+    } else if (medical_vision::isCacheImagePath(path.toStdString())) {
+        image = medical_vision::readCacheImage(path.toStdString());
+    } else {
+        // Dimensions are read from the header without decoding pixels
+        QImageReader reader(path);
+        imageSize = reader.size();
+
+        // JPEG can be decoded directly at reduced resolution, other formats
+        // are read unchanged to keep 16-bit data for normalization
+        image = cv::imread(path.toStdString(),
+            isJpeg ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_UNCHANGED);
+    }
+    if (image.empty()) return QImage();
+
+    if (!imageSize.isValid() && !isJpeg) {
+        imageSize = QSize(image.cols, image.rows);
+    }
+
+    if (image.depth() != CV_8U) {
+        cv::normalize(image, image, 0, 255, cv::NORM_MINMAX, CV_8U);
+    }
+    if (image.channels() == 4) {
+        cv::cvtColor(image, image, cv::COLOR_BGRA2BGR);
+    }
+
+    double scale = THUMBNAIL_SIZE / static_cast<double>(std::max(image.cols, image.rows));
+    if (scale < 1.0) {
+        cv::resize(image, image, cv::Size(), scale, scale, cv::INTER_AREA);
+    }
+
+    if (image.channels() == 1) {
+        return QImage(image.data, image.cols, image.rows,
+                      image.step, QImage::Format_Grayscale8).copy();
+    }
+
+    cv::Mat rgb;
+    cv::cvtColor(image, rgb, cv::COLOR_BGR2RGB);
+    return QImage(rgb.data, rgb.cols, rgb.rows,
+                  rgb.step, QImage::Format_RGB888).copy();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+#include <QtCore/QStringList>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+#include <atomic>
+
+/**
+ * @brief Background folder scanner and thumbnail generator
+ *
+ * Scans a folder for supported images, reads their dimensions from the file
+ * header and produces thumbnails on a private thread pool. Thumbnails are
+ * cached on disk keyed by absolute path and modification time, so reopening
+ * a folder only costs a directory listing plus small cached reads.
+ * All signals are delivered on the thread that owns the indexer.
+ */
+class FolderIndexer : public QObject {
+    Q_OBJECT
+
+public:
+    struct Entry {
+        QString path;
+        qint64 modified{0};     // Modification time (ms since epoch)
+        QSize imageSize;        // Full resolution size, invalid until indexed
+    };
+
+    explicit FolderIndexer(QObject* parent = nullptr);
+    ~FolderIndexer();
+
+    // Start indexing a folder, cancelling any previous run
+    void open(const QString& directory);
+    void cancel();
+
+    const QVector<Entry>& entries() const { return folderEntries; }
+    static QStringList nameFilters();
+
+    static constexpr int THUMBNAIL_SIZE = 128;
+
+signals:
+    void folderScanned(const QStringList& files);
+    void entryIndexed(int index, const QSize& imageSize);
+    void thumbnailReady(int index, const QImage& thumbnail);
+    void indexingFinished();
+
+private:
+    void scanFolder(const QString& directory, quint64 generation);
+    void scheduleThumbnails(quint64 generation);
+    void indexEntry(int index, const Entry& entry, quint64 generation);
+
+    QString cacheFilePath(const Entry& entry) const;
+    static QImage loadThumbnail(const QString& path, QSize& imageSize);
+
+    QThreadPool pool;
+    QString cacheDirectory;
+    QVector<Entry> folderEntries;
+    std::atomic<quint64> currentGeneration{0};
+    int pendingThumbnails{0};
+};
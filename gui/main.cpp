@@ -1,8 +1,12 @@
 #include "main_window.hpp"
+#include "../include/medical_vision/buffer_pool.hpp"
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QStyleFactory>
 
 int main(int argc, char *argv[]) {
+    // Recycle image buffers, browsing same-size radiographs reuses them
+    medical_vision::BufferPool::instance().install();
+
     QApplication app(argc, argv);
     
     // Set fusion style for a modern look
@@ -8,7 +8,22 @@
 #include <QtWidgets/QStatusBar>
 #include <QtWidgets/QScrollArea>
 #include <QtWidgets/QLabel>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QSignalBlocker>
 #include "opencv2/imgcodecs.hpp"
+#include <chrono>
+
+namespace {
+// Wall time of a processing step in milliseconds
+template <typename Fn>
+float timeMs(Fn&& fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<float, std::milli>(end - start).count();
+}
+}
 
 MainWindow::MainWindow(QWidget* parent) 
     : QMainWindow(parent) {
@@ -47,6 +62,11 @@ void MainWindow::setupUI() {
     viewersLayout->addWidget(processedViewer);
     leftLayout->addLayout(viewersLayout);
 
+    // Filmstrip, filled by the background folder indexer
+    thumbnailStrip = new ThumbnailStrip(this);
+    leftLayout->addWidget(thumbnailStrip);
+    folderIndexer = new FolderIndexer(this);
+
     // Histogram
     histogramViewer = new HistogramViewer(this);
     leftLayout->addWidget(histogramViewer);
@@ -60,18 +80,17 @@ void MainWindow::setupUI() {
     featurePanel = new FeaturePanel(this);
     segmentationPanel = new SegmentationPanel(this);
     
-    // TODO Finish analysisPanel
-    // analysisPanel = new AnalysisPanel(this);
-    // // Load model
-    // const QString modelPath = "D:/enhanced_projects/medical_vision/data/models/densenet/densenet121.onnx";
-    // const QString configPath = "D:/enhanced_projects/medical_vision/data/models/densenet/densenet121-config.json";
-
-    // if (QFile::exists(modelPath) && QFile::exists(configPath)) {
-    //     analysisPanel->loadModel(modelPath, configPath);
-    // } else {
-    //     QMessageBox::warning(this, tr("Model Loading"),
-    //         tr("Model files not found. Please download the model first."));
-    // }
+    analysisPanel = new AnalysisPanel(this);
+
+    // Load model in the background, the panel enables itself when ready
+    const QString modelDir = findModelDirectory();
+    if (!modelDir.isEmpty()) {
+        analysisPanel->loadModel(modelDir + "/densenet121.onnx",
+                                 modelDir + "/densenet121-config.json");
+    } else {
+        statusBar()->showMessage(
+            tr("Model files not found. Please download the model first."), 5000);
+    }
 
     // Add panels to right layout with scroll area
     auto scrollArea = new QScrollArea(this);
@@ -81,8 +100,7 @@ void MainWindow::setupUI() {
     scrollLayout->addWidget(processingPanel);
     scrollLayout->addWidget(featurePanel);
     scrollLayout->addWidget(segmentationPanel);
-    // TODO Finish analysisPanel
-    // scrollLayout->addWidget(analysisPanel);  
+    scrollLayout->addWidget(analysisPanel);
     scrollLayout->addStretch();
 
     scrollWidget->setLayout(scrollLayout);
@@ -120,6 +138,14 @@ void MainWindow::setupMenus() {
     connect(exitAction, &QAction::triggered, this, &QWidget::close);
     fileMenu->addAction(exitAction);
 
+    // Tools Menu
+    auto toolsMenu = menuBar()->addMenu(tr("&Tools"));
+
+    recordAction = new QAction(tr("&Record Session..."), this);
+    recordAction->setCheckable(true);
+    connect(recordAction, &QAction::toggled, this, &MainWindow::toggleSessionRecording);
+    toolsMenu->addAction(recordAction);
+
     // Help Menu
     auto helpMenu = menuBar()->addMenu(tr("&Help"));
     
@@ -143,14 +169,13 @@ void MainWindow::saveProcessedImage() {
         this,
         tr("Save Processed Image"),
         defaultName,
-        tr("Images (*.png *.jpg *.tiff);;All Files (*.*)")
+        tr("Images (*.png *.jpg *.tiff);;Lossless Cache (*.mvc);;All Files (*.*)")
     );
 
     if (filePath.isEmpty()) return;
 
     try {
-        cv::Mat processedImage = processor.getImage();
-        if (cv::imwrite(filePath.toStdString(), processedImage)) {
+        if (processor.saveImage(filePath.toStdString())) {
             statusBar()->showMessage(tr("Image saved successfully"), 3000);
         } else {
             QMessageBox::warning(this, tr("Save Error"),
@@ -163,6 +188,81 @@ void MainWindow::saveProcessedImage() {
     }
 }
 
+void MainWindow::toggleSessionRecording(bool enabled) {
+    if (!enabled) {
+        sessionRecorder.close();
+        statusBar()->showMessage(tr("Session recording stopped"), 3000);
+        return;
+    }
+
+    QString filePath = QFileDialog::getSaveFileName(
+        this,
+        tr("Record Session"),
+        "session.mvsl",
+        tr("Session Logs (*.mvsl);;All Files (*.*)")
+    );
+
+    if (filePath.isEmpty() || !sessionRecorder.open(filePath.toStdString())) {
+        if (!filePath.isEmpty()) {
+            QMessageBox::warning(this, tr("Record Session"), tr("Failed to create the session log"));
+        }
+        QSignalBlocker blocker(recordAction);
+        recordAction->setChecked(false);
+        return;
+    }
+
+    statusBar()->showMessage(tr("Recording session to %1").arg(filePath), 3000);
+
+    // Start from the current state so the replay has an image to work on
+    if (processor.isLoaded()) {
+        medical_vision::SessionEvent event;
+        event.type = medical_vision::SessionEvent::Type::NAVIGATION;
+        event.imagePath = imageFiles[currentImageIndex].toStdString();
+        sessionRecorder.record(event);
+    }
+}
+
+medical_vision::SessionSettings MainWindow::currentSessionSettings() const {
+    medical_vision::SessionSettings settings;
+
+    auto procSettings = processingPanel->getCurrentSettings();
+    settings.denoiseEnabled = procSettings.denoiseEnabled;
+    settings.denoiseMethod = procSettings.denoiseMethod;
+    settings.claheEnabled = procSettings.claheEnabled;
+    settings.sharpenEnabled = procSettings.sharpenEnabled;
+    settings.sharpenStrength = procSettings.sharpenStrength;
+
+    auto featureSettings = featurePanel->getCurrentSettings();
+    settings.edgesEnabled = featureSettings.edgesEnabled;
+    settings.edgeMethod = featureSettings.edgeMethod;
+    settings.edgeParams = featureSettings.edgeParams;
+    settings.keypointsEnabled = featureSettings.keypointsEnabled;
+    settings.keypointMethod = featureSettings.keypointMethod;
+    settings.keypointParams = featureSettings.keypointParams;
+
+    auto segSettings = segmentationPanel->getCurrentSettings();
+    settings.segmentationEnabled = segSettings.enabled;
+    settings.segmentationMethod = segSettings.method;
+
+    return settings;
+}
+
+QString MainWindow::findModelDirectory() const {
+    // Look around the executable and the working directory, walking up
+    // to reach the source tree from a build directory
+    const QStringList roots{QCoreApplication::applicationDirPath(), QDir::currentPath()};
+    for (const QString& root : roots) {
+        QDir dir(root);
+        for (int depth = 0; depth < 4; ++depth) {
+            if (dir.exists("data/models/densenet/densenet121.onnx")) {
+                return dir.filePath("data/models/densenet");
+            }
+            if (!dir.cdUp()) break;
+        }
+    }
+    return QString();
+}
+
 QString MainWindow::getDefaultSaveFilename() const {
     QFileInfo currentFile(imageFiles[currentImageIndex]);
     QString baseName = currentFile.completeBaseName();
@@ -228,12 +328,25 @@ void MainWindow::setupConnections() {
     // Navigation
     connect(prevButton, &QPushButton::clicked, this, &MainWindow::previousImage);
     connect(nextButton, &QPushButton::clicked, this, &MainWindow::nextImage);
+    connect(thumbnailStrip, &ThumbnailStrip::imageSelected, this, &MainWindow::showImage);
+
+    // Folder indexing
+    connect(folderIndexer, &FolderIndexer::folderScanned, this, &MainWindow::handleFolderScanned);
+    connect(folderIndexer, &FolderIndexer::thumbnailReady, thumbnailStrip, &ThumbnailStrip::setThumbnail);
+    connect(folderIndexer, &FolderIndexer::entryIndexed, thumbnailStrip, &ThumbnailStrip::setImageSize);
+    connect(folderIndexer, &FolderIndexer::indexingFinished, this, [this]() {
+        statusBar()->showMessage(tr("Indexed %1 images").arg(imageFiles.size()), 3000);
+    });
 
     // Processing
     connect(processingPanel, &ProcessingPanel::settingsChanged, this, &MainWindow::processImage);
     connect(featurePanel, &FeaturePanel::settingsChanged, this, &MainWindow::processImage);
     connect(segmentationPanel, &SegmentationPanel::settingsChanged, this, &MainWindow::processImage);
 
+    // Heatmaps are rendered only for the selected detection
+    connect(analysisPanel, &AnalysisPanel::heatmapRequested, this, &MainWindow::showHeatmap);
+    connect(analysisPanel, &AnalysisPanel::heatmapHidden, this, &MainWindow::hideHeatmap);
+
     // Seed placement for watershed
     connect(processedViewer, &ImageViewer::mousePressed, this, &MainWindow::handleSeedPlacement);
 }
@@ -242,17 +355,17 @@ void MainWindow::openFolder() {
     QString dir = QFileDialog::getExistingDirectory(this, tr("Select Image Folder"));
     if (dir.isEmpty()) return;
 
-    imageFiles.clear();
-    QDir selectedDir(dir);
-    QStringList filters{"*.jpg", "*.jpeg", "*.png"};
-    imageFiles = selectedDir.entryList(filters, QDir::Files);
+    // Scanning and thumbnails run in the background, see handleFolderScanned
+    statusBar()->showMessage(tr("Indexing folder..."));
+    folderIndexer->open(dir);
+}
 
-    // Prepend path to filenames
-    for (int i = 0; i < imageFiles.size(); ++i) {
-        imageFiles[i] = selectedDir.filePath(imageFiles[i]);
-    }
+void MainWindow::handleFolderScanned(const QStringList& files) {
+    imageFiles = files;
+    thumbnailStrip->setFiles(imageFiles);
 
     if (imageFiles.empty()) {
+        statusBar()->clearMessage();
         QMessageBox::warning(this, tr("Error"), tr("No valid images found in folder"));
         return;
     }
@@ -265,16 +378,25 @@ void MainWindow::openFolder() {
 void MainWindow::loadCurrentImage() {
     if (imageFiles.empty()) return;
      try {
-        if (!processor.loadImage(imageFiles[currentImageIndex].toStdString())) {
+        medical_vision::SessionEvent event;
+        event.type = medical_vision::SessionEvent::Type::NAVIGATION;
+        event.imagePath = imageFiles[currentImageIndex].toStdString();
+
+        bool loaded = false;
+        event.stageTimes[static_cast<size_t>(medical_vision::SessionStage::LOAD)] =
+            timeMs([&] { loaded = processor.loadImage(event.imagePath); });
+        if (!loaded) {
             QMessageBox::warning(this, tr("Error"), tr("Failed to load image"));
             return;
         }
+        sessionRecorder.record(event);
 
         // Display original image
         originalViewer->setImage(processor.getOriginalImage());
         
-        // Update histogram
-        histogramViewer->setHistogram(processor.getHistogram());
+        // Original histogram is computed in the background
+        histogramViewer->updateFromImage(HistogramViewer::Series::ORIGINAL,
+                                         processor.getOriginalImage());
         
         // Process image with current settings
         processImage();
@@ -289,60 +411,80 @@ void MainWindow::processImage() {
         return;
     }
 
+    // Same call sequence as runSettings in tools/session_replay.cpp
+    medical_vision::SessionEvent event;
+    event.type = medical_vision::SessionEvent::Type::SETTINGS;
+    event.settings = currentSessionSettings();
+    const auto& settings = event.settings;
+    auto stageTime = [&event](medical_vision::SessionStage stage) -> float& {
+        return event.stageTimes[static_cast<size_t>(stage)];
+    };
+
     try {
         // Reset to original image
         processor.reset();
 
-        // Update histogram
-        cv::Mat hist = processor.getHistogram();
-        if (!hist.empty()) {
-            histogramViewer->setHistogram(hist);
-        } else {
-            statusBar()->showMessage(tr("Failed to compute histogram"), 3000);
-        }
-
         // Apply image processing
-        auto procSettings = processingPanel->getCurrentSettings();
-        if (procSettings.denoiseEnabled) {
-            processor.denoise(procSettings.denoiseMethod);
+        if (settings.denoiseEnabled) {
+            stageTime(medical_vision::SessionStage::DENOISE) = timeMs([&] {
+                processor.denoise(settings.denoiseMethod);
+            });
         }
-        if (procSettings.claheEnabled) {
-            processor.histogramProcessing(medical_vision::ImagePreprocessor::HistogramMethod::CLAHE);
+        if (settings.claheEnabled) {
+            stageTime(medical_vision::SessionStage::CLAHE) = timeMs([&] {
+                processor.histogramProcessing(medical_vision::ImagePreprocessor::HistogramMethod::CLAHE);
+            });
         }
-        if (procSettings.sharpenEnabled) {
-            processor.sharpen(procSettings.sharpenStrength);
+        if (settings.sharpenEnabled) {
+            stageTime(medical_vision::SessionStage::SHARPEN) = timeMs([&] {
+                processor.sharpen(settings.sharpenStrength);
+            });
         }
 
         cv::Mat displayImage = processor.getImage().clone();
 
+        // displayImage is never modified in place, safe to share with the worker
+        histogramViewer->updateFromImage(HistogramViewer::Series::PROCESSED, displayImage);
+
         // CLear previous overlay
         processedViewer->clearOverlay();
+        featureOverlay.release();
 
         // Apply feature detection
-        auto featureSettings = featurePanel->getCurrentSettings();
-        if (featureSettings.edgesEnabled) {
-            cv::Mat edges = featureDetector.detectEdges(
-                displayImage, featureSettings.edgeMethod, featureSettings.edgeParams);
+        if (settings.edgesEnabled) {
+            cv::Mat edges;
+            stageTime(medical_vision::SessionStage::EDGES) = timeMs([&] {
+                edges = featureDetector.detectEdges(
+                    displayImage, settings.edgeMethod, settings.edgeParams);
+            });
             processedViewer->setOverlay(edges, 0.3);
+            featureOverlay = edges;
         }
 
-        if (featureSettings.keypointsEnabled) {
-            auto keypoints = featureDetector.detectKeypoints(
-                displayImage, featureSettings.keypointMethod, featureSettings.keypointParams);
-            displayImage = featureDetector.drawKeypoints(displayImage, keypoints);
+        if (settings.keypointsEnabled) {
+            stageTime(medical_vision::SessionStage::KEYPOINTS) = timeMs([&] {
+                auto keypoints = featureDetector.detectKeypoints(
+                    displayImage, settings.keypointMethod, settings.keypointParams);
+                displayImage = featureDetector.drawKeypoints(displayImage, keypoints);
+            });
         }
 
         // Apply segmentation
-        auto segSettings = segmentationPanel->getCurrentSettings();
-        if (segSettings.enabled) {
-            cv::Mat segmentation_image = segmentation.segment(displayImage, segSettings.method);
+        if (settings.segmentationEnabled) {
+            cv::Mat segmentation_image;
+            stageTime(medical_vision::SessionStage::SEGMENTATION) = timeMs([&] {
+                segmentation_image = segmentation.segment(displayImage, settings.segmentationMethod);
+            });
             processedViewer->setOverlay(segmentation_image, 0.3);
+            featureOverlay = segmentation_image;
         }
 
-        // TODO
-        // if (analysisPanel && analysisPanel->GetIsModelLoaded()) {
-        //     analysisPanel->analyzeImage(processor.getImage());
-        // }
+        sessionRecorder.record(event);
+
+        // Runs asynchronously, superseding any analysis still in flight
+        if (analysisPanel) {
+            analysisPanel->analyzeImage(processor.getImage());
+        }
 
         // Update display
         processedViewer->setImage(displayImage);
@@ -359,6 +501,21 @@ void MainWindow::processImage() {
     }
 }
 
+void MainWindow::showHeatmap(const QString& pathology) {
+    cv::Mat heatmap = analysisPanel->heatmapFor(pathology, processedViewer->getDisplaySize());
+    if (!heatmap.empty()) {
+        processedViewer->setOverlay(heatmap, 0.4);
+    }
+}
+
+void MainWindow::hideHeatmap() {
+    if (featureOverlay.empty()) {
+        processedViewer->clearOverlay();
+    } else {
+        processedViewer->setOverlay(featureOverlay, 0.3);
+    }
+}
+
 void MainWindow::handleSeedPlacement(cv::Point pos, Qt::MouseButton button) {
     auto segSettings = segmentationPanel->getCurrentSettings();
     if (segSettings.enabled && 
@@ -383,7 +540,17 @@ void MainWindow::previousImage() {
     }
 }
 
+void MainWindow::showImage(int index) {
+    if (index < 0 || index >= imageFiles.size()) return;
+    if (static_cast<size_t>(index) == currentImageIndex) return;
+
+    currentImageIndex = index;
+    loadCurrentImage();
+    updateNavigationState();
+}
+
 void MainWindow::updateNavigationState() {
+    thumbnailStrip->setCurrentImage(static_cast<int>(currentImageIndex));
     prevButton->setEnabled(currentImageIndex > 0);
     nextButton->setEnabled(currentImageIndex < imageFiles.size() - 1);
     imageCountLabel->setText(tr("Image %1/%2")
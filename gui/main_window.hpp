@@ -11,10 +11,13 @@
 #include "widgets/feature_panel.hpp"
 #include "widgets/segmentation_panel.hpp"
 #include "widgets/analysis_panel.hpp"
+#include "widgets/thumbnail_strip.hpp"
+#include "folder_indexer.hpp"
 
 #include "../include/medical_vision/image_preprocessor.hpp"
 #include "../include/medical_vision/feature_detector.hpp"
 #include "../include/medical_vision/segmentation.hpp"
+#include "../include/medical_vision/session_log.hpp"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -27,11 +30,16 @@ private slots:
     void openFolder();
     void nextImage();
     void previousImage();
+    void showImage(int index);
+    void handleFolderScanned(const QStringList& files);
+    void showHeatmap(const QString& pathology);
+    void hideHeatmap();
     void processImage();
     void handleSeedPlacement(cv::Point pos, Qt::MouseButton button);
     void saveProcessedImage();
     void showHelp();
     void showAbout();
+    void toggleSessionRecording(bool enabled);
 
 private:
     void setupUI();
@@ -40,6 +48,8 @@ private:
     void updateNavigationState();
     void loadCurrentImage();
     QString getDefaultSaveFilename() const;
+    QString findModelDirectory() const;
+    medical_vision::SessionSettings currentSessionSettings() const;
 
     // UI Components
     ImageViewer* originalViewer{nullptr};
@@ -49,20 +59,29 @@ private:
     FeaturePanel* featurePanel{nullptr};
     SegmentationPanel* segmentationPanel{nullptr};
     AnalysisPanel* analysisPanel{nullptr};
+    ThumbnailStrip* thumbnailStrip{nullptr};
 
     // Navigation controls
     QPushButton* prevButton{nullptr};
     QPushButton* nextButton{nullptr};
     QLabel* imageCountLabel{nullptr};
     QAction* saveAction{nullptr};
+    QAction* recordAction{nullptr};
 
     // Processing core
     medical_vision::ImagePreprocessor processor;
     medical_vision::FeatureDetector featureDetector;
     medical_vision::Segmentation segmentation;
 
+    // Interaction trace for session_replay
+    medical_vision::SessionRecorder sessionRecorder;
+
+
+    // Overlay from feature detection or segmentation, restored after heatmaps
+    cv::Mat featureOverlay;
 
     // Image data
+    FolderIndexer* folderIndexer{nullptr};
     QStringList imageFiles;
     size_t currentImageIndex{0};
 };
\ No newline at end of file
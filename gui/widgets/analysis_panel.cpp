@@ -6,10 +6,22 @@
 
 AnalysisPanel::AnalysisPanel(QWidget* parent)
     : QGroupBox(tr("Deep Learning Analysis"), parent) {
+    // Inference runs on its own thread so the UI never blocks
+    worker = new AnalysisWorker;
+    worker->moveToThread(&workerThread);
+    connect(&workerThread, &QThread::finished, worker, &QObject::deleteLater);
+    workerThread.start();
+
     setupUI();
     setupConnections();
 }
 
+AnalysisPanel::~AnalysisPanel() {
+    worker->setLatestRequest(0);
+    workerThread.quit();
+    workerThread.wait();
+}
+
 void AnalysisPanel::setupUI() {
     auto mainLayout = new QVBoxLayout(this);
 
@@ -18,10 +30,16 @@ void AnalysisPanel::setupUI() {
     
     analyzeButton = new QPushButton(tr("Analyze"), this);
     analyzeButton->setEnabled(false);
+
+    cancelButton = new QPushButton(tr("Cancel"), this);
+    cancelButton->setEnabled(false);
     
     showHeatmapCheck = new QCheckBox(tr("Show Heatmap"), this);
     showHeatmapCheck->setEnabled(false);
 
+    lungsOnlyCheck = new QCheckBox(tr("Lungs Only"), this);
+    lungsOnlyCheck->setToolTip(tr("Analyze the bounds of the lungs instead of the whole image"));
+
     auto thresholdLayout = new QHBoxLayout;
     thresholdLayout->addWidget(new QLabel(tr("Confidence:")));
     confidenceThresholdSpin = new QDoubleSpinBox(this);
@@ -31,7 +49,9 @@ void AnalysisPanel::setupUI() {
     thresholdLayout->addWidget(confidenceThresholdSpin);
 
     controlsLayout->addWidget(analyzeButton);
+    controlsLayout->addWidget(cancelButton);
     controlsLayout->addWidget(showHeatmapCheck);
+    controlsLayout->addWidget(lungsOnlyCheck);
     controlsLayout->addLayout(thresholdLayout);
     controlsLayout->addStretch();
 
@@ -39,6 +59,7 @@ void AnalysisPanel::setupUI() {
 
     // Progress
     progressBar = new QProgressBar(this);
+    progressBar->setRange(0, 100);
     progressBar->setVisible(false);
     mainLayout->addWidget(progressBar);
 
@@ -62,12 +83,23 @@ void AnalysisPanel::setupUI() {
 
 void AnalysisPanel::setupConnections() {
     connect(analyzeButton, &QPushButton::clicked, [this]() {
-        analyzeButton->setEnabled(false);
-        progressBar->setVisible(true);
-        progressBar->setRange(0, 0);  // Indeterminate progress
+        if (!lastImage.empty()) {
+            analyzeImage(lastImage);
+        }
     });
+    connect(cancelButton, &QPushButton::clicked, this, &AnalysisPanel::cancelAnalysis);
+
+    // Worker results arrive through queued connections
+    connect(worker, &AnalysisWorker::modelLoaded, this, &AnalysisPanel::handleModelLoaded);
+    connect(worker, &AnalysisWorker::progressChanged, this, &AnalysisPanel::handleProgress);
+    connect(worker, &AnalysisWorker::analysisFinished, this, &AnalysisPanel::handleAnalysisFinished);
 
     connect(showHeatmapCheck, &QCheckBox::toggled, this, &AnalysisPanel::toggleHeatmap);
+    connect(lungsOnlyCheck, &QCheckBox::toggled, [this]() {
+        if (isModelLoaded && !lastImage.empty()) {
+            analyzeImage(lastImage);
+        }
+    });
     
     connect(confidenceThresholdSpin, 
            QOverload<double>::of(&QDoubleSpinBox::valueChanged),
@@ -81,47 +113,122 @@ void AnalysisPanel::setupConnections() {
     });
 }
 
-bool AnalysisPanel::loadModel(const QString& modelPath, const QString& configPath) {
-    try {
-        medical_vision::ChestXRayAnalyzer::ModelConfig config;
-        config.modelPath = modelPath.toStdString();
-        config.configPath = configPath.toStdString();
-        config.confidenceThreshold = DEFAULT_CONFIDENCE_THRESHOLD;
-        config.generateHeatmaps = true;
-
-        if (chest_analyzer.loadModel(config)) {
-            isModelLoaded = true;
-            analyzeButton->setEnabled(true);
-            showHeatmapCheck->setEnabled(true);
-            statusLabel->setText(tr("Model loaded successfully"));
-            return true;
+void AnalysisPanel::loadModel(const QString& modelPath, const QString& configPath) {
+    medical_vision::ChestXRayAnalyzer::ModelConfig config;
+    config.modelPath = modelPath.toStdString();
+    config.configPath = configPath.toStdString();
+    config.confidenceThreshold = confidenceThresholdSpin->value();
+    // Only raw activation maps are kept, heatmaps are rendered on selection
+    config.generateHeatmaps = false;
+    config.storeActivationMaps = true;
+
+    isModelLoaded = false;
+    updateControlsState(false);
+    statusLabel->setText(tr("Loading model..."));
+
+    QMetaObject::invokeMethod(worker, [w = worker, config]() {
+        w->loadModel(config);
+    }, Qt::QueuedConnection);
+}
+
+void AnalysisPanel::handleModelLoaded(bool success, const QString& message) {
+    isModelLoaded = success;
+    updateControlsState(success);
+
+    if (success) {
+        statusLabel->setText(message);
+        if (!lastImage.empty()) {
+            analyzeImage(lastImage);
         }
+    } else {
+        displayError(message);
     }
-    catch (const std::exception& e) {
-        displayError(tr("Failed to load model: %1").arg(e.what()));
-    }
-    
-    isModelLoaded = false;
-    return false;
 }
 
 void AnalysisPanel::analyzeImage(const cv::Mat& image) {
+    lastImage = image.clone();
     if (!isModelLoaded) {
-        displayError(tr("Model not loaded"));
+        // Analyzed once the model finishes loading
         return;
     }
 
-    try {
-        progressBar->setVisible(true);
-        auto result = chest_analyzer.analyze(image);
-        updateResults(result);
-    }
-    catch (const std::exception& e) {
-        displayError(tr("Analysis failed: %1").arg(e.what()));
-    }
+    // A new request supersedes any analysis still in flight
+    currentRequest++;
+    worker->setLatestRequest(currentRequest);
+
+    progressBar->setValue(0);
+    progressBar->setVisible(true);
+    analyzeButton->setEnabled(false);
+    cancelButton->setEnabled(true);
+    statusLabel->setText(tr("Analyzing..."));
+
+    QMetaObject::invokeMethod(worker, [w = worker, image = lastImage, id = currentRequest,
+                                       lungsOnly = lungsOnlyCheck->isChecked()]() {
+        w->analyze(image, id, lungsOnly);
+    }, Qt::QueuedConnection);
+}
+
+void AnalysisPanel::cancelAnalysis() {
+    worker->setLatestRequest(0);
+    currentRequest++;
+
+    progressBar->setVisible(false);
+    analyzeButton->setEnabled(isModelLoaded);
+    cancelButton->setEnabled(false);
+    statusLabel->setText(tr("Analysis cancelled"));
+}
+
+void AnalysisPanel::handleProgress(quint64 requestId, int percent) {
+    if (requestId != currentRequest) return;
+    progressBar->setValue(percent);
+}
+
+void AnalysisPanel::handleAnalysisFinished(
+    quint64 requestId, const medical_vision::ChestXRayAnalyzer::AnalysisResult& result) {
+    // Results of superseded or cancelled requests are dropped
+    if (requestId != currentRequest) return;
 
     progressBar->setVisible(false);
     analyzeButton->setEnabled(true);
+    cancelButton->setEnabled(false);
+
+    lastResult = result;
+    heatmapCache.clear();
+    updateResults(result);
+
+    // The selection is gone with the previous results
+    if (showHeatmapCheck->isChecked()) {
+        emit heatmapHidden();
+    }
+}
+
+cv::Mat AnalysisPanel::heatmapFor(const QString& pathology, const cv::Size& size) {
+    const QString key = QString("%1|%2x%3").arg(pathology).arg(size.width).arg(size.height);
+    if (auto cached = heatmapCache.object(key)) {
+        return *cached;
+    }
+
+    const std::string name = pathology.toStdString();
+    for (const auto& detection : lastResult.detections) {
+        if (detection.pathology != name) continue;
+
+        // The map covers the analyzed region, in image coordinates
+        cv::Rect region = detection.region;
+        const cv::Size imageSize = lastResult.processedImage.size();
+        if (!region.empty() && imageSize.area() > 0 && imageSize != size) {
+            const double sx = size.width / static_cast<double>(imageSize.width);
+            const double sy = size.height / static_cast<double>(imageSize.height);
+            region = cv::Rect(cvRound(region.x * sx), cvRound(region.y * sy),
+                              cvRound(region.width * sx), cvRound(region.height * sy));
+        }
+        cv::Mat heatmap = medical_vision::ChestXRayAnalyzer::renderHeatmap(
+            detection.activationMap, size, region);
+        if (!heatmap.empty()) {
+            heatmapCache.insert(key, new cv::Mat(heatmap));
+        }
+        return heatmap;
+    }
+    return cv::Mat();
 }
 
 void AnalysisPanel::updateResults(
@@ -158,15 +265,25 @@ void AnalysisPanel::updateResults(
 }
 
 void AnalysisPanel::toggleHeatmap(bool checked) {
-    if (checked && resultsTable->currentRow() >= 0) {
+    if (!checked) {
+        emit heatmapHidden();
+        return;
+    }
+    if (resultsTable->currentRow() >= 0) {
         QString pathology = resultsTable->item(resultsTable->currentRow(), 0)->text();
         emit heatmapRequested(pathology);
     }
 }
 
 void AnalysisPanel::updateConfidenceThreshold(double value) {
-    chest_analyzer.setConfidenceThreshold(static_cast<float>(value));
+    QMetaObject::invokeMethod(worker, [w = worker, value]() {
+        w->setConfidenceThreshold(static_cast<float>(value));
+    }, Qt::QueuedConnection);
     emit confidenceThresholdChanged(value);
+
+    if (isModelLoaded && !lastImage.empty()) {
+        analyzeImage(lastImage);
+    }
 }
 
 void AnalysisPanel::clearResults() {
@@ -177,4 +294,13 @@ void AnalysisPanel::clearResults() {
 void AnalysisPanel::displayError(const QString& message) {
     statusLabel->setText(message);
     QMessageBox::warning(this, tr("Error"), message);
-}
\ No newline at end of file
+}
+
+void AnalysisPanel::updateControlsState(bool enabled) {
+    analyzeButton->setEnabled(enabled);
+    showHeatmapCheck->setEnabled(enabled);
+    if (!enabled) {
+        cancelButton->setEnabled(false);
+        progressBar->setVisible(false);
+    }
+}
@@ -7,27 +7,39 @@
 #include <QtWidgets/QDoubleSpinBox>
 #include <QtWidgets/QProgressBar>
 #include <QtWidgets/QTableWidget>
-#include "../../include/medical_vision/chest_x_ray_analyzer.hpp"
+#include <QtCore/QThread>
+#include <QtCore/QCache>
+#include "../analysis_worker.hpp"
 
 class AnalysisPanel : public QGroupBox {
     Q_OBJECT
 
 public:
     explicit AnalysisPanel(QWidget* parent = nullptr);
-    ~AnalysisPanel() = default;
+    ~AnalysisPanel();
 
-    // Main interface
+    // Main interface, both return immediately and work in the background
     void analyzeImage(const cv::Mat& image);
-    bool loadModel(const QString& modelPath, const QString& configPath);
+    void loadModel(const QString& modelPath, const QString& configPath);
     bool GetIsModelLoaded(){ return isModelLoaded;}
+    void cancelAnalysis();
+
+    // Colorized heatmap of a detection from the last result, rendered
+    // on first use at the requested size and cached afterwards
+    cv::Mat heatmapFor(const QString& pathology, const cv::Size& size);
 
 signals:
     void analysisCompleted(const medical_vision::ChestXRayAnalyzer::AnalysisResult& result);
     void heatmapRequested(const QString& pathology);
+    void heatmapHidden();
     void confidenceThresholdChanged(float value);
 
 private slots:
     void updateResults(const medical_vision::ChestXRayAnalyzer::AnalysisResult& result);
+    void handleModelLoaded(bool success, const QString& message);
+    void handleProgress(quint64 requestId, int percent);
+    void handleAnalysisFinished(quint64 requestId,
+                                const medical_vision::ChestXRayAnalyzer::AnalysisResult& result);
     void toggleHeatmap(bool checked);
     void updateConfidenceThreshold(double value);
 
@@ -40,18 +52,26 @@ private:
 
     // UI Components
     QPushButton* analyzeButton;
+    QPushButton* cancelButton;
     QCheckBox* showHeatmapCheck;
+    QCheckBox* lungsOnlyCheck;
     QDoubleSpinBox* confidenceThresholdSpin;
     QProgressBar* progressBar;
     QTableWidget* resultsTable;
     QLabel* processingTimeLabel;
     QLabel* statusLabel;
 
-    // Analysis
-    medical_vision::ChestXRayAnalyzer chest_analyzer;
+    // Analysis, the analyzer itself lives in the worker thread
+    QThread workerThread;
+    AnalysisWorker* worker{nullptr};
     bool isModelLoaded{false};
+    quint64 currentRequest{0};
+    cv::Mat lastImage;
+    medical_vision::ChestXRayAnalyzer::AnalysisResult lastResult;
+    QCache<QString, cv::Mat> heatmapCache{HEATMAP_CACHE_SIZE};
 
     // Constants
     static constexpr int TABLE_COLUMNS = 2;  // Pathology, Confidence
     static constexpr double DEFAULT_CONFIDENCE_THRESHOLD = 0.5;
+    static constexpr int HEATMAP_CACHE_SIZE = 8;
 };
\ No newline at end of file
@@ -1,6 +1,17 @@
 #include "histogram_viewer.hpp"
 #include <QtGui/QPainter>
-#include <opencv2/imgproc.hpp>
+#include <QtGui/QPainterPath>
+#include <QtGui/QContextMenuEvent>
+#include <QtWidgets/QMenu>
+#include <algorithm>
+#include <cmath>
+#include "../../include/medical_vision/image_preprocessor.hpp"
+
+namespace {
+// Channel colors for gray and BGR images
+const QColor GRAY_COLOR(255, 255, 255);
+const QColor BGR_COLORS[] = { QColor(80, 140, 255), QColor(80, 220, 80), QColor(255, 80, 80) };
+}
 
 HistogramViewer::HistogramViewer(QWidget* parent)
     : QWidget(parent) {
@@ -8,36 +19,155 @@ HistogramViewer::HistogramViewer(QWidget* parent)
     setMinimumSize(MIN_WIDTH, MIN_HEIGHT);
     setBackgroundRole(QPalette::Base);
     setAutoFillBackground(true);
+
+    // One worker is enough, stale requests are skipped anyway
+    pool.setMaxThreadCount(1);
 }
 
-void HistogramViewer::setHistogram(const cv::Mat& histogram) {
-    if (histogram.empty()) {
-        histogramImage = QImage();
-    } else {
-        // Convert OpenCV Mat to QImage
-        if (histogram.type() == CV_8UC3) {
-            cv::Mat rgb;
-            cv::cvtColor(histogram, rgb, cv::COLOR_BGR2RGB);
-            histogramImage = QImage(rgb.data, rgb.cols, rgb.rows, 
-                                  rgb.step, QImage::Format_RGB888).copy();
-        }
+HistogramViewer::~HistogramViewer() {
+    pool.clear();
+    pool.waitForDone();
+}
+
+void HistogramViewer::setHistogram(Series series, const std::vector<cv::Mat>& bins) {
+    Bins converted;
+    for (const auto& channel : bins) {
+        cv::Mat counts;
+        channel.convertTo(counts, CV_32F);
+        counts = counts.reshape(1, 1);
+
+        QVector<float> values(counts.cols);
+        std::copy(counts.ptr<float>(), counts.ptr<float>() + counts.cols, values.begin());
+        converted.push_back(values);
     }
+
+    (series == Series::ORIGINAL ? originalBins : processedBins) = converted;
+    update();
+}
+
+void HistogramViewer::updateFromImage(Series series, const cv::Mat& image) {
+    const int slot = static_cast<int>(series);
+    const quint64 request = ++requestCounter[slot];
+
+    pool.start([this, series, slot, request, image]() {
+        // Skip work for requests that were superseded while queued
+        if (request != requestCounter[slot].load()) return;
+
+        auto bins = medical_vision::ImagePreprocessor::computeHistogram(image);
+        QMetaObject::invokeMethod(this, [this, series, slot, request, bins]() {
+            if (request != requestCounter[slot].load()) return;
+            setHistogram(series, bins);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void HistogramViewer::setLogScale(bool enabled) {
+    logScale = enabled;
+    update();
+}
+
+void HistogramViewer::setShowOriginal(bool enabled) {
+    showOriginal = enabled;
+    update();
+}
+
+void HistogramViewer::clear() {
+    ++requestCounter[0];
+    ++requestCounter[1];
+    originalBins.clear();
+    processedBins.clear();
     update();
 }
 
+double HistogramViewer::scaledValue(double count) const {
+    return logScale ? std::log1p(count) : count;
+}
+
 void HistogramViewer::paintEvent(QPaintEvent*) {
     QPainter painter(this);
-    
+
     // Fill background
     painter.fillRect(rect(), Qt::black);
 
-    if (histogramImage.isNull()) {
+    if (originalBins.isEmpty() && processedBins.isEmpty()) {
         // Draw placeholder text
         painter.setPen(Qt::white);
         painter.drawText(rect(), Qt::AlignCenter, tr("No Histogram"));
         return;
     }
 
-    // Draw histogram image scaled to widget size
-    painter.drawImage(rect(), histogramImage);
-}
\ No newline at end of file
+    // Shared vertical scale so both series stay comparable
+    double maxValue = 0.0;
+    auto updateMax = [&maxValue](const Bins& bins) {
+        for (const auto& channel : bins) {
+            for (float count : channel) {
+                maxValue = std::max(maxValue, static_cast<double>(count));
+            }
+        }
+    };
+    if (showOriginal) updateMax(originalBins);
+    updateMax(processedBins);
+    maxValue = scaledValue(maxValue);
+    if (maxValue <= 0.0) return;
+
+    painter.setRenderHint(QPainter::Antialiasing);
+    if (showOriginal) {
+        drawSeries(painter, originalBins, true, maxValue);
+    }
+    drawSeries(painter, processedBins, false, maxValue);
+
+    painter.setPen(Qt::gray);
+    painter.drawText(rect().adjusted(5, 5, -5, -5), Qt::AlignTop | Qt::AlignRight,
+                     logScale ? tr("log") : tr("linear"));
+}
+
+void HistogramViewer::drawSeries(QPainter& painter, const Bins& bins,
+                                 bool filled, double maxValue) {
+    const double w = width();
+    const double h = height();
+
+    for (int c = 0; c < bins.size(); ++c) {
+        const auto& channel = bins[c];
+        if (channel.isEmpty()) continue;
+
+        // One vertex per bin, spread over the widget width
+        const double step = channel.size() > 1 ? w / (channel.size() - 1) : w;
+        QPainterPath path;
+        for (int i = 0; i < channel.size(); ++i) {
+            QPointF point(i * step, h - h * scaledValue(channel[i]) / maxValue);
+            if (i == 0) {
+                path.moveTo(point);
+            } else {
+                path.lineTo(point);
+            }
+        }
+
+        QColor color = bins.size() == 1 ? GRAY_COLOR : BGR_COLORS[c % 3];
+        if (filled) {
+            // Original data as a translucent backdrop
+            path.lineTo(w, h);
+            path.lineTo(0, h);
+            path.closeSubpath();
+            color.setAlpha(60);
+            painter.fillPath(path, color);
+        } else {
+            painter.strokePath(path, QPen(color, 1.5));
+        }
+    }
+}
+
+void HistogramViewer::contextMenuEvent(QContextMenuEvent* event) {
+    QMenu menu(this);
+
+    auto logAction = menu.addAction(tr("Log Scale"));
+    logAction->setCheckable(true);
+    logAction->setChecked(logScale);
+    connect(logAction, &QAction::toggled, this, &HistogramViewer::setLogScale);
+
+    auto originalAction = menu.addAction(tr("Show Original"));
+    originalAction->setCheckable(true);
+    originalAction->setChecked(showOriginal);
+    connect(originalAction, &QAction::toggled, this, &HistogramViewer::setShowOriginal);
+
+    menu.exec(event->globalPos());
+}
@@ -1,22 +1,58 @@
 #pragma once
 
 #include <QtWidgets/QWidget>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
 #include <opencv2/core.hpp>
+#include <atomic>
+#include <vector>
 
 class HistogramViewer : public QWidget {
     Q_OBJECT
 
 public:
+    enum class Series {
+        ORIGINAL,
+        PROCESSED
+    };
+
     explicit HistogramViewer(QWidget* parent = nullptr);
-    ~HistogramViewer() = default;
+    ~HistogramViewer();
+
+    // Bin counts per channel, as returned by ImagePreprocessor::computeHistogram
+    void setHistogram(Series series, const std::vector<cv::Mat>& bins);
 
-    void setHistogram(const cv::Mat& histogram);
+    // Compute the bins of an image in the background, the image must not be
+    // modified in place afterwards. Only the latest request per series is shown
+    void updateFromImage(Series series, const cv::Mat& image);
+
+    // Display settings
+    void setLogScale(bool enabled);
+    void setShowOriginal(bool enabled);
+    void clear();
 
 protected:
     void paintEvent(QPaintEvent* event) override;
+    void contextMenuEvent(QContextMenuEvent* event) override;
 
 private:
-    QImage histogramImage;
+    using Bins = QVector<QVector<float>>;
+
+    void drawSeries(QPainter& painter, const Bins& bins, bool filled, double maxValue);
+    double scaledValue(double count) const;
+
+    // Bin data
+    Bins originalBins;
+    Bins processedBins;
+
+    // Display settings
+    bool logScale{false};
+    bool showOriginal{true};
+
+    // Background computation
+    QThreadPool pool;
+    std::atomic<quint64> requestCounter[2]{};
+
     static constexpr int MIN_WIDTH = 512;
     static constexpr int MIN_HEIGHT = 200;
-};
\ No newline at end of file
+};
@@ -86,6 +86,11 @@ cv::Point ImageViewer::getImageCoordinates(const QPoint& widgetPos) const {
     );
 }
 
+cv::Size ImageViewer::getDisplaySize() const {
+    QRect imageRect = getImageRect();
+    return cv::Size(imageRect.width(), imageRect.height());
+}
+
 void ImageViewer::paintEvent(QPaintEvent* event) {
     Q_UNUSED(event);
     QPainter painter(this);
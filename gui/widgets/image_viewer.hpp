@@ -17,6 +17,7 @@ public:
     
     // Coordinate conversion
     cv::Point getImageCoordinates(const QPoint& widgetPos) const;
+    cv::Size getDisplaySize() const;
     
     // Settings
     void setAspectRatioMode(Qt::AspectRatioMode mode);
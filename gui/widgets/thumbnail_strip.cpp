@@ -0,0 +1,66 @@
+#include "thumbnail_strip.hpp"
+#include <QtCore/QFileInfo>
+#include <QtCore/QSignalBlocker>
+#include <QtGui/QPixmap>
+
+ThumbnailStrip::ThumbnailStrip(QWidget* parent)
+    : QListWidget(parent) {
+    // Horizontal filmstrip layout
+    setViewMode(QListView::IconMode);
+    setFlow(QListView::LeftToRight);
+    setWrapping(false);
+    setMovement(QListView::Static);
+    setResizeMode(QListView::Adjust);
+    setIconSize(QSize(ICON_SIZE, ICON_SIZE));
+    setUniformItemSizes(true);
+    setFixedHeight(STRIP_HEIGHT);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setSelectionMode(QAbstractItemView::SingleSelection);
+
+    QPixmap placeholder(ICON_SIZE, ICON_SIZE);
+    placeholder.fill(Qt::darkGray);
+    placeholderIcon = QIcon(placeholder);
+
+    connect(this, &QListWidget::currentRowChanged, this, [this](int row) {
+        if (row >= 0) {
+            emit imageSelected(row);
+        }
+    });
+}
+
+void ThumbnailStrip::setFiles(const QStringList& files) {
+    QSignalBlocker blocker(this);
+    clear();
+
+    for (const QString& file : files) {
+        auto item = new QListWidgetItem(placeholderIcon, QFileInfo(file).fileName());
+        item->setToolTip(file);
+        item->setSizeHint(QSize(ICON_SIZE + 16, STRIP_HEIGHT - 24));
+        addItem(item);
+    }
+}
+
+void ThumbnailStrip::setThumbnail(int index, const QImage& thumbnail) {
+    if (auto current = item(index)) {
+        current->setIcon(QIcon(QPixmap::fromImage(thumbnail)));
+    }
+}
+
+void ThumbnailStrip::setImageSize(int index, const QSize& imageSize) {
+    if (auto current = item(index)) {
+        // Tooltip holds the file path on its first line
+        current->setToolTip(QString("%1\n%2 x %3")
+            .arg(current->toolTip().section('\n', 0, 0))
+            .arg(imageSize.width())
+            .arg(imageSize.height()));
+    }
+}
+
+void ThumbnailStrip::setCurrentImage(int index) {
+    QSignalBlocker blocker(this);
+    setCurrentRow(index);
+    if (auto current = item(index)) {
+        scrollToItem(current, QAbstractItemView::PositionAtCenter);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QtWidgets/QListWidget>
+#include <QtGui/QImage>
+
+class ThumbnailStrip : public QListWidget {
+    Q_OBJECT
+
+public:
+    explicit ThumbnailStrip(QWidget* parent = nullptr);
+    ~ThumbnailStrip() = default;
+
+    // Content handling
+    void setFiles(const QStringList& files);
+    void setThumbnail(int index, const QImage& thumbnail);
+    void setImageSize(int index, const QSize& imageSize);
+    void setCurrentImage(int index);
+
+signals:
+    void imageSelected(int index);
+
+private:
+    QIcon placeholderIcon;
+    static constexpr int ICON_SIZE = 96;
+    static constexpr int STRIP_HEIGHT = 140;
+};
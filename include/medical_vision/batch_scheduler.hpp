@@ -0,0 +1,115 @@
+/**
+ * @file batch_scheduler.hpp
+ * @brief Micro-batching of concurrent analysis requests
+ */
+
+#pragma once
+
+#include "chest_x_ray_analyzer.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @class BatchScheduler
+ * @brief Groups concurrent requests into batched forward passes
+ *
+ * Requests queue up until the adaptive target batch size is reached or the
+ * oldest one has waited maxWait, then run through a single analyzeBatch call
+ * on a dedicated thread. The target follows the recent arrival rate: under
+ * light load requests leave alone and immediately, under heavy load the
+ * batch grows towards maxBatchSize. The analyzer must not be used by other
+ * threads while the scheduler is alive.
+ */
+class BatchScheduler {
+public:
+    struct Config {
+        size_t maxBatchSize{8};
+        std::chrono::microseconds maxWait{5000};
+        // End-to-end latency objective, bounds the batch size by the measured
+        // per image cost when set (0 disables)
+        std::chrono::microseconds latencyTarget{0};
+    };
+
+    /**
+     * @brief Result of one request and the batch it ran in
+     */
+    struct Result {
+        ChestXRayAnalyzer::AnalysisResult analysis;
+        size_t batchSize{0};
+        double queueTime{0.0};  // Seconds spent waiting for the batch
+    };
+
+    /**
+     * @brief Counters since construction or the last resetMetrics()
+     */
+    struct Metrics {
+        size_t requests{0};
+        size_t batches{0};
+        double meanBatchSize{0.0};
+        size_t targetBatchSize{1};
+        double arrivalRate{0.0};      // Requests per second, smoothed
+        double meanQueueTimeMs{0.0};
+        double maxQueueTimeMs{0.0};
+        double meanForwardMs{0.0};    // Per batch
+        std::vector<size_t> batchSizeHistogram;  // Indexed by batch size
+    };
+
+    BatchScheduler(ChestXRayAnalyzer& analyzer, const Config& config);
+    ~BatchScheduler();
+
+    BatchScheduler(const BatchScheduler&) = delete;
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    /**
+     * @brief Queue an image for analysis
+     * @param image Image to analyze, its data must stay valid until the result is ready
+     * @return Future resolved once the batch holding the image has run
+     */
+    std::future<Result> submit(const cv::Mat& image);
+
+    Metrics metrics() const;
+    void resetMetrics();
+
+private:
+    struct Request {
+        cv::Mat image;
+        std::chrono::steady_clock::time_point arrival;
+        std::promise<Result> promise;
+    };
+
+    void run();
+    void process(std::vector<Request>& batch);
+    void updateArrivalRate(std::chrono::steady_clock::time_point arrival);
+    void updateBatchSizes();
+
+    ChestXRayAnalyzer& analyzer_;
+    Config config_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Request> queue_;
+    bool running_{true};
+
+    // Arrival and cost estimates, guarded by mutex_
+    std::chrono::steady_clock::time_point lastArrival_;
+    bool hasArrival_{false};
+    double meanInterval_{0.0};     // Seconds between arrivals
+    double imageCost_{0.0};        // Seconds of forward time per image
+    size_t targetBatchSize_{1};    // Queue length that closes a batch early
+    size_t batchLimit_{1};         // Largest batch allowed
+
+    Metrics metrics_;
+    double queueTimeSum_{0.0};
+    double forwardTimeSum_{0.0};
+
+    std::thread worker_;
+};
+
+} // namespace medical_vision
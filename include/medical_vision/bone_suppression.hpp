@@ -0,0 +1,70 @@
+/**
+ * @file bone_suppression.hpp
+ * @brief Rib shadow attenuation in the frequency domain
+ */
+
+#pragma once
+
+#include "frequency_filter.hpp"
+#include <opencv2/core.hpp>
+#include <optional>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @class BoneSuppressor
+ * @brief Removes most of the rib contrast from frontal chest films
+ *
+ * Ribs are long, near horizontal bands repeating down the lungs, so their
+ * energy sits in a few frequency bands close to the vertical frequency
+ * axis. The rib component is estimated by keeping those bands (one per
+ * rib scale, within an angular wedge) of a downsample of the image, and a
+ * fraction of it is subtracted from the full resolution image. Blobs such
+ * as nodules spread over all orientations and lose little contrast.
+ *
+ * The downsample size and the frequency response, sampled for the DFT
+ * size of the downsample, are kept while images keep the same size, so a
+ * batch of same-size films costs two small real DFTs, a resize and a
+ * subtraction each. A suppressor should not be shared between threads.
+ */
+class BoneSuppressor {
+public:
+    struct Params {
+        double strength{0.7};                       // Fraction of the rib component removed
+        int workSize{512};                          // Longest side the ribs are estimated at
+        std::vector<double> ribScales{7, 10, 14};   // Rib periods per image height
+        double bandwidth{0.5};                      // Width of each scale band, in octaves
+        double angularWidth{40.0};                  // Degrees from the vertical frequency axis
+    };
+
+    BoneSuppressor() = default;
+    explicit BoneSuppressor(const Params& params) : params_(params) {}
+
+    const Params& params() const { return params_; }
+    void setParams(const Params& params);
+
+    /**
+     * @brief Build the plan for an image size ahead of the first image
+     */
+    void prepare(const cv::Size& imageSize);
+
+    /**
+     * @brief Attenuate rib shadows
+     * @param image 8-bit, 16-bit or float single channel image
+     * @param output Same size and type, may be image
+     * @throws std::runtime_error for other image types
+     */
+    void apply(const cv::Mat& image, cv::Mat& output);
+
+private:
+    Params params_;
+
+    // Plan for the last image size
+    cv::Size imageSize_;
+    cv::Size workSize_;         // Downsample the ribs are estimated on
+    std::optional<FrequencyResponse> response_;     // Fraction kept as rib component
+    cv::Mat work_, ribs_, ribsFull_;
+};
+
+} // namespace medical_vision
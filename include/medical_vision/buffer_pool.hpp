@@ -0,0 +1,107 @@
+/**
+ * @file buffer_pool.hpp
+ * @brief Recycling allocator for cv::Mat buffers
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <cstddef>
+
+namespace medical_vision {
+
+/**
+ * @class BufferPool
+ * @brief cv::MatAllocator keeping released buffers in per-thread free lists
+ *
+ * Once installed as the default allocator, every cv::Mat created by the
+ * library or by OpenCV takes its buffer from the calling thread's free list
+ * when one of the exact same size is available. Processing images of the
+ * same size over and over therefore stops touching the heap after the first
+ * one. Buffers released on another thread than the one that allocated them
+ * join the releasing thread's list. Each thread keeps at most
+ * threadCacheLimit bytes and all threads together about cacheLimit bytes;
+ * a release that does not fit evicts the thread's least recently used
+ * sizes first, so sizes that stopped occurring do not stay pinned.
+ */
+class BufferPool : public cv::MatAllocator {
+public:
+    /**
+     * @brief Counters since startup or the last resetStats()
+     */
+    struct Stats {
+        size_t heapAllocations{0};    // Buffers taken from the heap
+        size_t pooledAllocations{0};  // Buffers served from a free list
+        size_t heapFrees{0};          // Buffers given back to the heap
+        size_t cachedBytes{0};        // Held in free lists right now, never reset
+    };
+
+    /**
+     * @brief Called on every heap allocation with its size, from the allocating thread
+     */
+    using AllocationHook = void (*)(size_t bytes);
+
+    /**
+     * @brief Pool shared by all threads, created on first use and never destroyed
+     */
+    static BufferPool& instance();
+
+    /**
+     * @brief Make the pool cv::Mat's default allocator
+     *
+     * Matrices allocated before keep their allocator, so this can be called
+     * at any time, ideally first thing in main().
+     */
+    void install();
+
+    /**
+     * @brief Restore OpenCV's standard allocator, pooled matrices stay valid
+     */
+    void uninstall();
+
+    Stats stats() const;
+    void resetStats();
+
+    void setAllocationHook(AllocationHook hook);
+
+    /**
+     * @brief Bytes each thread may keep in its free list, 256 MiB by default
+     */
+    void setThreadCacheLimit(size_t bytes);
+    size_t threadCacheLimit() const;
+
+    /**
+     * @brief Bytes all free lists may keep together, 1 GiB by default
+     *
+     * Checked when a buffer is cached, so idle threads never grow past it;
+     * their lists are only freed by their own releases or trimThreadCache().
+     */
+    void setCacheLimit(size_t bytes);
+    size_t cacheLimit() const;
+
+    /**
+     * @brief Give the calling thread's cached buffers back to the heap
+     */
+    void trimThreadCache();
+
+    // cv::MatAllocator interface
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags,
+                  cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+private:
+    BufferPool() = default;
+
+    mutable std::atomic<size_t> heapAllocations_{0};
+    mutable std::atomic<size_t> pooledAllocations_{0};
+    mutable std::atomic<size_t> heapFrees_{0};
+    mutable std::atomic<size_t> cachedBytes_{0};
+    std::atomic<AllocationHook> hook_{nullptr};
+    std::atomic<size_t> threadCacheLimit_{size_t(256) << 20};
+    std::atomic<size_t> cacheLimit_{size_t(1) << 30};
+};
+
+} // namespace medical_vision
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "orientation.hpp"
+#include "quality_assessment.hpp"
 #include <opencv2/dnn.hpp>
 #include <opencv2/core.hpp>
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
 
 namespace medical_vision {
 
@@ -15,8 +18,9 @@ public:
     struct Detection {
         std::string pathology;
         float confidence;
-        cv::Rect region;        
+        cv::Rect region;        // Part of the image the model saw and the maps cover
         cv::Mat heatmap;        
+        cv::Mat activationMap;  // Raw class activation map over the region (CV_32F, feature map resolution)
     };
 
     struct ModelConfig {
@@ -25,7 +29,11 @@ public:
         cv::Size inputSize{224, 224};
         float confidenceThreshold{0.5f};
         bool useGPU{false};
-        bool generateHeatmaps{false};
+        bool generateHeatmaps{false};      // Render full size heatmaps eagerly
+        bool storeActivationMaps{false};   // Keep raw maps for renderHeatmap
+        bool qualityGate{false};           // Fail images assessQuality rejects before inference
+        QualityThresholds qualityThresholds;
+        bool normalizeOrientation{false};  // Turn and invert films estimateOrientation flags
     };
 
     struct AnalysisResult {
@@ -34,8 +42,14 @@ public:
         double processingTime{0.0};
         bool success{false};
         std::string errorMessage;
+        QualityReport quality;      // Filled when the quality gate is enabled
+        OrientationEstimate orientation;    // Correction applied to the network input
     };
 
+    // Called with the completed fraction (0-1) after each stage,
+    // returning false cancels the analysis before the next stage
+    using ProgressCallback = std::function<bool(float)>;
+
     ChestXRayAnalyzer() = default;
     ChestXRayAnalyzer(cv::dnn::Net net, ModelConfig config)
         : net_(std::move(net)), config_(std::move(config)) {}
@@ -44,28 +58,61 @@ public:
     // Main interface
     bool loadModel(const ModelConfig& config);
     AnalysisResult analyze(const cv::Mat& image);
+    AnalysisResult analyze(const cv::Mat& image, const ProgressCallback& progress);
+
+    // Only the region (e.g. Segmentation::maskBounds of a lung mask) is
+    // letterboxed into the network input, an empty one means the full image
+    AnalysisResult analyze(const cv::Mat& image, const cv::Rect& region,
+                           const ProgressCallback& progress = ProgressCallback());
     
     // Utility functions
     bool isModelLoaded() const;
     std::vector<std::string> getAvailablePathologies() const;
     void setConfidenceThreshold(float threshold);
+
+    // Colorize an activation map at the requested resolution
+    static cv::Mat renderHeatmap(const cv::Mat& activationMap, const cv::Size& size);
+
+    // Same, placed over the region of a size x size canvas the map covers
+    static cv::Mat renderHeatmap(const cv::Mat& activationMap, const cv::Size& size,
+                                 const cv::Rect& region);
     
-    // Batch processing
+    // Batch processing, images of a batch share one forward pass when
+    // the model accepts a dynamic batch size
     std::vector<AnalysisResult> analyzeBatch(
         const std::vector<cv::Mat>& images, 
         size_t batchSize = 1);
 
 private:
     // Internal processing functions
-    cv::Mat preprocessImage(const cv::Mat& image) const;
+    cv::Mat preprocessImage(const cv::Mat& image,
+                            const OrientationEstimate& orientation = OrientationEstimate()) const;
+    cv::Mat prepareInput(const cv::Mat& image,
+                         const OrientationEstimate& orientation = OrientationEstimate()) const;
+    // Where the resized image sits in the padded network input
+    cv::Rect letterbox(const cv::Size& imageSize, bool turned) const;
+    // Part of an input-sized activation map covering the content rect
+    cv::Mat cropToContent(const cv::Mat& activationMap, const cv::Rect& content) const;
+    void runForward(const cv::Mat& blob, cv::Mat& outputs, cv::Mat& features);
+    void attachActivationMaps(AnalysisResult& result, const cv::Mat& features,
+                              const cv::Size& imageSize, const cv::Rect& region) const;
+    std::vector<AnalysisResult> analyzeChunk(const std::vector<cv::Mat>& images);
     std::vector<Detection> postprocessOutputs(const cv::Mat& outputs) const;
-    cv::Mat generateHeatmap(const cv::Mat& image, const cv::Mat& features) const;
+    cv::Mat computeActivationMap(const cv::Mat& features, size_t classIndex) const;
+    void findActivationLayers();
     bool validateInput(const cv::Mat& image) const;
+    bool passesQualityGate(const cv::Mat& image, AnalysisResult& result) const;
 
     // Model and configuration
     cv::dnn::Net net_;
     ModelConfig config_;
     bool isModelLoaded_{false};
+    bool batchingSupported_{true};
+
+    // Class activation mapping, empty when the model layout is not supported
+    std::string outputLayer_;
+    std::string featureLayer_;
+    cv::Mat classifierWeights_;
 
     // Constants
     static const std::vector<std::string> pathologyNames_;
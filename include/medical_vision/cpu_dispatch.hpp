@@ -0,0 +1,50 @@
+/**
+ * @file cpu_dispatch.hpp
+ * @brief Instruction set selection for the hand-written SIMD kernels
+ */
+
+#pragma once
+
+// x86 variants are built with per-function target attributes, no extra
+// compiler flags are needed and the library still runs on any x86 CPU
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64)) && \
+    (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define MEDICAL_VISION_X86_KERNELS 1
+#else
+#define MEDICAL_VISION_X86_KERNELS 0
+#endif
+
+namespace medical_vision {
+
+/**
+ * @brief Instruction set levels kernels are compiled for, in increasing order
+ */
+enum class CpuLevel {
+    SCALAR,
+    SSE42,
+    AVX2,
+    AVX512   // AVX-512 F and BW
+};
+
+/**
+ * @brief Best level supported by both this CPU (and OS) and the build
+ */
+CpuLevel detectCpuLevel();
+
+/**
+ * @brief Level the kernels currently run at
+ *
+ * Defaults to detectCpuLevel(), lowered by the MEDICAL_VISION_CPU
+ * environment variable (scalar, sse4.2, avx2 or avx512) when set, which
+ * allows benchmarking each variant on the same machine.
+ */
+CpuLevel cpuLevel();
+
+/**
+ * @brief Override the active level, capped to detectCpuLevel()
+ */
+void setCpuLevel(CpuLevel level);
+
+const char* cpuLevelName(CpuLevel level);
+
+} // namespace medical_vision
@@ -0,0 +1,96 @@
+/**
+ * @file dicom_image.hpp
+ * @brief Minimal DICOM reader for grayscale radiographs
+ */
+
+#pragma once
+
+#include "mapped_file.hpp"
+#include <opencv2/core.hpp>
+#include <memory>
+#include <string>
+
+namespace medical_vision {
+
+/**
+ * @class DicomImage
+ * @brief Reads the first frame of a DICOM file into a CV_16U matrix
+ *
+ * Only the tags needed for display are parsed. Supported transfer syntaxes are
+ * implicit and explicit VR little endian, read zero-copy from a memory-mapped
+ * file, and RLE lossless, decoded into an owned buffer. Uncompressed pixels
+ * are copied only when bits above bitsStored need clearing or sign-extending,
+ * or when they are not unsigned 16-bit. The pixel matrix stays valid as long
+ * as the DicomImage it came from.
+ */
+class DicomImage {
+public:
+    /**
+     * @brief Tags read from the file
+     */
+    struct Info {
+        int rows{0};
+        int cols{0};
+        int frames{1};
+        int bitsAllocated{0};
+        int bitsStored{0};         // Bits above it are cleared, signed data sign-extended
+        bool isSigned{false};
+        double rescaleSlope{1.0};
+        double rescaleIntercept{0.0};
+        double windowCenter{0.0};
+        double windowWidth{0.0};   // 0 when the file defines no window
+        std::string photometricInterpretation;
+        std::string transferSyntax;
+    };
+
+    DicomImage();
+    ~DicomImage();
+
+    // Disable copy
+    DicomImage(const DicomImage&) = delete;
+    DicomImage& operator=(const DicomImage&) = delete;
+
+    /**
+     * @brief Check for the DICM marker after the 128 byte preamble
+     */
+    static bool isDicomFile(const std::string& filepath);
+
+    /**
+     * @brief Parse a file and expose its first frame
+     * @throws std::runtime_error if the file is malformed or not supported
+     */
+    void open(const std::string& filepath);
+
+    const Info& info() const { return info_; }
+
+    /**
+     * @brief Stored pixel values as CV_16UC1
+     *
+     * Signed data is shifted by 32768 into the unsigned range, with
+     * rescaleIntercept adjusted so modality values are unchanged.
+     */
+    const cv::Mat& pixels() const { return pixels_; }
+
+    /**
+     * @brief Apply rescale and a linear VOI window, producing CV_8UC1
+     * @param center Window center in modality units
+     * @param width Window width in modality units
+     *
+     * MONOCHROME1 images are inverted so that bright always means dense.
+     */
+    cv::Mat window(double center, double width) const;
+
+    /**
+     * @brief Window from the file, or the full value range when it has none
+     */
+    cv::Mat window() const;
+
+private:
+    void readPixelData(const uint8_t* data, size_t length, bool encapsulated);
+
+    std::unique_ptr<MappedFile> file_;
+    Info info_;
+    cv::Mat pixels_;
+};
+
+} // namespace medical_vision
@@ -0,0 +1,123 @@
+/**
+ * @file duplicate_index.hpp
+ * @brief Perceptual hashes and a Hamming-distance index to find re-exported images
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @brief 64-bit hashes of an image that survive re-encoding and rescaling
+ *
+ * Both come from the same 32x32 area downsample of the gray image.
+ * difference has a bit per horizontal gradient of a 9x8 reduction,
+ * perceptual a bit per low frequency DCT coefficient above their median.
+ * Re-exports of the same film (other codec, size or linear windowing)
+ * differ in a few bits, different films in about half of them.
+ */
+struct ImageHashes {
+    uint64_t difference{0};
+    uint64_t perceptual{0};
+};
+
+/**
+ * @brief Hash an 8 or 16-bit gray or color image
+ * @throws std::runtime_error for empty images or other depths
+ */
+ImageHashes computeImageHashes(const cv::Mat& image);
+
+/**
+ * @brief Number of differing bits
+ */
+int hammingDistance(uint64_t a, uint64_t b);
+
+/**
+ * @class DuplicateIndex
+ * @brief Multi-index hashing over 64-bit image hashes
+ *
+ * Hashes are split into four 16-bit chunks, each with a table of the ids
+ * sorted by chunk value. Two hashes within distance d agree within d / 4
+ * bits on at least one chunk, so a query only visits the buckets of the
+ * chunk values that close to its own instead of every hash:
+ * @code
+ * DuplicateIndex index;
+ * for (const auto& image : archive) index.add(computeImageHashes(image).perceptual);
+ * index.build();
+ * auto matches = index.query(computeImageHashes(film).perceptual, 6);
+ * @endcode
+ * Hashes added after build() are found by a linear scan until the next
+ * build(). Queries may run concurrently, add() and build() may not.
+ */
+class DuplicateIndex {
+public:
+    struct Match {
+        uint32_t id;        // Order in which the hash was added
+        int distance;
+    };
+
+    DuplicateIndex() = default;
+
+    /**
+     * @brief Append a hash, returns its id
+     */
+    uint32_t add(uint64_t hash);
+
+    void reserve(size_t count) { hashes_.reserve(count); }
+
+    /**
+     * @brief Index every hash added so far, chunk tables are built in parallel
+     */
+    void build();
+
+    /**
+     * @brief Hashes within maxDistance bits, closest first
+     */
+    std::vector<Match> query(uint64_t hash, int maxDistance) const;
+
+    /**
+     * @brief Closest hash within maxDistance bits
+     * @return false when there is none
+     */
+    bool nearest(uint64_t hash, int maxDistance, Match& match) const;
+
+    size_t size() const { return hashes_.size(); }
+    uint64_t hash(uint32_t id) const { return hashes_[id]; }
+
+    /**
+     * @brief Write or read the hashes, returns false on I/O errors
+     *
+     * Loading builds the index.
+     */
+    bool save(const std::string& filepath) const;
+    bool load(const std::string& filepath);
+
+private:
+    static constexpr int CHUNK_COUNT = 4;
+    static constexpr int CHUNK_BITS = 16;
+    static constexpr size_t CHUNK_VALUES = size_t(1) << CHUNK_BITS;
+
+    // Ids sorted by one chunk, ids of value v in [offsets[v], offsets[v + 1]).
+    // Their hashes are stored alongside so a bucket is read sequentially.
+    struct ChunkTable {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> ids;
+        std::vector<uint64_t> hashes;
+    };
+
+    static uint32_t chunkOf(uint64_t hash, int chunk) {
+        return static_cast<uint32_t>(hash >> (chunk * CHUNK_BITS)) & (CHUNK_VALUES - 1);
+    }
+
+    std::vector<uint64_t> hashes_;
+    std::array<ChunkTable, CHUNK_COUNT> tables_;
+    size_t indexed_{0};     // Hashes covered by the tables
+};
+
+} // namespace medical_vision
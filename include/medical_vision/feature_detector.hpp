@@ -76,11 +76,14 @@ public:
      * @param input Input image
      * @param method Keypoint detection method to use
      * @param params Parameters for keypoint detection
+     * @param mask Optional 8-bit mask of the image size (e.g. Segmentation::lungMask),
+     *        only its bounds are searched and only keypoints on it are kept
      * @return Vector of detected keypoints
      */
     std::vector<cv::KeyPoint> detectKeypoints(const cv::Mat& input,
                                             KeypointDetector method,
-                                            const KeypointParams& params = KeypointParams());
+                                            const KeypointParams& params = KeypointParams(),
+                                            const cv::Mat& mask = cv::Mat());
 
     /**
      * @brief Draw detected keypoints on an image
@@ -112,9 +115,9 @@ private:
     cv::Mat applyLaplacian(const cv::Mat& input, const EdgeParams& params);
 
     // Helper functions for keypoint detection
-    std::vector<cv::KeyPoint> applySIFT(const cv::Mat& input, const KeypointParams& params);
-    std::vector<cv::KeyPoint> applyORB(const cv::Mat& input, const KeypointParams& params);
-    std::vector<cv::KeyPoint> applyFAST(const cv::Mat& input, const KeypointParams& params);
+    std::vector<cv::KeyPoint> applySIFT(const cv::Mat& input, const cv::Mat& mask, const KeypointParams& params);
+    std::vector<cv::KeyPoint> applyORB(const cv::Mat& input, const cv::Mat& mask, const KeypointParams& params);
+    std::vector<cv::KeyPoint> applyFAST(const cv::Mat& input, const cv::Mat& mask, const KeypointParams& params);
 
     // Utility functions
     cv::Mat prepareImage(const cv::Mat& input);
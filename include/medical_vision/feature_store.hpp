@@ -0,0 +1,190 @@
+/**
+ * @file feature_store.hpp
+ * @brief Append-only columnar store of per-image analysis results
+ */
+
+#pragma once
+
+#include "chest_x_ray_analyzer.hpp"
+#include "duplicate_index.hpp"
+#include "mapped_file.hpp"
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @brief Everything kept about one image
+ */
+struct FeatureRecord {
+    std::string imageId;                // e.g. the path inside the dataset
+    ImageHashes hashes;                 // computeImageHashes, the lookup key
+    std::vector<float> predictions;     // One score per store label, NaN when not computed
+    cv::Mat mask;                       // 8-bit segmentation mask, nonzero inside; may be empty
+    std::vector<float> texture;         // Texture features, textureSize of the store (none yet)
+    std::vector<cv::KeyPoint> keypoints;
+
+    /**
+     * @brief Scores from analyzer detections, NaN for labels without one
+     *
+     * Run the analyzer with a confidence threshold of 0 to get every
+     * score, so thresholds can be chosen later from the store.
+     */
+    void setPredictions(const std::vector<ChestXRayAnalyzer::Detection>& detections,
+                        const std::vector<std::string>& labels);
+};
+
+/**
+ * @class FeatureStoreWriter
+ * @brief Appends records to a feature store file
+ *
+ * The file holds a header (prediction labels, texture size) followed by
+ * blocks of records. Each block stores its records column by column:
+ * hashes, ids, predictions, texture features, run-length encoded masks
+ * and keypoints, each column contiguous and 8-byte aligned so readers
+ * can use it in place. Records are encoded into the columns as they are
+ * appended and written a block at a time; a block cut short by a crash
+ * is dropped on the next open.
+ * Opening an existing file appends to it. Not thread safe.
+ */
+class FeatureStoreWriter {
+public:
+    /**
+     * @param filepath Created if missing
+     * @param labels Names of the prediction scores, e.g. getAvailablePathologies()
+     * @param textureSize Texture features per record; 0 until a texture
+     *        extractor exists (FeatureDetector::extractTextureFeatures is
+     *        not implemented), the column then takes no space
+     * @param blockSize Records buffered per block
+     * @throws std::runtime_error if an existing file has other labels or
+     *         texture size, or on I/O errors
+     */
+    FeatureStoreWriter(const std::string& filepath, const std::vector<std::string>& labels,
+                       int textureSize = 0, size_t blockSize = 4096);
+
+    /**
+     * @brief Flushes pending records, errors are lost; call flush() to see them
+     */
+    ~FeatureStoreWriter();
+
+    // Disable copy
+    FeatureStoreWriter(const FeatureStoreWriter&) = delete;
+    FeatureStoreWriter& operator=(const FeatureStoreWriter&) = delete;
+
+    /**
+     * @throws std::runtime_error if predictions or texture have the wrong
+     *         size, the mask is not 8-bit single channel, or on I/O errors
+     */
+    void append(const FeatureRecord& record);
+
+    /**
+     * @brief Write buffered records as a block
+     * @throws std::runtime_error on I/O errors
+     */
+    void flush();
+
+    // Records in the file and buffered
+    size_t size() const { return written_ + pendingCount_; }
+
+private:
+    // Columns of the block being filled, records are encoded on append
+    struct PendingBlock;
+
+    std::ofstream out_;
+    std::string filepath_;
+    size_t labelCount_;
+    size_t textureSize_;
+    size_t blockSize_;
+    size_t written_{0};
+    size_t pendingCount_{0};
+    std::unique_ptr<PendingBlock> pending_;
+};
+
+/**
+ * @class FeatureStoreReader
+ * @brief Memory-mapped, read-only view of a feature store file
+ *
+ * Opening only walks the block headers; columns are read in place from
+ * the mapping when used, so scanning predictions over a million images
+ * touches the prediction columns and nothing else. Lookups by image hash
+ * go through a DuplicateIndex built on first use. Safe to use from
+ * several threads.
+ */
+class FeatureStoreReader {
+public:
+    // cv::KeyPoint as stored
+    struct StoredKeypoint {
+        float x, y, size, angle, response;
+        int32_t octave, classId;
+    };
+
+    // Columns of one block, all pointing into the mapping
+    struct Block {
+        size_t first{0};                    // Index of its first record
+        size_t count{0};
+        const uint64_t* perceptual{nullptr};
+        const uint64_t* difference{nullptr};
+        const uint32_t* idOffsets{nullptr}; // count + 1 offsets into idChars
+        const char* idChars{nullptr};
+        const float* predictions{nullptr};  // count x labels().size()
+        const float* texture{nullptr};      // count x textureSize()
+        const int32_t* maskSizes{nullptr};  // Rows and columns per record, 0 x 0 for none
+        const uint32_t* runOffsets{nullptr};// count + 1 offsets into runs
+        const uint32_t* runs{nullptr};      // Alternating outside/inside run lengths
+        const uint32_t* keypointOffsets{nullptr};
+        const StoredKeypoint* keypoints{nullptr};
+    };
+
+    /**
+     * @throws std::runtime_error if the file cannot be mapped or is not a feature store
+     */
+    explicit FeatureStoreReader(const std::string& filepath);
+
+    size_t size() const { return size_; }
+    const std::vector<std::string>& labels() const { return labels_; }
+    size_t textureSize() const { return textureSize_; }
+
+    // Bytes of complete blocks, the writer truncates anything after them
+    size_t validBytes() const { return validBytes_; }
+
+    /**
+     * @brief Blocks in record order, for scans over whole columns
+     */
+    const std::vector<Block>& blocks() const { return blocks_; }
+
+    // Record accessors, i < size()
+    std::string_view imageId(size_t i) const;
+    ImageHashes hashes(size_t i) const;
+    const float* predictions(size_t i) const;
+    const float* texture(size_t i) const;
+    cv::Mat mask(size_t i) const;
+    std::vector<cv::KeyPoint> keypoints(size_t i) const;
+    FeatureRecord record(size_t i) const;
+
+    /**
+     * @brief Records whose perceptual hash is within maxDistance bits, closest first
+     */
+    std::vector<size_t> find(uint64_t perceptualHash, int maxDistance = 0) const;
+
+private:
+    // Block holding record i and its row in it
+    const Block& locate(size_t i, size_t& row) const;
+
+    std::unique_ptr<MappedFile> file_;
+    std::vector<std::string> labels_;
+    size_t textureSize_{0};
+    size_t size_{0};
+    size_t validBytes_{0};
+    std::vector<Block> blocks_;
+
+    mutable std::once_flag indexed_;
+    mutable DuplicateIndex index_;
+};
+
+} // namespace medical_vision
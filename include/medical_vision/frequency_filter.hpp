@@ -0,0 +1,151 @@
+/**
+ * @file frequency_filter.hpp
+ * @brief Linear filtering through real DFTs, for kernels too large to convolve
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @class FrequencyResponse
+ * @brief Real gain of a linear filter as a function of frequency
+ *
+ * The gain is evaluated once per DFT size, in the packed (CCS) layout of
+ * OpenCV's real-to-complex transform, and kept for the next images of that
+ * size. Copies share the sampled gains.
+ */
+class FrequencyResponse {
+public:
+    // Gain at (fx, fy) in cycles per pixel, both in [-0.5, 0.5]. Must be
+    // even, gain(fx, fy) == gain(-fx, -fy), as for any real filter.
+    using Gain = std::function<double(double fx, double fy)>;
+
+    /**
+     * @param gain Gain of the filter
+     * @param supportX Horizontal radius of the filter in pixels, the image
+     *        is padded by that much so the DFT does not wrap around into it
+     * @param supportY Vertical radius
+     */
+    FrequencyResponse(Gain gain, int supportX, int supportY);
+
+    /**
+     * @brief Same filter as cv::GaussianBlur with these arguments
+     *
+     * The response is the transform of the truncated kernel OpenCV uses,
+     * so both paths agree up to rounding.
+     */
+    static FrequencyResponse gaussian(cv::Size kernelSize, double sigmaX, double sigmaY, int depth);
+
+    /**
+     * @brief Untruncated Gaussian, exp(-2 pi^2 sigma^2 f^2), support 3 sigma
+     */
+    static FrequencyResponse gaussian(double sigma);
+
+    int supportX() const { return supportX_; }
+    int supportY() const { return supportY_; }
+
+    /**
+     * @brief Gains in the CCS layout of a real DFT of that size (CV_32FC1)
+     *
+     * Thread safe. The last few sizes are kept.
+     */
+    cv::Mat sampled(const cv::Size& dftSize) const;
+
+private:
+    struct Samples {
+        std::mutex mutex;
+        std::map<std::pair<int, int>, cv::Mat> bySize;
+        std::vector<std::pair<int, int>> order;     // Oldest first
+    };
+
+    Gain gain_;
+    int supportX_;
+    int supportY_;
+    std::shared_ptr<Samples> samples_;
+};
+
+/**
+ * @class FrequencyFilter
+ * @brief Applies frequency responses, and tells when that beats convolving
+ *
+ * Each plane is converted to float, padded by the support of the response
+ * (reflected like cv::filter2D borders) to a fast DFT size, transformed
+ * real-to-complex, multiplied by the sampled gains and transformed back.
+ * The cost no longer depends on the kernel size, so past some size it is
+ * cheaper than a separable convolution; the cost model picks the path.
+ */
+class FrequencyFilter {
+public:
+    // Padding and transform size for an image size and filter support
+    struct Plan {
+        cv::Size dftSize;
+        int top{0}, bottom{0}, left{0}, right{0};
+    };
+
+    // Padded real DFT of one plane, to apply several responses to it
+    struct Spectrum {
+        Plan plan;
+        cv::Size imageSize;
+        cv::Mat data;
+    };
+
+    static FrequencyFilter& instance();
+
+    /**
+     * @brief Plan for an image size and filter support, the most recent ones cached
+     */
+    Plan plan(const cv::Size& imageSize, int supportX, int supportY);
+    static Plan makePlan(const cv::Size& imageSize, int supportX, int supportY);
+
+    /**
+     * @brief Filter every channel of an 8-bit, 16-bit or float image
+     * @param output Same size and type as image, may be image
+     * @throws std::runtime_error for other depths
+     */
+    void apply(const cv::Mat& image, cv::Mat& output, const FrequencyResponse& response,
+               int borderType = cv::BORDER_REFLECT_101);
+
+    /**
+     * @brief Transform a single channel image padded by the given support
+     */
+    void forward(const cv::Mat& plane, Spectrum& spectrum, int supportX, int supportY,
+                 int borderType = cv::BORDER_REFLECT_101);
+
+    /**
+     * @brief Filtered image from a spectrum, cropped to the image size
+     *
+     * The spectrum is left untouched. Its padding should cover the
+     * support of the response.
+     */
+    void inverse(const Spectrum& spectrum, const FrequencyResponse& response, cv::Mat& output,
+                 int depth = CV_32F);
+
+    /**
+     * @brief Rough costs in nanoseconds of the two ways to apply a
+     *        separable kernel of that size, for the cost model
+     */
+    static double spatialCost(const cv::Mat& image, cv::Size kernelSize);
+    static double frequencyCost(const cv::Mat& image, cv::Size kernelSize);
+
+    static bool prefersFrequency(const cv::Mat& image, cv::Size kernelSize) {
+        return frequencyCost(image, kernelSize) < spatialCost(image, kernelSize);
+    }
+
+private:
+    FrequencyFilter() = default;
+
+    std::mutex mutex_;
+    std::map<std::tuple<int, int, int, int>, Plan> plans_;
+    std::vector<std::tuple<int, int, int, int>> planOrder_;    // Least recently used first
+};
+
+} // namespace medical_vision
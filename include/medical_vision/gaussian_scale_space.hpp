@@ -0,0 +1,66 @@
+/**
+ * @file gaussian_scale_space.hpp
+ * @brief Gaussian blurs of one image at several large sigmas
+ */
+
+#pragma once
+
+#include "frequency_filter.hpp"
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @class GaussianScaleSpace
+ * @brief Shares the work of blurring one image at several sigmas
+ *
+ * Meant for illumination estimates (retinex, homomorphic filtering),
+ * whose blurs are smooth: the image is area-downsampled until the
+ * smallest sigma spans a few pixels, padded and transformed once, and
+ * every scale is then a product with its Gaussian response and one
+ * inverse DFT at the reduced size. Three scales cost about one large
+ * blur. The downsample size and the responses, sampled for its DFT size,
+ * are kept while images and sigmas stay the same. Not to be shared
+ * between threads.
+ */
+class GaussianScaleSpace {
+public:
+    /**
+     * @param minWorkSigma Smallest sigma left at the reduced size, in pixels
+     */
+    explicit GaussianScaleSpace(double minWorkSigma = 2.0) : minWorkSigma_(minWorkSigma) {}
+
+    /**
+     * @brief Blur a single channel image at every sigma
+     * @param image Any depth, processed as float
+     * @param sigmas In pixels of the image
+     * @throws std::runtime_error for multi-channel images or sigmas <= 0
+     */
+    void compute(const cv::Mat& image, const std::vector<double>& sigmas);
+
+    size_t levels() const { return levels_.size(); }
+
+    /**
+     * @brief Blur number i, upsampled to the image size (CV_32F)
+     */
+    void level(size_t i, cv::Mat& output) const;
+
+private:
+    void prepare(const cv::Size& imageSize, const std::vector<double>& sigmas);
+
+    double minWorkSigma_;
+
+    // Plan for the last image size and sigmas
+    cv::Size imageSize_;
+    cv::Size workSize_;
+    std::vector<double> sigmas_;
+    std::vector<FrequencyResponse> responses_;
+    int support_{0};                // Padding covering the largest sigma
+
+    cv::Mat work_;
+    FrequencyFilter::Spectrum spectrum_;
+    std::vector<cv::Mat> levels_;   // At the work size
+};
+
+} // namespace medical_vision
@@ -0,0 +1,64 @@
+/**
+ * @file image_cache.hpp
+ * @brief Fast lossless storage for intermediate images and masks
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @brief Extension of cache images, picked up by saveImage and loadImage
+ */
+constexpr const char* CACHE_IMAGE_EXTENSION = ".mvc";
+
+/**
+ * @brief Compression applied to the stripes of a cache image
+ *
+ * DELTA predicts each sample from its neighbours (LOCO-I median predictor)
+ * and Huffman-codes the residual byte planes, it applies to 8 and 16-bit
+ * images. MASK_RLE run-length encodes single channel 8-bit images. AUTO
+ * picks per stripe, and any stripe that would grow is stored raw.
+ */
+enum class CacheCompression {
+    AUTO,
+    DELTA,
+    MASK_RLE
+};
+
+/**
+ * @brief Encode an image into the cache format
+ * @param image Image of any depth and channel count
+ * @param compression Stripe compression
+ * @return Encoded bytes, stripes are compressed in parallel
+ */
+std::vector<uchar> encodeCacheImage(const cv::Mat& image,
+                                    CacheCompression compression = CacheCompression::AUTO);
+
+/**
+ * @brief Decode an image produced by encodeCacheImage
+ * @throws std::runtime_error if the data is corrupted
+ */
+cv::Mat decodeCacheImage(const uchar* data, size_t size);
+
+/**
+ * @brief Encode and write an image, returns false on I/O errors
+ */
+bool writeCacheImage(const std::string& filepath, const cv::Mat& image,
+                     CacheCompression compression = CacheCompression::AUTO);
+
+/**
+ * @brief Read a cache image, returns an empty matrix on failure like cv::imread
+ */
+cv::Mat readCacheImage(const std::string& filepath);
+
+/**
+ * @brief Check whether a path has the cache image extension
+ */
+bool isCacheImagePath(const std::string& filepath);
+
+} // namespace medical_vision
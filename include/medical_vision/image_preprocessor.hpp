@@ -5,8 +5,18 @@
 
 #pragma once
 
+#include "bone_suppression.hpp"
+#include "dicom_image.hpp"
+#include "frequency_filter.hpp"
+#include "gaussian_scale_space.hpp"
+#include "recursive_gaussian.hpp"
 #include <opencv2/core.hpp>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
+#include <tuple>
+#include <vector>
 
 namespace medical_vision {
 
@@ -32,7 +42,29 @@ public:
     enum class HistogramMethod {
         EQUALIZATION,
         CLAHE,  // Contrast Limited Adaptive Histogram Equalization
-        STRETCHING
+        STRETCHING,
+        HOMOMORPHIC,  // Illumination damped in the log domain
+        RETINEX       // Multi-scale retinex
+    };
+
+    /**
+     * @brief How Gaussian blurs are executed
+     */
+    enum class FilterExecution {
+        AUTO,       // Recursive above the sigma threshold, else the cheaper of spatial and frequency
+        SPATIAL,    // Separable convolution
+        FREQUENCY,  // Real DFTs, the cost does not grow with the kernel
+        RECURSIVE   // RecursiveGaussian, constant cost per pixel, approximate
+    };
+
+    /**
+     * @brief Parameters of automatic border cropping
+     */
+    struct AutoCropParams {
+        double tolerance{10};             // Difference from the border level that is content (8-bit units)
+        double maxContentFraction{0.02};  // Rows/columns with less content are margin, e.g. burned-in text
+        int margin{4};                    // Pixels kept around the content
+        double minKeptFraction{0.3};      // Keeping less width or height means the detection failed
     };
 
 public:
@@ -47,6 +79,73 @@ public:
     bool loadImage(const std::string& filepath);
     bool saveImage(const std::string& filepath) const;
 
+    /**
+     * @brief Re-window the 16-bit source of a DICOM image
+     * @param center Window center in modality units
+     * @param width Window width in modality units
+     * @return false when the current image does not come from a DICOM file
+     *
+     * Replaces both the original and the working image, so processing
+     * has to be applied again afterwards.
+     */
+    bool setWindow(double center, double width);
+
+    /**
+     * @brief Crop uniform borders and collimated margins off the image
+     * @return false when no image is loaded
+     *
+     * The working and original images become views of the content
+     * (no pixels are copied), so every later step processes less.
+     * Crops accumulate until another image is loaded.
+     */
+    bool autoCrop(const AutoCropParams& params = AutoCropParams());
+
+    // Crop applied to the loaded image, in its coordinates, empty if none
+    cv::Rect getCropRect() const { return crop_; }
+
+    // DICOM source of the current image, nullptr for other formats
+    const DicomImage* getDicom() const { return dicom_.get(); }
+
+    /**
+     * @brief Restrict the expensive operations to a region of the image
+     * @param region Rectangle in image coordinates, empty for the full frame
+     *
+     * Denoising and the blurs (gaussianBlur, medianBlur, bilateralFilter,
+     * nonLocalMeans), histogram processing including CLAHE, homomorphic
+     * filtering and retinex, and suppressBones then only read and change
+     * the pixels inside the region, which also makes the histogram methods
+     * adapt to its content. normalize, contrast and sharpening still cover
+     * the whole image. Cleared when another image is loaded.
+     */
+    void setRegionOfInterest(const cv::Rect& region);
+
+    /**
+     * @brief Restrict to the bounds of a mask, e.g. Segmentation::lungMask
+     * @param margin Pixels of context kept around the mask
+     */
+    void setRegionOfInterest(const cv::Mat& mask, int margin = 16);
+    void clearRegionOfInterest() { region_ = cv::Rect(); }
+    cv::Rect getRegionOfInterest() const { return region_; }
+
+    /**
+     * @brief Choose how gaussianBlur and unsharpMask filter
+     *
+     * Spatial and frequency execution give the same result up to
+     * rounding, the frequency one pays off for large sigmas on large
+     * images. Recursive execution approximates the untruncated Gaussian
+     * at a cost independent of sigma.
+     */
+    void setFilterExecution(FilterExecution execution) { filterExecution_ = execution; }
+    FilterExecution getFilterExecution() const { return filterExecution_; }
+
+    /**
+     * @brief Sigma from which AUTO execution blurs recursively
+     *
+     * Only applies when the kernel size covers +-3 sigma, smaller kernels
+     * truncate the Gaussian too much for the recursive approximation.
+     */
+    void setRecursiveSigmaThreshold(double sigma) { recursiveSigmaThreshold_ = sigma; }
+
     // Image information
     cv::Size getImageSize() const;
     int getChannels() const;
@@ -65,10 +164,38 @@ public:
     bool histogramProcessing(HistogramMethod method);
     bool clahe(double clipLimit = 3.5, cv::Size tileGridSize = cv::Size(8, 8));
 
+    /**
+     * @brief Equalize exposure across the film by homomorphic filtering
+     * @param sigma Illumination blur, as a fraction of the longest side
+     * @param lowGain Gain of the illumination in the log domain (< 1 flattens it)
+     * @param highGain Gain of the detail in the log domain
+     *
+     * The result is stretched to the range of the image depth.
+     */
+    bool homomorphicFilter(double sigma = 0.04, double lowGain = 0.5, double highGain = 1.5);
+
+    /**
+     * @brief Equalize exposure with multi-scale retinex
+     * @param scales Surround blurs, as fractions of the longest side
+     *
+     * All scales come from one GaussianScaleSpace, so they cost about one
+     * large blur. The result is stretched to the range of the image depth.
+     */
+    bool multiScaleRetinex(const std::vector<double>& scales = {0.01, 0.04, 0.12});
+
     // Edge enhancement
     bool sharpen(double strength = 1.0);
     bool unsharpMask(double sigma = 1.0, double strength = 1.5);
 
+    /**
+     * @brief Attenuate rib shadows on frontal chest films
+     * @param strength Fraction of the rib component removed (0-1)
+     *
+     * See BoneSuppressor; its plan is kept across images of the same size.
+     * Color images are processed on their lightness.
+     */
+    bool suppressBones(double strength = 0.7);
+
     // Utility functions
     bool isLoaded() const { return !image_.empty(); }
     void reset() { image_ = originalImage_.clone(); }
@@ -78,12 +205,53 @@ public:
     const cv::Mat& getOriginalImage() const { return originalImage_; }
     cv::Mat getHistogram() const;
 
+    /**
+     * @brief Compute per-channel histogram bins without rendering them
+     * @param image Input image of any depth and channel count
+     * @param bins Number of bins spanning 0-255 for 8-bit images, the bits in
+     *        use for 16-bit images (0-4095 for 12-bit data) and the actual
+     *        range for float images
+     * @return One bins x 1 CV_32F matrix of counts per channel
+     */
+    static std::vector<cv::Mat> computeHistogram(const cv::Mat& image, int bins = 256);
+
+    /**
+     * @brief Bounds of the content inside uniform or collimated margins
+     * @param image 8 or 16-bit image, color images are judged on their gray level
+     * @return The full image rectangle when no margin is found
+     *
+     * Each side's border level is the median of its outermost row or
+     * column. A single pass counts, per row and column, the pixels that
+     * differ from the levels of the sides by more than the tolerance, and
+     * the margins are the outer rows and columns with too few of them,
+     * rows being judged between the side margins and columns between the
+     * top and bottom ones.
+     */
+    static cv::Rect detectContentBounds(const cv::Mat& image,
+                                        const AutoCropParams& params = AutoCropParams());
+
 private:
     cv::Mat image_;          // Current working image
     cv::Mat originalImage_;  // Original image backup
+    std::unique_ptr<DicomImage> dicom_;  // Keeps the mapped DICOM pixels alive
+    cv::Rect region_;        // Region of interest, empty for the full frame
+    cv::Rect crop_;          // Applied crop in loaded image coordinates
+    BoneSuppressor boneSuppressor_;
+    FilterExecution filterExecution_{FilterExecution::AUTO};
+    double recursiveSigmaThreshold_{5.0};
+    GaussianScaleSpace scaleSpace_;     // Blurs of homomorphic filtering and retinex
+
+    // Response of the last Gaussian run in the frequency domain, with its
+    // sampled gains, keyed by kernel size, sigma and depth
+    std::optional<FrequencyResponse> blurResponse_;
+    std::tuple<int, int, double, int> blurKey_;
     
     // Utility functions
     bool checkImageLoaded() const;
+    // Runs an in-place operation on the region of interest of image_
+    void applyInRegion(const std::function<void(cv::Mat&)>& operation);
+    // cv::GaussianBlur, or its frequency domain equivalent when cheaper
+    void gaussianFilter(const cv::Mat& image, cv::Mat& output, cv::Size kernelSize, double sigma);
     void updateOriginalImage();
     bool validateKernelSize(int kernelSize) const;
 };
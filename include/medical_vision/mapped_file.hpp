@@ -0,0 +1,47 @@
+/**
+ * @file mapped_file.hpp
+ * @brief Read-only memory mapping of a whole file
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace medical_vision {
+
+/**
+ * @class MappedFile
+ * @brief Maps a file read-only for its lifetime
+ *
+ * Pages are read on first access, so opening a large file costs nothing
+ * until its data is used, and untouched parts are never read.
+ */
+class MappedFile {
+public:
+    /**
+     * @throws std::runtime_error if the file cannot be opened or mapped
+     */
+    explicit MappedFile(const std::string& filepath);
+    ~MappedFile();
+
+    // Disable copy
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void release();
+
+    const uint8_t* data_{nullptr};
+    size_t size_{0};
+#ifdef _WIN32
+    void* file_{nullptr};
+    void* mapping_{nullptr};
+#endif
+};
+
+} // namespace medical_vision
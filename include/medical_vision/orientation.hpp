@@ -0,0 +1,57 @@
+/**
+ * @file orientation.hpp
+ * @brief Detection and correction of rotated or inverted frontal chest films
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+
+namespace medical_vision {
+
+/**
+ * @brief Correction that makes a film upright with bright bone
+ */
+struct OrientationEstimate {
+    int quarterTurns{0};            // Clockwise quarter turns to apply: 0, 1 or 3
+    bool inverted{false};           // Dense tissue is dark, e.g. MONOCHROME1 exported as is
+
+    // How far the evidence is from undecided, relative to the contrast;
+    // nothing is corrected below the minimum confidence
+    double rotationConfidence{0.0};
+    double directionConfidence{0.0};    // Which way to turn, for rotated films only
+    double inversionConfidence{0.0};
+
+    bool needsCorrection() const { return quarterTurns != 0 || inverted; }
+};
+
+/**
+ * @brief Estimate rotation and inversion from a small downsample
+ * @param image 8 or 16-bit gray or color image
+ * @param analysisSize Longest side of the downsample measured
+ * @param minConfidence Evidence needed before correcting anything
+ *
+ * The spine and mediastinum make the central band of an upright film
+ * brighter than the lungs beside it. Projection profiles tell whether
+ * that band runs vertically (upright) or horizontally (rotated) and
+ * whether it is brighter or darker than the lungs, which together with
+ * the level of the border against the median (air outside the body is
+ * dark) decides inversion. For rotated films the central band brightens
+ * towards the heart and abdomen, which tells which way to turn; rotated
+ * films whose band is too even are left unturned. 180 degree turns are
+ * not detected.
+ */
+OrientationEstimate estimateOrientation(const cv::Mat& image, int analysisSize = 128,
+                                        double minConfidence = 0.05);
+
+/**
+ * @brief Apply an estimate, output shares the image data when nothing changes
+ */
+void correctOrientation(const cv::Mat& image, cv::Mat& output, const OrientationEstimate& estimate);
+
+/**
+ * @brief Undo the rotation of an estimate, e.g. on maps computed from a corrected image
+ */
+void restoreOrientation(const cv::Mat& image, cv::Mat& output, const OrientationEstimate& estimate);
+
+} // namespace medical_vision
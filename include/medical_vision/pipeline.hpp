@@ -0,0 +1,159 @@
+/**
+ * @file pipeline.hpp
+ * @brief Declarative processing pipelines, planned once and run on many images
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @brief Depth and channel count of the images flowing between steps
+ */
+struct ImageFormat {
+    int depth{CV_8U};   // CV_8U, CV_16U or CV_32F
+    int channels{1};    // 1, 3 (BGR) or 4 (BGRA)
+
+    int type() const { return CV_MAKETYPE(depth, channels); }
+    bool operator==(const ImageFormat& other) const {
+        return depth == other.depth && channels == other.channels;
+    }
+    bool operator!=(const ImageFormat& other) const { return !(*this == other); }
+
+    /**
+     * @brief Format of an image
+     * @throws std::runtime_error for depths and channel counts pipelines do not handle
+     */
+    static ImageFormat of(const cv::Mat& image);
+
+    /**
+     * @brief Parse names like "8UC1" or "32FC3"
+     * @throws std::runtime_error if the name is not a supported format
+     */
+    static ImageFormat parse(const std::string& name);
+    std::string name() const;
+};
+
+/**
+ * @brief One step of a pipeline specification
+ */
+struct PipelineStep {
+    std::string op;
+    std::map<std::string, double> numbers;
+    std::map<std::string, std::string> strings;
+};
+
+/**
+ * @class PipelineSpec
+ * @brief Pipeline read from a JSON or YAML document
+ *
+ * The document holds a "steps" sequence of maps, each with an "op" name and
+ * the parameters of that operation, plus optional "input" and "output"
+ * formats:
+ * @code
+ * { "input": "8UC1",
+ *   "steps": [ { "op": "normalize", "min": 0, "max": 255 },
+ *              { "op": "clahe", "clip_limit": 2.0 },
+ *              { "op": "sharpen", "strength": 1.2 } ] }
+ * @endcode
+ * YAML documents start with the "%YAML:1.0" line cv::FileStorage expects.
+ * Operations and parameters are checked when the spec is planned.
+ */
+class PipelineSpec {
+public:
+    std::vector<PipelineStep> steps;
+    bool hasInput{false};
+    ImageFormat input;      // Default input format for plans
+    bool hasOutput{false};
+    ImageFormat output;     // Converted to at the end when set
+
+    /**
+     * @brief Read a spec file, the format follows the extension (.json, .yaml, .yml)
+     * @throws std::runtime_error if the file cannot be read or is malformed
+     */
+    static PipelineSpec load(const std::string& filepath);
+
+    /**
+     * @brief Read a spec from JSON or YAML text
+     * @throws std::runtime_error if the text is malformed
+     */
+    static PipelineSpec parse(const std::string& text);
+
+    /**
+     * @brief Names of the supported operations
+     */
+    static std::vector<std::string> operations();
+};
+
+/**
+ * @class PipelinePlan
+ * @brief Validated and optimized pipeline ready to run repeatedly
+ *
+ * Planning follows the image format through the steps and rejects
+ * unknown operations or invalid parameters before any image is processed.
+ * Depth and channel conversions are inserted only before steps that
+ * cannot take the current format (depth conversions scale between full
+ * ranges, 32F images are in [0, 1]). Chains of affine steps are merged
+ * into a single convertTo when no intermediate result would saturate, and
+ * all intermediate buffers are allocated up front and reused by every run.
+ */
+class PipelinePlan {
+public:
+    /**
+     * @brief Plan a spec for images of a given format and size
+     * @throws std::runtime_error naming the offending step if the spec is invalid
+     */
+    PipelinePlan(const PipelineSpec& spec, const ImageFormat& input, cv::Size size);
+
+    /**
+     * @brief Plan for the input format declared in the spec
+     */
+    PipelinePlan(const PipelineSpec& spec, cv::Size size);
+
+    /**
+     * @brief Process one image
+     * @return Result sharing the plan's buffers, overwritten by the next run
+     * @throws std::runtime_error if the image is not in the planned input format
+     *
+     * Images of another size are accepted, the buffers are resized for them.
+     */
+    cv::Mat run(const cv::Mat& input);
+
+    ImageFormat inputFormat() const { return input_; }
+    ImageFormat outputFormat() const { return output_; }
+    size_t bufferCount() const { return buffers_.size(); }
+
+    /**
+     * @brief One line per executed stage, showing inserted and merged steps
+     */
+    std::string describe() const;
+
+    // Reads source, writes target which already has the stage's output format and size
+    using Kernel = std::function<void(const cv::Mat& source, cv::Mat& target)>;
+
+private:
+    struct Stage {
+        std::string label;
+        ImageFormat format;     // Output format
+        Kernel apply;
+        int source{-1};         // Buffer index, -1 for the input image
+        int target{0};
+    };
+
+    void assignBuffers();
+
+    ImageFormat input_;
+    ImageFormat output_;
+    cv::Size size_;
+    std::vector<Stage> stages_;
+    std::vector<cv::Mat> buffers_;
+    std::vector<ImageFormat> bufferFormats_;
+};
+
+} // namespace medical_vision
@@ -0,0 +1,85 @@
+/**
+ * @file quality_assessment.hpp
+ * @brief Cheap image quality metrics to skip or reroute films before inference
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <string>
+
+namespace medical_vision {
+
+/**
+ * @brief Limits an image must meet to pass assessQuality
+ *
+ * Levels are in 8-bit units, 16-bit images are scaled to that range.
+ */
+struct QualityThresholds {
+    int analysisSize{256};              // Longest side of the downsample measured
+    int minSize{200};                   // Smallest accepted width and height
+    double minSharpness{15.0};          // Variance of the Laplacian of the downsample
+    double minContrast{50.0};           // Spread between the 1st and 99th percentiles
+    double minBrightLevel{90.0};        // Lower 99th percentile is underexposed
+    double maxDarkLevel{165.0};         // Higher 1st percentile is overexposed
+    double maxClippedFraction{0.25};    // Pixels at the maximum value
+    double maxNoise{8.0};               // Estimated noise standard deviation
+    double minOrientation{0.0};         // Lower means no bright vertical spine axis
+};
+
+/**
+ * @brief Metrics of one image and the thresholds it failed
+ *
+ * Each metric is also scored, 0.5 at its threshold and reaching 1 or 0 a
+ * threshold's worth better or worse; score is the lowest of them, so
+ * images can be ranked as well as gated.
+ */
+struct QualityReport {
+    enum Issue : uint32_t {
+        UNSUPPORTED  = 1 << 0,     // Empty, or not 8/16-bit gray or color
+        TOO_SMALL    = 1 << 1,
+        BLURRY       = 1 << 2,
+        LOW_CONTRAST = 1 << 3,
+        UNDEREXPOSED = 1 << 4,
+        OVEREXPOSED  = 1 << 5,
+        NOISY        = 1 << 6,
+        ORIENTATION  = 1 << 7      // Rotated, inverted, or not a frontal chest film
+    };
+
+    double sharpness{0.0};
+    double contrast{0.0};
+    double darkLevel{0.0};          // 1st percentile
+    double medianLevel{0.0};
+    double brightLevel{0.0};        // 99th percentile
+    double clippedFraction{0.0};
+    double noise{0.0};
+
+    // Brightness of the central column band over the lateral ones, minus the
+    // same for the central row band, relative to the contrast: the spine and
+    // mediastinum make it positive on upright frontal films
+    double orientation{0.0};
+
+    double score{0.0};
+    uint32_t issues{0};
+
+    bool acceptable() const { return issues == 0; }
+    bool has(Issue issue) const { return (issues & issue) != 0; }
+
+    // Comma separated names of the issues, empty when acceptable
+    std::string describe() const;
+};
+
+/**
+ * @brief Measure blur, exposure, noise and orientation
+ *
+ * The image is area-downsampled to thresholds.analysisSize and converted
+ * to 8-bit gray, then a single pass over the downsample gathers the
+ * histogram, Laplacian moments, Immerkaer's noise estimate and the row
+ * and column profiles all metrics come from. Never throws; unsupported
+ * images are reported as such.
+ */
+QualityReport assessQuality(const cv::Mat& image,
+                            const QualityThresholds& thresholds = QualityThresholds());
+
+} // namespace medical_vision
@@ -0,0 +1,60 @@
+/**
+ * @file recursive_gaussian.hpp
+ * @brief Gaussian blur whose cost does not depend on sigma
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+
+namespace medical_vision {
+
+/**
+ * @class RecursiveGaussian
+ * @brief Young-van Vliet recursive approximation of a Gaussian blur
+ *
+ * Each axis is filtered by a third order causal recursion followed by an
+ * anti-causal one, a fixed 8 multiply-adds per pixel and axis whatever
+ * the sigma. The vertical pass runs down the rows with every column
+ * filtered at once, so the inner loop is contiguous and vectorizes; the
+ * horizontal pass transposes blocks of rows and filters them the same
+ * way. Both passes are split over the TaskScheduler.
+ *
+ * Edges are replicated, with the Triggs-Sdika initialization of the
+ * anti-causal pass. The impulse response is within a few percent of
+ * the peak of a true Gaussian for sigmas from 2 up; cv::GaussianBlur
+ * truncates its kernel and reflects edges, so the two differ slightly.
+ */
+class RecursiveGaussian {
+public:
+    /**
+     * @param sigmaX Horizontal sigma, at least 0.5
+     * @param sigmaY Vertical sigma, sigmaX when not positive
+     * @throws std::runtime_error for smaller sigmas
+     */
+    explicit RecursiveGaussian(double sigmaX, double sigmaY = 0.0);
+
+    double sigmaX() const { return x_.sigma; }
+    double sigmaY() const { return y_.sigma; }
+
+    /**
+     * @brief Blur an 8-bit, 16-bit or float image with any channel count
+     * @param output Same size and type, may be image
+     * @throws std::runtime_error for other depths
+     */
+    void apply(const cv::Mat& image, cv::Mat& output) const;
+
+    // Filter along one axis
+    struct Coefficients {
+        double sigma{0.0};
+        float b{1.0f};                      // Input gain, 1 - (a1 + a2 + a3)
+        float a1{0.0f}, a2{0.0f}, a3{0.0f}; // Feedback of the three previous outputs
+        float m[3][3]{};                    // Anti-causal state past the end from the causal one
+    };
+
+private:
+    Coefficients x_;
+    Coefficients y_;
+};
+
+} // namespace medical_vision
@@ -125,6 +125,26 @@ public:
      */
     std::vector<std::vector<cv::Point>> getContours(const cv::Mat& mask);
 
+    /**
+     * @brief Find the lung fields of a frontal chest radiograph
+     * @param input Input image
+     * @return Mask of the lungs (0/255), all zero when none are found
+     *
+     * Dark regions of the Otsu threshold that do not touch the image border
+     * (air around the body does) are kept, at most the two largest, and
+     * their holes closed. Meant to restrict processing to the lungs, not as
+     * a diagnostic segmentation.
+     */
+    cv::Mat lungMask(const cv::Mat& input);
+
+    /**
+     * @brief Bounding rectangle of the set pixels of a mask
+     * @param mask Single channel 8-bit mask
+     * @param margin Pixels added on every side, clipped to the mask
+     * @return Empty rectangle when no pixel is set
+     */
+    static cv::Rect maskBounds(const cv::Mat& mask, int margin = 0);
+
     /**
      * @brief Draw segmentation result on image
      * @param input Original image
@@ -134,6 +154,14 @@ public:
      */
     cv::Mat drawSegmentation(const cv::Mat& input, const cv::Mat& mask, double alpha = 0.5);
 
+    /**
+     * @brief Save a segmentation mask
+     * @param mask Segmentation mask
+     * @param filepath Output path, masks are run-length encoded for .mvc
+     * @return true if successful
+     */
+    static bool saveMask(const cv::Mat& mask, const std::string& filepath);
+
 private:
     /**
      * @brief Validate input image
@@ -0,0 +1,119 @@
+/**
+ * @file session_log.hpp
+ * @brief Compact binary log of interactive processing sessions
+ */
+
+#pragma once
+
+#include "image_preprocessor.hpp"
+#include "feature_detector.hpp"
+#include "segmentation.hpp"
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @brief Processing stages timed during a session
+ */
+enum class SessionStage {
+    LOAD,
+    DENOISE,
+    CLAHE,
+    SHARPEN,
+    EDGES,
+    KEYPOINTS,
+    SEGMENTATION,
+    COUNT
+};
+
+/**
+ * @brief Get a printable name for a stage
+ */
+const char* sessionStageName(SessionStage stage);
+
+/**
+ * @brief Settings driving one run of the interactive processing chain
+ */
+struct SessionSettings {
+    bool denoiseEnabled{false};
+    ImagePreprocessor::NoiseReductionMethod denoiseMethod{
+        ImagePreprocessor::NoiseReductionMethod::BILATERAL};
+    bool claheEnabled{false};
+    bool sharpenEnabled{false};
+    double sharpenStrength{1.0};
+
+    bool edgesEnabled{false};
+    FeatureDetector::EdgeDetector edgeMethod{FeatureDetector::EdgeDetector::CANNY};
+    FeatureDetector::EdgeParams edgeParams;
+
+    bool keypointsEnabled{false};
+    FeatureDetector::KeypointDetector keypointMethod{FeatureDetector::KeypointDetector::SIFT};
+    FeatureDetector::KeypointParams keypointParams;
+
+    bool segmentationEnabled{false};
+    Segmentation::Method segmentationMethod{Segmentation::Method::THRESHOLD};
+};
+
+/**
+ * @brief One recorded interaction
+ */
+struct SessionEvent {
+    enum class Type : uint8_t {
+        NAVIGATION,     // A new image was loaded
+        SETTINGS        // The processing chain ran with new settings
+    };
+
+    using StageTimes = std::array<float, static_cast<size_t>(SessionStage::COUNT)>;
+
+    Type type{Type::SETTINGS};
+    double timestamp{0.0};      // Seconds since the start of the session
+    std::string imagePath;      // Navigation only
+    SessionSettings settings;   // Settings only
+    StageTimes stageTimes{};    // Milliseconds per stage, 0 when not run
+};
+
+/**
+ * @class SessionRecorder
+ * @brief Appends session events to a compact binary file
+ */
+class SessionRecorder {
+public:
+    SessionRecorder() = default;
+    ~SessionRecorder() = default;
+
+    // Disable copy
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+    /**
+     * @brief Start a new log, overwriting any existing file
+     * @param filepath Output file
+     * @return true if the file could be created
+     */
+    bool open(const std::string& filepath);
+    void close();
+    bool isOpen() const { return file_.is_open(); }
+
+    /**
+     * @brief Append an event, the timestamp is filled in by the recorder
+     * @param event Event to record
+     */
+    void record(SessionEvent event);
+
+private:
+    std::ofstream file_;
+    double startTime_{0.0};
+};
+
+/**
+ * @brief Read all events of a session log
+ * @param filepath Log file written by SessionRecorder
+ * @return Recorded events in order
+ * @throws std::runtime_error if the file is missing or malformed
+ */
+std::vector<SessionEvent> readSessionLog(const std::string& filepath);
+
+} // namespace medical_vision
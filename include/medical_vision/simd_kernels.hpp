@@ -0,0 +1,36 @@
+/**
+ * @file simd_kernels.hpp
+ * @brief Hand-vectorized image kernels, dispatched on the CPU at runtime
+ */
+
+#pragma once
+
+#include "cpu_dispatch.hpp"
+#include <opencv2/core.hpp>
+
+namespace medical_vision {
+
+/**
+ * @brief Erosion of an 8-bit single channel image by the 3x3 cross
+ *
+ * The 3x3 cross is what cv::getStructuringElement returns for MORPH_ELLIPSE
+ * at that size, and pixels outside the image are ignored, so the result
+ * equals cv::erode with that element and the default border. src and dst
+ * may be the same matrix.
+ */
+void erodeCross3x3(const cv::Mat& src, cv::Mat& dst);
+
+/**
+ * @brief Dilation counterpart of erodeCross3x3()
+ */
+void dilateCross3x3(const cv::Mat& src, cv::Mat& dst);
+
+/**
+ * @brief Blend value into an 8-bit single channel image where mask is set
+ *
+ * dst = src * (1 - alpha) + value * alpha under the mask and src elsewhere,
+ * computed with 8-bit fixed point weights. src and dst may be the same.
+ */
+void blendMasked(const cv::Mat& src, const cv::Mat& mask, uchar value, double alpha, cv::Mat& dst);
+
+} // namespace medical_vision
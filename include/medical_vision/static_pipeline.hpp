@@ -0,0 +1,301 @@
+/**
+ * @file static_pipeline.hpp
+ * @brief Processing chains fixed at compile time, with fused per-pixel stages
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @brief Pixel counts of an 8-bit image, all channels together
+ */
+using Histogram8u = std::array<int64_t, 256>;
+
+/**
+ * @brief Count the values of an 8-bit image in parallel row stripes
+ */
+void countValues(const cv::Mat& image, Histogram8u& counts);
+
+namespace stages {
+
+/**
+ * @brief Base of stages that map each pixel value independently
+ *
+ * On 8-bit images consecutive point stages are fused: each one rewrites a
+ * 256 entry lookup table, given the histogram of the values it would see,
+ * and the image is mapped once through the composed table. Stages with
+ * USES_HISTOGRAM false are never given one. apply() handles other depths.
+ */
+struct PointStage {
+    static constexpr bool POINTWISE = true;
+    static constexpr bool USES_HISTOGRAM = false;
+    static constexpr bool GRAY_ONLY = false;    // Single channel result from any input
+};
+
+/**
+ * @brief Base of stages that look at neighbouring pixels
+ */
+struct FilterStage {
+    static constexpr bool POINTWISE = false;
+};
+
+// Same as ImagePreprocessor::normalize (min-max over all channels)
+struct Normalize : PointStage {
+    static constexpr bool USES_HISTOGRAM = true;
+    double minValue{0};
+    double maxValue{255};
+
+    Normalize() = default;
+    Normalize(double minValue, double maxValue) : minValue(minValue), maxValue(maxValue) {}
+    void apply(cv::Mat& image);
+    void mapTable(const Histogram8u& histogram, cv::Mat& table);
+};
+
+// Same as ImagePreprocessor::adjustContrast
+struct Contrast : PointStage {
+    double alpha{1.0};
+    double beta{0};
+
+    Contrast() = default;
+    Contrast(double alpha, double beta) : alpha(alpha), beta(beta) {}
+    void apply(cv::Mat& image);
+    void mapTable(const Histogram8u& histogram, cv::Mat& table);
+};
+
+// Same as Segmentation::threshold
+struct Threshold : PointStage {
+    static constexpr bool GRAY_ONLY = true;
+    double value{127};
+    double maxValue{255};
+    bool invert{false};
+
+    Threshold() = default;
+    Threshold(double value, double maxValue = 255, bool invert = false)
+        : value(value), maxValue(maxValue), invert(invert) {}
+    void apply(cv::Mat& image);
+    void mapTable(const Histogram8u& histogram, cv::Mat& table);
+};
+
+// Same as Segmentation::otsuThreshold, without the mask clean-up of
+// Segmentation::segment (follow with CleanMask for that)
+struct Otsu : PointStage {
+    static constexpr bool USES_HISTOGRAM = true;
+    static constexpr bool GRAY_ONLY = true;
+
+    void apply(cv::Mat& image);
+    void mapTable(const Histogram8u& histogram, cv::Mat& table);
+};
+
+// Same as ImagePreprocessor::clahe, the equalizer and its buffers are reused
+struct Clahe : FilterStage {
+    double clipLimit{3.5};
+    cv::Size tileGridSize{8, 8};
+
+    Clahe() = default;
+    Clahe(double clipLimit, cv::Size tileGridSize = cv::Size(8, 8))
+        : clipLimit(clipLimit), tileGridSize(tileGridSize) {}
+    void apply(cv::Mat& image);
+
+private:
+    cv::Ptr<cv::CLAHE> equalizer_;
+    cv::Mat lab_;
+    std::vector<cv::Mat> planes_;
+};
+
+// Same as ImagePreprocessor::sharpen
+struct Sharpen : FilterStage {
+    double strength{1.0};
+
+    Sharpen() = default;
+    explicit Sharpen(double strength) : strength(strength) {}
+    void apply(cv::Mat& image);
+
+private:
+    cv::Mat kernel_;
+    double kernelStrength_{0};
+    std::vector<cv::Mat> planes_;
+};
+
+// Same as ImagePreprocessor::unsharpMask
+struct UnsharpMask : FilterStage {
+    double sigma{1.0};
+    double strength{1.5};
+
+    UnsharpMask() = default;
+    UnsharpMask(double sigma, double strength) : sigma(sigma), strength(strength) {}
+    void apply(cv::Mat& image);
+
+private:
+    cv::Mat blurred_;
+    std::vector<cv::Mat> planes_;
+};
+
+// Same as ImagePreprocessor::gaussianBlur
+struct GaussianBlur : FilterStage {
+    int kernelSize{3};
+    double sigma{1.0};
+
+    GaussianBlur() = default;
+    GaussianBlur(int kernelSize, double sigma);     // Throws for even or non-positive sizes
+    void apply(cv::Mat& image);
+};
+
+// Same as ImagePreprocessor::medianBlur
+struct MedianBlur : FilterStage {
+    int kernelSize{3};
+
+    MedianBlur() = default;
+    explicit MedianBlur(int kernelSize);            // Throws for even or non-positive sizes
+    void apply(cv::Mat& image);
+};
+
+// Opening then closing of a mask, as Segmentation::segment does to every result
+struct CleanMask : FilterStage {
+    void apply(cv::Mat& image);
+};
+
+} // namespace stages
+
+/**
+ * @class Pipeline
+ * @brief Chain of stages resolved at compile time
+ *
+ * Each stage is called directly, without the method enums and checks of
+ * ImagePreprocessor and Segmentation, and produces the same result as the
+ * runtime method it names. Runs of consecutive point stages (Normalize,
+ * Contrast, Threshold, Otsu) are fused into a single pass over 8-bit
+ * images through a lookup table built from one histogram:
+ * @code
+ * Pipeline<stages::Normalize, stages::Clahe, stages::Sharpen,
+ *          stages::Otsu, stages::CleanMask> chain(
+ *     {}, stages::Clahe(2.0), stages::Sharpen(1.2), {}, {});
+ * cv::Mat mask = chain.run(image);    // Then ChestXRayAnalyzer etc.
+ * @endcode
+ * Stages keep their scratch buffers between runs, so a pipeline should
+ * not be shared between threads.
+ */
+template <typename... Stages>
+class Pipeline {
+public:
+    static_assert(sizeof...(Stages) > 0, "Pipeline needs at least one stage");
+
+    Pipeline() = default;
+    explicit Pipeline(Stages... stages) : stages_(std::move(stages)...) {}
+
+    /**
+     * @brief Process a copy of an image
+     */
+    cv::Mat run(const cv::Mat& input) {
+        cv::Mat image = input.clone();
+        apply(image);
+        return image;
+    }
+
+    /**
+     * @brief Process an image in place
+     */
+    void apply(cv::Mat& image) {
+        if (!image.empty()) {
+            applyFrom<0>(image);
+        }
+    }
+
+    /**
+     * @brief Number of passes over an 8-bit image, fused stages counting once
+     */
+    static constexpr size_t passCount() {
+        size_t passes = 0;
+        for (size_t i = 0; i < STAGE_COUNT; i = runEnd(i)) {
+            ++passes;
+        }
+        return passes;
+    }
+
+    template <size_t I>
+    auto& stage() { return std::get<I>(stages_); }
+
+private:
+    static constexpr size_t STAGE_COUNT = sizeof...(Stages);
+    static constexpr std::array<bool, STAGE_COUNT> POINTWISE{{Stages::POINTWISE...}};
+
+    // End of the run of stages executed together from stage first
+    static constexpr size_t runEnd(size_t first) {
+        if (!POINTWISE[first]) return first + 1;
+        size_t last = first + 1;
+        while (last < STAGE_COUNT && POINTWISE[last]) ++last;
+        return last;
+    }
+
+    template <size_t I>
+    void applyFrom(cv::Mat& image) {
+        if constexpr (I < STAGE_COUNT) {
+            constexpr size_t END = runEnd(I);
+            if constexpr (POINTWISE[I]) {
+                applyPoints<I, END>(image, std::make_index_sequence<END - I>());
+            } else {
+                std::get<I>(stages_).apply(image);
+            }
+            applyFrom<END>(image);
+        }
+    }
+
+    template <size_t FIRST, size_t END, size_t... OFFSETS>
+    void applyPoints(cv::Mat& image, std::index_sequence<OFFSETS...>) {
+        using Run = std::tuple<std::tuple_element_t<FIRST + OFFSETS, std::tuple<Stages...>>...>;
+        constexpr bool usesHistogram = (std::tuple_element_t<OFFSETS, Run>::USES_HISTOGRAM || ...);
+        constexpr bool grayOnly = (std::tuple_element_t<OFFSETS, Run>::GRAY_ONLY || ...);
+
+        // A single stage gains nothing from a table, neither do the
+        // conversions gray only stages make on color images
+        if (END - FIRST == 1 || image.depth() != CV_8U || (grayOnly && image.channels() != 1)) {
+            (std::get<FIRST + OFFSETS>(stages_).apply(image), ...);
+            return;
+        }
+
+        if (table_.empty()) {
+            table_.create(1, 256, CV_8U);
+        }
+        for (int value = 0; value < 256; ++value) {
+            table_.at<uchar>(value) = static_cast<uchar>(value);
+        }
+
+        if constexpr (usesHistogram) {
+            countValues(image, counts_);
+            (mapThrough(std::get<FIRST + OFFSETS>(stages_)), ...);
+        } else {
+            (std::get<FIRST + OFFSETS>(stages_).mapTable(counts_, table_), ...);
+        }
+        cv::LUT(image, table_, image);
+    }
+
+    // Hands a stage the histogram of the values the previous stages produce
+    template <typename Stage>
+    void mapThrough(Stage& stage) {
+        if constexpr (Stage::USES_HISTOGRAM) {
+            mapped_.fill(0);
+            for (int value = 0; value < 256; ++value) {
+                mapped_[table_.at<uchar>(value)] += counts_[value];
+            }
+            stage.mapTable(mapped_, table_);
+        } else {
+            stage.mapTable(counts_, table_);
+        }
+    }
+
+    std::tuple<Stages...> stages_;
+    cv::Mat table_;
+    Histogram8u counts_{};
+    Histogram8u mapped_{};
+};
+
+} // namespace medical_vision
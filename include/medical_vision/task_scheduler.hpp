@@ -0,0 +1,164 @@
+/**
+ * @file task_scheduler.hpp
+ * @brief Work-stealing thread pool shared by the library components
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace medical_vision {
+
+/**
+ * @class TaskScheduler
+ * @brief Work-stealing scheduler with one task deque per worker
+ *
+ * Workers pop their own deque from the back and steal from the front of the
+ * others, so nested work stays local while idle workers balance the load.
+ * The shared instance is sized from cv::getNumThreads() and installed as
+ * OpenCV's parallel_for_ backend when OpenCV supports it, so library tasks
+ * and OpenCV's own parallel loops share one set of threads, and
+ * cv::setNumThreads resizes it.
+ */
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @brief Create a pool
+     * @param threadCount Number of workers, negative for the hardware concurrency.
+     *        With 0 workers tasks only run when a thread waits on them.
+     */
+    explicit TaskScheduler(int threadCount = -1);
+    ~TaskScheduler();
+
+    // Disable copy
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * @brief Scheduler shared by the library, created on first use
+     */
+    static TaskScheduler& instance();
+
+    /**
+     * @brief Queue a task, on the calling worker's own deque when possible
+     */
+    void submit(Task task);
+
+    /**
+     * @brief Queue a callable and get its result through a future
+     *
+     * Blocking on the future from inside a task can starve the pool,
+     * tasks that wait on other tasks should use TaskGroup instead.
+     */
+    template <typename F>
+    auto async(F&& function) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        std::future<Result> future = task->get_future();
+        submit([task]() { (*task)(); });
+        return future;
+    }
+
+    /**
+     * @brief Run body over [begin, end) in chunks of at least grain indices
+     *
+     * The calling thread takes part and returns once every chunk is done.
+     * The first exception thrown by a chunk is rethrown.
+     */
+    void parallelFor(int begin, int end, const std::function<void(int, int)>& body, int grain = 1);
+
+    /**
+     * @brief Run one queued task on the calling thread
+     * @return false if no task was available
+     */
+    bool runPendingTask();
+
+    /**
+     * @brief Replace the workers, queued tasks are kept
+     * @throws std::logic_error when called from one of the workers
+     */
+    void setThreadCount(int threadCount);
+
+    int threadCount() const;
+
+    /**
+     * @brief Index of the calling worker, -1 for other threads
+     */
+    int currentWorker() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void resizeQueues(int threadCount);
+    void startThreads(int threadCount);
+    void stopThreads();
+    void workerLoop(int index);
+    bool takeTask(int index, Task& task);
+
+    // Deques are only replaced while resizing, under an exclusive lock
+    std::vector<std::unique_ptr<Worker>> workers_;
+    mutable std::shared_mutex queuesMutex_;
+
+    std::vector<std::thread> threads_;
+    std::mutex controlMutex_;           // Serializes resizing
+    std::atomic<int> threadCount_{0};
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    size_t pendingTasks_{0};            // Queued, not yet taken, guarded by sleepMutex_
+    bool running_{false};
+    std::atomic<size_t> nextQueue_{0};
+};
+
+/**
+ * @class TaskGroup
+ * @brief Set of tasks that can be waited on together
+ *
+ * wait() runs queued tasks while the group is unfinished, so groups can be
+ * nested inside tasks without blocking workers.
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskScheduler& scheduler = TaskScheduler::instance());
+    ~TaskGroup();
+
+    // Disable copy
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+
+    /**
+     * @brief Wait for every task, rethrowing the first exception
+     */
+    void wait();
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t pending{0};
+        std::exception_ptr error;
+    };
+
+    TaskScheduler& scheduler_;
+    std::shared_ptr<State> state_;
+};
+
+} // namespace medical_vision
@@ -0,0 +1,198 @@
+/**
+ * @file batch_scheduler.cpp
+ * @brief Implementation of the micro-batching scheduler
+ */
+
+#include "../include/medical_vision/batch_scheduler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace medical_vision {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Weight of the newest sample in the smoothed estimates
+constexpr double SMOOTHING = 0.1;
+
+double seconds(Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+BatchScheduler::BatchScheduler(ChestXRayAnalyzer& analyzer, const Config& config)
+    : analyzer_(analyzer), config_(config) {
+    config_.maxBatchSize = std::max<size_t>(config_.maxBatchSize, 1);
+    metrics_.batchSizeHistogram.assign(config_.maxBatchSize + 1, 0);
+    updateBatchSizes();
+    worker_ = std::thread([this]() { run(); });
+}
+
+BatchScheduler::~BatchScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    condition_.notify_all();
+    worker_.join();
+}
+
+std::future<BatchScheduler::Result> BatchScheduler::submit(const cv::Mat& image) {
+    Request request;
+    request.image = image;
+    request.arrival = Clock::now();
+    std::future<Result> future = request.promise.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            Result result;
+            result.analysis.errorMessage = "Scheduler stopped";
+            request.promise.set_value(std::move(result));
+            return future;
+        }
+        updateArrivalRate(request.arrival);
+        queue_.push_back(std::move(request));
+    }
+    condition_.notify_all();
+    return future;
+}
+
+BatchScheduler::Metrics BatchScheduler::metrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Metrics metrics = metrics_;
+    if (metrics.batches > 0) {
+        metrics.meanBatchSize = static_cast<double>(metrics.requests) / metrics.batches;
+        metrics.meanForwardMs = forwardTimeSum_ * 1000.0 / metrics.batches;
+    }
+    if (metrics.requests > 0) {
+        metrics.meanQueueTimeMs = queueTimeSum_ * 1000.0 / metrics.requests;
+    }
+    metrics.targetBatchSize = targetBatchSize_;
+    metrics.arrivalRate = meanInterval_ > 0.0 ? 1.0 / meanInterval_ : 0.0;
+    return metrics;
+}
+
+void BatchScheduler::resetMetrics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    metrics_ = Metrics();
+    metrics_.batchSizeHistogram.assign(config_.maxBatchSize + 1, 0);
+    queueTimeSum_ = 0.0;
+    forwardTimeSum_ = 0.0;
+}
+
+void BatchScheduler::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        condition_.wait(lock, [this]() { return !queue_.empty() || !running_; });
+        if (!running_) break;
+
+        // The oldest request bounds how long the batch may keep filling up
+        Clock::time_point deadline = queue_.front().arrival + config_.maxWait;
+        condition_.wait_until(lock, deadline, [this]() {
+            return queue_.size() >= targetBatchSize_ || !running_;
+        });
+        if (!running_) break;
+
+        // Everything already queued joins, up to what the latency budget affords
+        std::vector<Request> batch;
+        while (!queue_.empty() && batch.size() < batchLimit_) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+
+        lock.unlock();
+        process(batch);
+        lock.lock();
+    }
+
+    // Fail whatever is left so no caller waits forever
+    for (auto& request : queue_) {
+        Result result;
+        result.analysis.errorMessage = "Scheduler stopped";
+        request.promise.set_value(std::move(result));
+    }
+    queue_.clear();
+}
+
+void BatchScheduler::process(std::vector<Request>& batch) {
+    Clock::time_point dispatch = Clock::now();
+
+    std::vector<cv::Mat> images;
+    images.reserve(batch.size());
+    for (const auto& request : batch) {
+        images.push_back(request.image);
+    }
+
+    std::vector<ChestXRayAnalyzer::AnalysisResult> analyses;
+    try {
+        analyses = analyzer_.analyzeBatch(images, images.size());
+    }
+    catch (const std::exception& e) {
+        analyses.assign(batch.size(), ChestXRayAnalyzer::AnalysisResult());
+        for (auto& analysis : analyses) {
+            analysis.errorMessage = e.what();
+        }
+    }
+    double forwardTime = seconds(Clock::now() - dispatch);
+
+    std::vector<Result> results(batch.size());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        metrics_.requests += batch.size();
+        metrics_.batches++;
+        metrics_.batchSizeHistogram[batch.size()]++;
+        forwardTimeSum_ += forwardTime;
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            double queueTime = seconds(dispatch - batch[i].arrival);
+            queueTimeSum_ += queueTime;
+            metrics_.maxQueueTimeMs = std::max(metrics_.maxQueueTimeMs, queueTime * 1000.0);
+
+            results[i].analysis = std::move(analyses[i]);
+            results[i].batchSize = batch.size();
+            results[i].queueTime = queueTime;
+        }
+
+        double cost = forwardTime / batch.size();
+        imageCost_ = imageCost_ > 0.0 ? imageCost_ + SMOOTHING * (cost - imageCost_) : cost;
+        updateBatchSizes();
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i].promise.set_value(std::move(results[i]));
+    }
+}
+
+void BatchScheduler::updateArrivalRate(Clock::time_point arrival) {
+    if (hasArrival_) {
+        double interval = seconds(arrival - lastArrival_);
+        meanInterval_ = meanInterval_ > 0.0
+            ? meanInterval_ + SMOOTHING * (interval - meanInterval_)
+            : interval;
+    }
+    lastArrival_ = arrival;
+    hasArrival_ = true;
+    updateBatchSizes();
+}
+
+void BatchScheduler::updateBatchSizes() {
+    // Keep queueing plus the batched forward within the latency objective
+    double maxWait = std::chrono::duration<double>(config_.maxWait).count();
+    batchLimit_ = config_.maxBatchSize;
+    if (config_.latencyTarget.count() > 0 && imageCost_ > 0.0) {
+        double budget = std::chrono::duration<double>(config_.latencyTarget).count() - maxWait;
+        size_t affordable = budget > 0.0 ? static_cast<size_t>(budget / imageCost_) : 1;
+        batchLimit_ = std::clamp<size_t>(affordable, 1, config_.maxBatchSize);
+    }
+
+    // Requests expected to arrive while the oldest one waits, so a batch
+    // only waits when companions are actually likely to show up
+    double expected = meanInterval_ > 0.0 ? maxWait / meanInterval_ : 0.0;
+    size_t target = 1 + static_cast<size_t>(std::min(std::floor(expected), 1e6));
+    targetBatchSize_ = std::min(target, batchLimit_);
+}
+
+} // namespace medical_vision
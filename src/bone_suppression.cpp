@@ -0,0 +1,85 @@
+/**
+ * @file bone_suppression.cpp
+ * @brief Implementation of rib shadow attenuation
+ */
+
+#include "../include/medical_vision/bone_suppression.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace medical_vision {
+
+void BoneSuppressor::setParams(const Params& params) {
+    params_ = params;
+    imageSize_ = cv::Size();    // Rebuild the plan on the next image
+}
+
+void BoneSuppressor::prepare(const cv::Size& imageSize) {
+    if (imageSize == imageSize_) return;
+    imageSize_ = imageSize;
+
+    const int longest = std::max(imageSize.width, imageSize.height);
+    const double scale = std::min(1.0, std::max(params_.workSize, 16) / static_cast<double>(longest));
+    workSize_ = cv::Size(std::max(1, cvRound(imageSize.width * scale)),
+                         std::max(1, cvRound(imageSize.height * scale)));
+
+    // Frequencies in cycles per image height, so the rib scales do not
+    // depend on the resolution. Each scale is a Gaussian band in log
+    // frequency, the wedge a raised cosine around the vertical axis.
+    const double height = workSize_.height;
+    const double sigma = std::max(params_.bandwidth, 0.05);
+    const double wedge = std::clamp(params_.angularWidth, 1.0, 90.0) * CV_PI / 180.0;
+    const double strength = std::clamp(params_.strength, 0.0, 1.0);
+    auto gain = [height, sigma, wedge, strength, ribScales = params_.ribScales](double fx, double fy) {
+        fx = std::abs(fx) * height;
+        fy = std::abs(fy) * height;
+        const double frequency = std::sqrt(fx * fx + fy * fy);
+        if (frequency <= 0.0) return 0.0;
+        const double offAxis = std::atan2(fx, fy);     // 0 on the vertical axis
+        if (offAxis >= wedge) return 0.0;
+        double band = 0.0;
+        for (double ribScale : ribScales) {
+            if (ribScale <= 0.0) continue;
+            const double octaves = std::log2(frequency / ribScale);
+            band = std::max(band, std::exp(-0.5 * octaves * octaves / (sigma * sigma)));
+        }
+        return strength * band * 0.5 * (1.0 + std::cos(CV_PI * offAxis / wedge));
+    };
+
+    // The band-pass is not compact: reflected margins of an eighth keep the
+    // wrap-around of the DFT away from the image edges
+    response_.emplace(gain, workSize_.width / 8, workSize_.height / 8);
+    response_->sampled(FrequencyFilter::instance()
+                           .plan(workSize_, response_->supportX(), response_->supportY())
+                           .dftSize);
+}
+
+void BoneSuppressor::apply(const cv::Mat& image, cv::Mat& output) {
+    if (image.empty() || image.channels() != 1 ||
+        (image.depth() != CV_8U && image.depth() != CV_16U && image.depth() != CV_32F)) {
+        throw std::runtime_error("Bone suppression needs an 8-bit, 16-bit or float gray image");
+    }
+    prepare(image.size());
+
+    // Rib component of the downsample
+    if (workSize_ == image.size()) {
+        image.convertTo(work_, CV_32F);
+    } else {
+        cv::resize(image, work_, workSize_, 0, 0, cv::INTER_AREA);
+        work_.convertTo(work_, CV_32F);
+    }
+    FrequencyFilter::instance().apply(work_, ribs_, *response_);
+
+    // Ribs are smooth at the downsample scale, so upsampling them loses
+    // nothing and the full image is touched by one subtraction
+    if (workSize_ == image.size()) {
+        cv::subtract(image, ribs_, output, cv::noArray(), image.depth());
+    } else {
+        cv::resize(ribs_, ribsFull_, image.size(), 0, 0, cv::INTER_LINEAR);
+        cv::subtract(image, ribsFull_, output, cv::noArray(), image.depth());
+    }
+}
+
+} // namespace medical_vision
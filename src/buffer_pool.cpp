@@ -0,0 +1,259 @@
+/**
+ * @file buffer_pool.cpp
+ * @brief Implementation of the recycling cv::Mat allocator
+ */
+
+#include "../include/medical_vision/buffer_pool.hpp"
+#include <list>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace medical_vision {
+
+namespace {
+
+// Released buffers of one thread by exact byte size. Entries keep their
+// UMatData so recycling a buffer does not allocate a new one either.
+struct ThreadCache {
+    struct SizeClass {
+        std::vector<cv::UMatData*> buffers;
+        std::list<size_t>::iterator use;    // Position in recent
+    };
+    std::unordered_map<size_t, SizeClass> sizes;
+    std::list<size_t> recent;               // Sizes, most recently used first
+    size_t bytes{0};
+
+    // Size class of a buffer size, marked as the most recently used
+    SizeClass& touch(size_t size) {
+        auto it = sizes.find(size);
+        if (it == sizes.end()) {
+            recent.push_front(size);
+            it = sizes.emplace(size, SizeClass{{}, recent.begin()}).first;
+        } else {
+            recent.splice(recent.begin(), recent, it->second.use);
+        }
+        return it->second;
+    }
+
+    // Take a buffer of the least recently used size other than keep,
+    // nullptr when there is none
+    cv::UMatData* evict(size_t keep) {
+        while (!recent.empty() && recent.back() != keep) {
+            auto it = sizes.find(recent.back());
+            if (!it->second.buffers.empty()) {
+                cv::UMatData* u = it->second.buffers.back();
+                it->second.buffers.pop_back();
+                bytes -= u->size;
+                return u;
+            }
+            recent.pop_back();
+            sizes.erase(it);
+        }
+        return nullptr;
+    }
+
+    ~ThreadCache();
+};
+
+// Plain thread_locals stay usable while other thread_locals are destroyed,
+// matrices released after the cache is gone go straight to the heap
+thread_local ThreadCache* threadCache = nullptr;
+thread_local bool threadCacheDestroyed = false;
+
+ThreadCache* currentThreadCache() {
+    if (!threadCache && !threadCacheDestroyed) {
+        static thread_local ThreadCache cache;
+        threadCache = &cache;
+    }
+    return threadCache;
+}
+
+void freeBuffer(cv::UMatData* u) {
+    cv::fastFree(u->origdata);
+    u->origdata = nullptr;
+    delete u;
+}
+
+ThreadCache::~ThreadCache() {
+    BufferPool::instance().trimThreadCache();
+    threadCache = nullptr;
+    threadCacheDestroyed = true;
+}
+
+} // namespace
+
+BufferPool& BufferPool::instance() {
+    // Never destroyed: matrices in static objects may be released after main()
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+void BufferPool::install() {
+    cv::Mat::setDefaultAllocator(this);
+}
+
+void BufferPool::uninstall() {
+    if (cv::Mat::getDefaultAllocator() == this) {
+        cv::Mat::setDefaultAllocator(nullptr);
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    Stats stats;
+    stats.heapAllocations = heapAllocations_.load();
+    stats.pooledAllocations = pooledAllocations_.load();
+    stats.heapFrees = heapFrees_.load();
+    stats.cachedBytes = cachedBytes_.load();
+    return stats;
+}
+
+void BufferPool::resetStats() {
+    heapAllocations_ = 0;
+    pooledAllocations_ = 0;
+    heapFrees_ = 0;
+}
+
+void BufferPool::setAllocationHook(AllocationHook hook) {
+    hook_ = hook;
+}
+
+void BufferPool::setThreadCacheLimit(size_t bytes) {
+    threadCacheLimit_ = bytes;
+}
+
+size_t BufferPool::threadCacheLimit() const {
+    return threadCacheLimit_.load();
+}
+
+void BufferPool::setCacheLimit(size_t bytes) {
+    cacheLimit_ = bytes;
+}
+
+size_t BufferPool::cacheLimit() const {
+    return cacheLimit_.load();
+}
+
+void BufferPool::trimThreadCache() {
+    ThreadCache* cache = threadCache;
+    if (!cache) return;
+
+    for (auto& entry : cache->sizes) {
+        for (cv::UMatData* u : entry.second.buffers) {
+            cachedBytes_ -= u->size;
+            ++heapFrees_;
+            freeBuffer(u);
+        }
+    }
+    cache->sizes.clear();
+    cache->recent.clear();
+    cache->bytes = 0;
+}
+
+cv::UMatData* BufferPool::allocate(int dims, const int* sizes, int type, void* data0,
+                                   size_t* step, cv::AccessFlag, cv::UMatUsageFlags) const {
+    // Same layout as OpenCV's standard allocator
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    if (data0) {
+        cv::UMatData* u = new cv::UMatData(this);
+        u->data = u->origdata = static_cast<uchar*>(data0);
+        u->size = total;
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+        return u;
+    }
+
+    ThreadCache* cache = currentThreadCache();
+    if (cache) {
+        auto it = cache->sizes.find(total);
+        if (it != cache->sizes.end() && !it->second.buffers.empty()) {
+            cv::UMatData* u = it->second.buffers.back();
+            it->second.buffers.pop_back();
+            if (it->second.buffers.empty()) {
+                cache->recent.erase(it->second.use);
+                cache->sizes.erase(it);
+            } else {
+                cache->touch(total);
+            }
+            cache->bytes -= total;
+            cachedBytes_ -= total;
+            ++pooledAllocations_;
+
+            // Reset the recycled UMatData to a freshly constructed state
+            uchar* buffer = u->origdata;
+            u->~UMatData();
+            new (u) cv::UMatData(this);
+            u->data = u->origdata = buffer;
+            u->size = total;
+            return u;
+        }
+    }
+
+    uchar* buffer = static_cast<uchar*>(cv::fastMalloc(total));
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = buffer;
+    u->size = total;
+    ++heapAllocations_;
+    if (AllocationHook hook = hook_.load()) {
+        hook(total);
+    }
+    return u;
+}
+
+bool BufferPool::allocate(cv::UMatData* u, cv::AccessFlag, cv::UMatUsageFlags) const {
+    return u != nullptr;
+}
+
+void BufferPool::deallocate(cv::UMatData* u) const {
+    if (!u) return;
+
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (u->flags & cv::UMatData::USER_ALLOCATED) {
+        delete u;
+        return;
+    }
+
+    ThreadCache* cache = currentThreadCache();
+    const size_t threadLimit = threadCacheLimit_.load();
+    const size_t limit = cacheLimit_.load();
+    if (cache && u->size <= threadLimit && u->size <= limit) {
+        // Make room from the least recently used other sizes
+        ThreadCache::SizeClass& sizeClass = cache->touch(u->size);
+        while (cache->bytes + u->size > threadLimit || cachedBytes_.load() + u->size > limit) {
+            cv::UMatData* old = cache->evict(u->size);
+            if (!old) break;
+            cachedBytes_ -= old->size;
+            ++heapFrees_;
+            freeBuffer(old);
+        }
+        // Other threads' lists may hold the rest of the global budget
+        if (cache->bytes + u->size <= threadLimit && cachedBytes_.load() + u->size <= limit) {
+            // Free lists only grow with a new buffer size, steady state reuses their capacity
+            sizeClass.buffers.push_back(u);
+            cache->bytes += u->size;
+            cachedBytes_ += u->size;
+            return;
+        }
+        if (sizeClass.buffers.empty()) {
+            cache->recent.erase(sizeClass.use);
+            cache->sizes.erase(u->size);
+        }
+    }
+
+    ++heapFrees_;
+    freeBuffer(u);
+}
+
+} // namespace medical_vision
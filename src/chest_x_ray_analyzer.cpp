@@ -1,5 +1,7 @@
 #include "../include/medical_vision/chest_x_ray_analyzer.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
 #include <opencv2/imgproc.hpp>
+#include <algorithm>
 #include <chrono>
 
 namespace medical_vision {
@@ -18,6 +20,10 @@ bool ChestXRayAnalyzer::loadModel(const ModelConfig& config) {
     try {
         // Load network
         net_ = cv::dnn::readNet(config.modelPath, config.configPath);
+        if (net_.empty()) {
+            isModelLoaded_ = false;
+            return false;
+        }
         
         // Configure backend
         if (config.useGPU) {
@@ -29,6 +35,8 @@ bool ChestXRayAnalyzer::loadModel(const ModelConfig& config) {
         }
 
         config_ = config;
+        batchingSupported_ = true;
+        findActivationLayers();
         isModelLoaded_ = true;
         return true;
     }
@@ -39,7 +47,22 @@ bool ChestXRayAnalyzer::loadModel(const ModelConfig& config) {
 }
 
 ChestXRayAnalyzer::AnalysisResult ChestXRayAnalyzer::analyze(const cv::Mat& image) {
+    return analyze(image, ProgressCallback());
+}
+
+ChestXRayAnalyzer::AnalysisResult ChestXRayAnalyzer::analyze(
+    const cv::Mat& image, const ProgressCallback& progress) {
+    return analyze(image, cv::Rect(), progress);
+}
+
+ChestXRayAnalyzer::AnalysisResult ChestXRayAnalyzer::analyze(
+    const cv::Mat& image, const cv::Rect& region, const ProgressCallback& progress) {
     AnalysisResult result;
+
+    // Report progress and tell whether the caller wants to continue
+    auto proceed = [&progress](float fraction) {
+        return !progress || progress(fraction);
+    };
     
     try {
         if (!isModelLoaded()) {
@@ -47,35 +70,47 @@ ChestXRayAnalyzer::AnalysisResult ChestXRayAnalyzer::analyze(const cv::Mat& imag
             return result;
         }
 
-        if (!validateInput(image)) {
-            result.errorMessage = "Invalid input image";
+        if (config_.normalizeOrientation) {
+            result.orientation = estimateOrientation(image);
+        }
+        if (!validateInput(image) || !passesQualityGate(image, result)) {
+            if (result.errorMessage.empty()) {
+                result.errorMessage = "Invalid input image";
+            }
             return result;
         }
 
         auto start = std::chrono::high_resolution_clock::now();
 
-        // Preprocessing
-        cv::Mat blob = preprocessImage(image);
+        // Preprocessing, cropped to the region before letterboxing
+        const cv::Rect frame(0, 0, image.cols, image.rows);
+        cv::Rect area = region & frame;
+        if (area.empty()) {
+            area = frame;
+        }
+        cv::Mat blob = preprocessImage(image(area), result.orientation);
+        if (!proceed(0.2f)) {
+            result.errorMessage = "Analysis cancelled";
+            return result;
+        }
         
-        // Forward pass
-        net_.setInput(blob);
-        cv::Mat outputs = net_.forward();
+        // Forward pass, also fetching the last feature maps when needed
+        cv::Mat outputs, features;
+        runForward(blob, outputs, features);
+        if (!proceed(0.8f)) {
+            result.errorMessage = "Analysis cancelled";
+            return result;
+        }
 
         // Postprocessing
         result.detections = postprocessOutputs(outputs);
-        
-        // Generate heatmaps if requested
-        if (config_.generateHeatmaps) {
-            cv::Mat features = net_.getLayer(net_.getLayerNames().back())->blobs[0];
-            for (auto& detection : result.detections) {
-                detection.heatmap = generateHeatmap(image, features);
-            }
-        }
+        attachActivationMaps(result, features, image.size(), area);
 
         auto end = std::chrono::high_resolution_clock::now();
         result.processingTime = std::chrono::duration<double>(end - start).count();
         result.success = true;
         result.processedImage = image.clone();
+        proceed(1.0f);
 
     } catch (const std::exception& e) {
         result.success = false;
@@ -85,7 +120,14 @@ ChestXRayAnalyzer::AnalysisResult ChestXRayAnalyzer::analyze(const cv::Mat& imag
     return result;
 }
 
-cv::Mat ChestXRayAnalyzer::preprocessImage(const cv::Mat& image) const {
+cv::Mat ChestXRayAnalyzer::preprocessImage(const cv::Mat& image,
+                                           const OrientationEstimate& orientation) const {
+    // Créer le blob pour le réseau
+    return cv::dnn::blobFromImage(prepareInput(image, orientation));
+}
+
+cv::Mat ChestXRayAnalyzer::prepareInput(const cv::Mat& image,
+                                        const OrientationEstimate& orientation) const {
     try {
         cv::Mat processed;
         
@@ -96,23 +138,18 @@ cv::Mat ChestXRayAnalyzer::preprocessImage(const cv::Mat& image) const {
             processed = image.clone();
         }
 
-        // 2. Redimensionner en gardant le ratio
+        // 2. Redimensionner en gardant le ratio, celui de l'image redressée
         cv::Mat resized;
-        double scale = std::min(
-            config_.inputSize.width / static_cast<double>(processed.cols),
-            config_.inputSize.height / static_cast<double>(processed.rows)
-        );
-        cv::Size newSize(
-            static_cast<int>(processed.cols * scale),
-            static_cast<int>(processed.rows * scale)
-        );
-        cv::resize(processed, resized, newSize);
+        const bool turned = orientation.quarterTurns % 2 != 0;
+        const cv::Rect content = letterbox(processed.size(), turned);
+        cv::resize(processed, resized, turned ? cv::Size(content.height, content.width) : content.size());
+
+        // Turned and inverted at input size, far cheaper than on the film
+        correctOrientation(resized, resized, orientation);
 
         // 3. Padding pour atteindre la taille cible
         cv::Mat padded = cv::Mat::zeros(config_.inputSize, CV_8UC1);
-        int top = (config_.inputSize.height - resized.rows) / 2;
-        int left = (config_.inputSize.width - resized.cols) / 2;
-        resized.copyTo(padded(cv::Rect(left, top, resized.cols, resized.rows)));
+        resized.copyTo(padded(content));
 
         // 4. Normalisation
         padded.convertTo(processed, CV_32F, PIXEL_SCALE);
@@ -122,14 +159,78 @@ cv::Mat ChestXRayAnalyzer::preprocessImage(const cv::Mat& image) const {
         std::vector<cv::Mat> channels = {processed, processed, processed};
         cv::merge(channels, processed);
 
-        // 6. Créer le blob pour le réseau
-        return cv::dnn::blobFromImage(processed);
+        return processed;
     }
     catch (const cv::Exception& e) {
         throw std::runtime_error("Preprocessing failed: " + std::string(e.what()));
     }
 }
 
+cv::Rect ChestXRayAnalyzer::letterbox(const cv::Size& imageSize, bool turned) const {
+    const int width = turned ? imageSize.height : imageSize.width;
+    const int height = turned ? imageSize.width : imageSize.height;
+    double scale = std::min(config_.inputSize.width / static_cast<double>(width),
+                            config_.inputSize.height / static_cast<double>(height));
+    cv::Size size(static_cast<int>(width * scale), static_cast<int>(height * scale));
+    return cv::Rect((config_.inputSize.width - size.width) / 2,
+                    (config_.inputSize.height - size.height) / 2,
+                    size.width, size.height);
+}
+
+cv::Mat ChestXRayAnalyzer::cropToContent(const cv::Mat& activationMap, const cv::Rect& content) const {
+    if (activationMap.empty()) return activationMap;
+
+    // Content rect at feature map resolution, at least one cell
+    const double sx = activationMap.cols / static_cast<double>(config_.inputSize.width);
+    const double sy = activationMap.rows / static_cast<double>(config_.inputSize.height);
+    int x0 = std::clamp(cvRound(content.x * sx), 0, activationMap.cols - 1);
+    int y0 = std::clamp(cvRound(content.y * sy), 0, activationMap.rows - 1);
+    int x1 = std::clamp(cvRound(content.br().x * sx), x0 + 1, activationMap.cols);
+    int y1 = std::clamp(cvRound(content.br().y * sy), y0 + 1, activationMap.rows);
+    return activationMap(cv::Rect(x0, y0, x1 - x0, y1 - y0)).clone();
+}
+
+void ChestXRayAnalyzer::runForward(const cv::Mat& blob, cv::Mat& outputs, cv::Mat& features) {
+    bool wantActivations = (config_.generateHeatmaps || config_.storeActivationMaps)
+                           && !featureLayer_.empty();
+    net_.setInput(blob);
+    if (wantActivations) {
+        std::vector<cv::Mat> blobs;
+        net_.forward(blobs, std::vector<cv::String>{outputLayer_, featureLayer_});
+        outputs = blobs[0];
+        features = blobs[1];
+    } else {
+        outputs = net_.forward();
+        features.release();
+    }
+}
+
+void ChestXRayAnalyzer::attachActivationMaps(AnalysisResult& result, const cv::Mat& features,
+                                             const cv::Size& imageSize, const cv::Rect& region) const {
+    for (auto& detection : result.detections) {
+        detection.region = region;
+    }
+
+    // Activation maps are cheap, colorized heatmaps are rendered on demand
+    // unless generateHeatmaps asks for them up front
+    if (features.empty()) return;
+
+    const bool turned = result.orientation.quarterTurns % 2 != 0;
+    for (auto& detection : result.detections) {
+        auto it = std::find(pathologyNames_.begin(), pathologyNames_.end(),
+                            detection.pathology);
+        detection.activationMap = computeActivationMap(
+            features, static_cast<size_t>(it - pathologyNames_.begin()));
+        // Maps follow the corrected input: leave out the letterbox padding,
+        // placed as in the turned input, then turn them back onto the region
+        detection.activationMap = cropToContent(detection.activationMap, letterbox(region.size(), turned));
+        restoreOrientation(detection.activationMap, detection.activationMap, result.orientation);
+        if (config_.generateHeatmaps) {
+            detection.heatmap = renderHeatmap(detection.activationMap, imageSize, region);
+        }
+    }
+}
+
 std::vector<ChestXRayAnalyzer::Detection> ChestXRayAnalyzer::postprocessOutputs(
     const cv::Mat& outputs) const {
     
@@ -161,24 +262,92 @@ std::vector<ChestXRayAnalyzer::Detection> ChestXRayAnalyzer::postprocessOutputs(
     return detections;
 }
 
-cv::Mat ChestXRayAnalyzer::generateHeatmap(
-    const cv::Mat& image, const cv::Mat& features) const {
+cv::Mat ChestXRayAnalyzer::renderHeatmap(
+    const cv::Mat& activationMap, const cv::Size& size) {
     
+    if (activationMap.empty() || size.area() == 0) return cv::Mat();
+
+    // Upsample the raw map first so the colormap stays smooth
     cv::Mat heatmap;
+    cv::resize(activationMap, heatmap, size, 0, 0, cv::INTER_LINEAR);
     
-    // Convert feature map to heatmap
-    cv::normalize(features, heatmap, 0, 255, cv::NORM_MINMAX);
-    heatmap.convertTo(heatmap, CV_8U);
+    // Convert activation map to heatmap
+    cv::normalize(heatmap, heatmap, 0, 255, cv::NORM_MINMAX, CV_8U);
     
     // Apply colormap
     cv::applyColorMap(heatmap, heatmap, cv::COLORMAP_JET);
     
-    // Resize to original image size
-    cv::resize(heatmap, heatmap, image.size());
-    
     return heatmap;
 }
 
+cv::Mat ChestXRayAnalyzer::renderHeatmap(
+    const cv::Mat& activationMap, const cv::Size& size, const cv::Rect& region) {
+
+    const cv::Rect area = region & cv::Rect(cv::Point(), size);
+    if (area.empty() || area.size() == size) {
+        return renderHeatmap(activationMap, size);
+    }
+
+    cv::Mat heatmap = renderHeatmap(activationMap, area.size());
+    if (heatmap.empty()) return heatmap;
+    cv::Mat canvas = cv::Mat::zeros(size, heatmap.type());
+    heatmap.copyTo(canvas(area));
+    return canvas;
+}
+
+cv::Mat ChestXRayAnalyzer::computeActivationMap(
+    const cv::Mat& features, size_t classIndex) const {
+    
+    // CAM: classifier weights of the class applied over the feature channels
+    if (features.dims != 4 || classIndex >= static_cast<size_t>(classifierWeights_.rows)) {
+        return cv::Mat();
+    }
+    const int channels = features.size[1];
+    const int height = features.size[2];
+    const int width = features.size[3];
+    if (channels != classifierWeights_.cols) return cv::Mat();
+
+    cv::Mat flat(channels, height * width, CV_32F, const_cast<float*>(features.ptr<float>()));
+    cv::Mat cam = classifierWeights_.row(static_cast<int>(classIndex)) * flat;
+    return cam.reshape(1, height).clone();
+}
+
+void ChestXRayAnalyzer::findActivationLayers() {
+    outputLayer_.clear();
+    featureLayer_.clear();
+    classifierWeights_.release();
+
+    std::vector<cv::String> outputs = net_.getUnconnectedOutLayersNames();
+    std::vector<cv::String> names = net_.getLayerNames();
+    if (outputs.empty() || names.empty()) return;
+
+    // DenseNet ends with features -> global pooling -> flatten -> classifier,
+    // walk back from the classifier to the last spatial feature layer
+    for (int i = static_cast<int>(names.size()) - 1; i >= 0; --i) {
+        cv::Ptr<cv::dnn::Layer> layer = net_.getLayer(names[i]);
+        if (layer->type != "InnerProduct" && layer->type != "Gemm") continue;
+        if (layer->blobs.empty() || layer->blobs[0].dims != 2) return;
+
+        for (int j = i - 1; j >= 0; --j) {
+            const std::string type = net_.getLayer(names[j])->type;
+            if (type == "Pooling" || type == "Flatten" || type == "Reshape" || type == "Identity") {
+                continue;
+            }
+            outputLayer_ = outputs[0];
+            featureLayer_ = names[j];
+            layer->blobs[0].convertTo(classifierWeights_, CV_32F);
+
+            // Keep one row per class whatever the stored layout
+            const int classes = static_cast<int>(pathologyNames_.size());
+            if (classifierWeights_.rows != classes && classifierWeights_.cols == classes) {
+                classifierWeights_ = classifierWeights_.t();
+            }
+            return;
+        }
+        return;
+    }
+}
+
 bool ChestXRayAnalyzer::validateInput(const cv::Mat& image) const {
     if (image.empty()) {
         throw std::runtime_error("Empty image");
@@ -203,11 +372,27 @@ bool ChestXRayAnalyzer::validateInput(const cv::Mat& image) const {
     return true;
 }
 
+bool ChestXRayAnalyzer::passesQualityGate(const cv::Mat& image, AnalysisResult& result) const {
+    if (!config_.qualityGate) return true;
+
+    // Cheaper than the forward pass by orders of magnitude
+    result.quality = assessQuality(image, config_.qualityThresholds);
+    if (result.orientation.needsCorrection()) {
+        // Measured before the correction the network input gets
+        result.quality.issues &= ~QualityReport::ORIENTATION;
+    }
+    if (result.quality.acceptable()) return true;
+
+    result.errorMessage = "Image quality too low: " + result.quality.describe();
+    return false;
+}
+
 std::vector<ChestXRayAnalyzer::AnalysisResult> ChestXRayAnalyzer::analyzeBatch(
     const std::vector<cv::Mat>& images, size_t batchSize) {
     
     std::vector<AnalysisResult> results;
     results.reserve(images.size());
+    batchSize = std::max<size_t>(batchSize, 1);
 
     for (size_t i = 0; i < images.size(); i += batchSize) {
         size_t currentBatchSize = std::min(batchSize, images.size() - i);
@@ -215,8 +400,102 @@ std::vector<ChestXRayAnalyzer::AnalysisResult> ChestXRayAnalyzer::analyzeBatch(
                                  images.begin() + i + currentBatchSize);
         
         // Process batch
-        for (const auto& image : batch) {
-            results.push_back(analyze(image));
+        if (currentBatchSize == 1 || !batchingSupported_) {
+            for (const auto& image : batch) {
+                results.push_back(analyze(image));
+            }
+        } else {
+            for (auto& result : analyzeChunk(batch)) {
+                results.push_back(std::move(result));
+            }
+        }
+    }
+
+    return results;
+}
+
+std::vector<ChestXRayAnalyzer::AnalysisResult> ChestXRayAnalyzer::analyzeChunk(
+    const std::vector<cv::Mat>& images) {
+    
+    std::vector<AnalysisResult> results(images.size());
+    if (!isModelLoaded()) {
+        for (auto& result : results) {
+            result.errorMessage = "Model not loaded";
+        }
+        return results;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Invalid images fail individually, the others share one forward pass.
+    // Images are prepared in parallel, each into its own slot.
+    std::vector<cv::Mat> prepared(images.size());
+    TaskScheduler::instance().parallelFor(0, static_cast<int>(images.size()),
+        [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                try {
+                    if (config_.normalizeOrientation) {
+                        results[i].orientation = estimateOrientation(images[i]);
+                    }
+                    validateInput(images[i]);
+                    if (!passesQualityGate(images[i], results[i])) continue;
+                    prepared[i] = prepareInput(images[i], results[i].orientation);
+                } catch (const std::exception& e) {
+                    results[i].errorMessage = e.what();
+                }
+            }
+        });
+
+    std::vector<cv::Mat> inputs;
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (prepared[i].empty()) continue;
+        inputs.push_back(prepared[i]);
+        indices.push_back(i);
+    }
+    if (inputs.empty()) return results;
+
+    bool batched = false;
+    try {
+        cv::Mat outputs, features;
+        runForward(cv::dnn::blobFromImages(inputs), outputs, features);
+
+        // Models exported with a fixed batch size return a single result,
+        // run them one by one from now on
+        const int count = static_cast<int>(inputs.size());
+        if (outputs.dims < 2 || outputs.size[0] != count) {
+            batchingSupported_ = false;
+            throw std::runtime_error("Model does not support batched inputs");
+        }
+        outputs = outputs.reshape(1, count);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        double elapsed = std::chrono::duration<double>(end - start).count();
+
+        for (int k = 0; k < count; ++k) {
+            const cv::Mat& image = images[indices[k]];
+            AnalysisResult& result = results[indices[k]];
+
+            result.detections = postprocessOutputs(outputs.row(k));
+            if (!features.empty() && features.dims == 4) {
+                int sliceSize[] = {1, features.size[1], features.size[2], features.size[3]};
+                cv::Mat slice(4, sliceSize, CV_32F, features.ptr<float>(k));
+                attachActivationMaps(result, slice, image.size(),
+                                     cv::Rect(0, 0, image.cols, image.rows));
+            }
+            result.processingTime = elapsed;
+            result.success = true;
+            result.processedImage = image.clone();
+        }
+        batched = true;
+    } catch (const std::exception&) {
+        // Other failures only cost this batch, analyzing the images one by
+        // one reports errors against the images that cause them
+    }
+
+    if (!batched) {
+        for (size_t index : indices) {
+            results[index] = analyze(images[index]);
         }
     }
 
@@ -0,0 +1,118 @@
+/**
+ * @file cpu_dispatch.cpp
+ * @brief CPU feature detection for kernel dispatch
+ */
+
+#include "../include/medical_vision/cpu_dispatch.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if MEDICAL_VISION_X86_KERNELS
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace medical_vision {
+
+namespace {
+
+#if MEDICAL_VISION_X86_KERNELS
+void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned>(values[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switches (XCR0)
+uint64_t enabledStateComponents() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t low, high;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+}
+
+CpuLevel queryCpu() {
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    const bool sse42 = regs[2] & (1u << 20);
+    const bool osxsave = regs[2] & (1u << 27);
+    const bool avx = regs[2] & (1u << 28);
+    if (!sse42) return CpuLevel::SCALAR;
+    if (!osxsave || !avx || maxLeaf < 7) return CpuLevel::SSE42;
+
+    // YMM state for AVX2, plus opmask and ZMM state for AVX-512
+    const uint64_t xcr0 = enabledStateComponents();
+    if ((xcr0 & 0x6) != 0x6) return CpuLevel::SSE42;
+
+    cpuid(7, 0, regs);
+    const bool avx2 = regs[1] & (1u << 5);
+    const bool avx512f = regs[1] & (1u << 16);
+    const bool avx512bw = regs[1] & (1u << 30);
+    if (!avx2) return CpuLevel::SSE42;
+    if (avx512f && avx512bw && (xcr0 & 0xE6) == 0xE6) return CpuLevel::AVX512;
+    return CpuLevel::AVX2;
+}
+#endif
+
+CpuLevel levelFromEnvironment(CpuLevel detected) {
+    const char* value = std::getenv("MEDICAL_VISION_CPU");
+    if (!value) return detected;
+
+    for (CpuLevel level : {CpuLevel::SCALAR, CpuLevel::SSE42, CpuLevel::AVX2, CpuLevel::AVX512}) {
+        if (std::strcmp(value, cpuLevelName(level)) == 0) {
+            return std::min(level, detected);
+        }
+    }
+    return detected;
+}
+
+std::atomic<CpuLevel>& activeLevel() {
+    static std::atomic<CpuLevel> level{levelFromEnvironment(detectCpuLevel())};
+    return level;
+}
+
+} // namespace
+
+CpuLevel detectCpuLevel() {
+#if MEDICAL_VISION_X86_KERNELS
+    static const CpuLevel level = queryCpu();
+    return level;
+#else
+    return CpuLevel::SCALAR;
+#endif
+}
+
+CpuLevel cpuLevel() {
+    return activeLevel().load(std::memory_order_relaxed);
+}
+
+void setCpuLevel(CpuLevel level) {
+    activeLevel() = std::min(level, detectCpuLevel());
+}
+
+const char* cpuLevelName(CpuLevel level) {
+    switch (level) {
+        case CpuLevel::SSE42: return "sse4.2";
+        case CpuLevel::AVX2: return "avx2";
+        case CpuLevel::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+} // namespace medical_vision
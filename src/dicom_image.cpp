@@ -0,0 +1,417 @@
+/**
+ * @file dicom_image.cpp
+ * @brief Implementation of the DICOM reader
+ */
+
+#include "../include/medical_vision/dicom_image.hpp"
+#include "../include/medical_vision/mapped_file.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace medical_vision {
+
+namespace {
+
+const std::string IMPLICIT_VR_LITTLE_ENDIAN = "1.2.840.10008.1.2";
+const std::string EXPLICIT_VR_LITTLE_ENDIAN = "1.2.840.10008.1.2.1";
+const std::string RLE_LOSSLESS = "1.2.840.10008.1.2.5";
+
+constexpr size_t PREAMBLE_SIZE = 128;
+constexpr uint32_t UNDEFINED_LENGTH = 0xFFFFFFFF;
+
+constexpr uint32_t makeTag(uint16_t group, uint16_t element) {
+    return (static_cast<uint32_t>(group) << 16) | element;
+}
+
+constexpr uint32_t TRANSFER_SYNTAX = makeTag(0x0002, 0x0010);
+constexpr uint32_t SAMPLES_PER_PIXEL = makeTag(0x0028, 0x0002);
+constexpr uint32_t PHOTOMETRIC = makeTag(0x0028, 0x0004);
+constexpr uint32_t NUMBER_OF_FRAMES = makeTag(0x0028, 0x0008);
+constexpr uint32_t ROWS = makeTag(0x0028, 0x0010);
+constexpr uint32_t COLUMNS = makeTag(0x0028, 0x0011);
+constexpr uint32_t BITS_ALLOCATED = makeTag(0x0028, 0x0100);
+constexpr uint32_t BITS_STORED = makeTag(0x0028, 0x0101);
+constexpr uint32_t PIXEL_REPRESENTATION = makeTag(0x0028, 0x0103);
+constexpr uint32_t WINDOW_CENTER = makeTag(0x0028, 0x1050);
+constexpr uint32_t WINDOW_WIDTH = makeTag(0x0028, 0x1051);
+constexpr uint32_t RESCALE_INTERCEPT = makeTag(0x0028, 0x1052);
+constexpr uint32_t RESCALE_SLOPE = makeTag(0x0028, 0x1053);
+constexpr uint32_t PIXEL_DATA = makeTag(0x7FE0, 0x0010);
+constexpr uint32_t ITEM = makeTag(0xFFFE, 0xE000);
+constexpr uint32_t ITEM_END = makeTag(0xFFFE, 0xE00D);
+constexpr uint32_t SEQUENCE_END = makeTag(0xFFFE, 0xE0DD);
+
+struct Element {
+    uint32_t tag{0};
+    uint32_t length{0};
+    const uint8_t* value{nullptr};
+};
+
+// Sequential reader over the mapped file, values are little endian
+// like every host we build for
+class Cursor {
+public:
+    Cursor(const uint8_t* data, size_t size, size_t position)
+        : data_(data), size_(size), position_(position) {}
+
+    bool atEnd() const { return position_ >= size_; }
+    size_t remaining() const { return size_ - position_; }
+    const uint8_t* current() const { return data_ + position_; }
+
+    template <typename T>
+    T read() {
+        require(sizeof(T));
+        T value;
+        std::memcpy(&value, data_ + position_, sizeof(T));
+        position_ += sizeof(T);
+        return value;
+    }
+
+    void skip(size_t count) {
+        require(count);
+        position_ += count;
+    }
+
+    uint16_t peekGroup() const {
+        if (remaining() < 2) return 0;
+        uint16_t group;
+        std::memcpy(&group, data_ + position_, sizeof(group));
+        return group;
+    }
+
+    Element next(bool explicitVR) {
+        Element element;
+        uint16_t group = read<uint16_t>();
+        uint16_t number = read<uint16_t>();
+        element.tag = makeTag(group, number);
+
+        // Items and delimiters never carry a VR
+        if (!explicitVR || group == 0xFFFE) {
+            element.length = read<uint32_t>();
+        } else {
+            char vr[2] = {static_cast<char>(read<uint8_t>()), static_cast<char>(read<uint8_t>())};
+            if (hasLongLength(vr)) {
+                skip(2);
+                element.length = read<uint32_t>();
+            } else {
+                element.length = read<uint16_t>();
+            }
+        }
+
+        element.value = current();
+        return element;
+    }
+
+    // Skip an element's value, walking nested items when its length is undefined
+    void skipValue(const Element& element, bool explicitVR) {
+        if (element.length != UNDEFINED_LENGTH) {
+            skip(element.length);
+            return;
+        }
+        while (true) {
+            Element item = next(explicitVR);
+            if (item.tag == SEQUENCE_END || item.tag == ITEM_END) return;
+            skipValue(item, explicitVR);
+        }
+    }
+
+private:
+    static bool hasLongLength(const char vr[2]) {
+        static const char* const LONG_VRS[] = {
+            "OB", "OD", "OF", "OL", "OV", "OW", "SQ", "SV", "UC", "UN", "UR", "UT", "UV"};
+        for (const char* longVr : LONG_VRS) {
+            if (vr[0] == longVr[0] && vr[1] == longVr[1]) return true;
+        }
+        return false;
+    }
+
+    void require(size_t count) const {
+        if (count > remaining()) {
+            throw std::runtime_error("Truncated DICOM file");
+        }
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_;
+};
+
+// First value of a string element, without padding
+std::string stringValue(const Element& element) {
+    std::string value(reinterpret_cast<const char*>(element.value), element.length);
+    value = value.substr(0, value.find('\\'));
+    size_t first = value.find_first_not_of(" \0", 0, 2);
+    size_t last = value.find_last_not_of(" \0", std::string::npos, 2);
+    return first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+}
+
+double numberValue(const Element& element) {
+    return std::strtod(stringValue(element).c_str(), nullptr);
+}
+
+int ushortValue(const Element& element) {
+    if (element.length < 2) return 0;
+    uint16_t value;
+    std::memcpy(&value, element.value, sizeof(value));
+    return value;
+}
+
+// PackBits decoding of one RLE segment
+void decodeRleSegment(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < srcSize && out < dstSize) {
+        int8_t header = static_cast<int8_t>(src[in++]);
+        if (header >= 0) {
+            size_t count = std::min<size_t>(header + 1, std::min(srcSize - in, dstSize - out));
+            std::memcpy(dst + out, src + in, count);
+            in += header + 1;
+            out += count;
+        } else if (header != -128 && in < srcSize) {
+            size_t count = std::min<size_t>(1 - header, dstSize - out);
+            std::memset(dst + out, src[in++], count);
+            out += count;
+        }
+    }
+    if (out < dstSize) {
+        throw std::runtime_error("Truncated RLE segment");
+    }
+}
+
+// A stored value with the bits above bitsStored cleared and, for signed
+// data, sign-extended from the stored high bit (taken as bitsStored - 1,
+// as nearly every IOD requires)
+template <typename T>
+T storedBits(T value, int bitsStored, bool isSigned) {
+    const T mask = static_cast<T>((1u << bitsStored) - 1);
+    const T signBit = static_cast<T>(1u << (bitsStored - 1));
+    value &= mask;
+    if (isSigned && (value & signBit)) value |= static_cast<T>(~mask);
+    return value;
+}
+
+// Whether any pixel has high bits that storedBits would change; most
+// files have none and their pixels can stay in the mapping
+template <typename T>
+bool hasStrayHighBits(const cv::Mat& pixels, int bitsStored, bool isSigned) {
+    for (int y = 0; y < pixels.rows; ++y) {
+        const T* row = pixels.ptr<T>(y);
+        for (int x = 0; x < pixels.cols; ++x) {
+            if (row[x] != storedBits(row[x], bitsStored, isSigned)) return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+void keepStoredBits(cv::Mat& pixels, int bitsStored, bool isSigned) {
+    for (int y = 0; y < pixels.rows; ++y) {
+        T* row = pixels.ptr<T>(y);
+        for (int x = 0; x < pixels.cols; ++x) {
+            row[x] = storedBits(row[x], bitsStored, isSigned);
+        }
+    }
+}
+
+} // namespace
+
+// ---------- DicomImage ----------
+
+DicomImage::DicomImage() = default;
+DicomImage::~DicomImage() = default;
+
+bool DicomImage::isDicomFile(const std::string& filepath) {
+    std::ifstream in(filepath, std::ios::binary);
+    char header[PREAMBLE_SIZE + 4];
+    if (!in.read(header, sizeof(header))) return false;
+    return std::memcmp(header + PREAMBLE_SIZE, "DICM", 4) == 0;
+}
+
+void DicomImage::open(const std::string& filepath) {
+    pixels_.release();
+    info_ = Info();
+    file_ = std::make_unique<MappedFile>(filepath);
+
+    if (file_->size() < PREAMBLE_SIZE + 4 ||
+        std::memcmp(file_->data() + PREAMBLE_SIZE, "DICM", 4) != 0) {
+        throw std::runtime_error("Not a DICOM file: " + filepath);
+    }
+    Cursor cursor(file_->data(), file_->size(), PREAMBLE_SIZE + 4);
+
+    // File meta information is always explicit VR little endian
+    while (cursor.peekGroup() == 0x0002) {
+        Element element = cursor.next(true);
+        if (element.tag == TRANSFER_SYNTAX) {
+            info_.transferSyntax = stringValue(element);
+        }
+        cursor.skipValue(element, true);
+    }
+
+    const bool explicitVR = info_.transferSyntax != IMPLICIT_VR_LITTLE_ENDIAN;
+    const bool encapsulated = info_.transferSyntax == RLE_LOSSLESS;
+    if (info_.transferSyntax != IMPLICIT_VR_LITTLE_ENDIAN &&
+        info_.transferSyntax != EXPLICIT_VR_LITTLE_ENDIAN && !encapsulated) {
+        throw std::runtime_error("Unsupported transfer syntax: " + info_.transferSyntax);
+    }
+
+    int samplesPerPixel = 1;
+    while (!cursor.atEnd()) {
+        Element element = cursor.next(explicitVR);
+
+        if (element.tag == PIXEL_DATA) {
+            if (samplesPerPixel != 1) {
+                throw std::runtime_error("Only grayscale DICOM images are supported");
+            }
+            size_t length = element.length == UNDEFINED_LENGTH
+                ? cursor.remaining()
+                : std::min<size_t>(element.length, cursor.remaining());
+            readPixelData(element.value, length, encapsulated);
+            return;
+        }
+
+        switch (element.tag) {
+            case SAMPLES_PER_PIXEL:    samplesPerPixel = ushortValue(element); break;
+            case PHOTOMETRIC:          info_.photometricInterpretation = stringValue(element); break;
+            case NUMBER_OF_FRAMES:     info_.frames = std::max(1, std::atoi(stringValue(element).c_str())); break;
+            case ROWS:                 info_.rows = ushortValue(element); break;
+            case COLUMNS:              info_.cols = ushortValue(element); break;
+            case BITS_ALLOCATED:       info_.bitsAllocated = ushortValue(element); break;
+            case BITS_STORED:          info_.bitsStored = ushortValue(element); break;
+            case PIXEL_REPRESENTATION: info_.isSigned = ushortValue(element) == 1; break;
+            case WINDOW_CENTER:        info_.windowCenter = numberValue(element); break;
+            case WINDOW_WIDTH:         info_.windowWidth = numberValue(element); break;
+            case RESCALE_INTERCEPT:    info_.rescaleIntercept = numberValue(element); break;
+            case RESCALE_SLOPE:        info_.rescaleSlope = numberValue(element); break;
+            default: break;
+        }
+        cursor.skipValue(element, explicitVR);
+    }
+
+    throw std::runtime_error("No pixel data in " + filepath);
+}
+
+void DicomImage::readPixelData(const uint8_t* data, size_t length, bool encapsulated) {
+    if (info_.rows <= 0 || info_.cols <= 0) {
+        throw std::runtime_error("Invalid DICOM image dimensions");
+    }
+    if (info_.bitsAllocated != 8 && info_.bitsAllocated != 16) {
+        throw std::runtime_error("Unsupported bits allocated: " + std::to_string(info_.bitsAllocated));
+    }
+    if (info_.rescaleSlope == 0.0) {
+        info_.rescaleSlope = 1.0;
+    }
+
+    const size_t pixelCount = static_cast<size_t>(info_.rows) * info_.cols;
+    const int bytesPerPixel = info_.bitsAllocated / 8;
+    const int depth = bytesPerPixel == 2 ? (info_.isSigned ? CV_16S : CV_16U)
+                                         : (info_.isSigned ? CV_8S : CV_8U);
+    cv::Mat stored;
+
+    if (!encapsulated) {
+        if (length < pixelCount * bytesPerPixel) {
+            throw std::runtime_error("Truncated DICOM pixel data");
+        }
+        // View straight into the mapping, element values start on even offsets
+        stored = cv::Mat(info_.rows, info_.cols, depth, const_cast<uint8_t*>(data));
+    } else {
+        // Encapsulated fragments: basic offset table, then one fragment per frame
+        Cursor cursor(data, length, 0);
+        Element offsetTable = cursor.next(false);
+        if (offsetTable.tag != ITEM) throw std::runtime_error("Malformed encapsulated pixel data");
+        cursor.skip(offsetTable.length);
+        Element fragment = cursor.next(false);
+        if (fragment.tag != ITEM || fragment.length < 64 || fragment.length > cursor.remaining()) {
+            throw std::runtime_error("Malformed RLE fragment");
+        }
+
+        uint32_t header[16];
+        std::memcpy(header, fragment.value, sizeof(header));
+        const uint32_t segmentCount = header[0];
+        if (segmentCount != static_cast<uint32_t>(bytesPerPixel)) {
+            throw std::runtime_error("Unexpected RLE segment count");
+        }
+
+        // Segments hold one byte plane each, most significant first
+        stored.create(info_.rows, info_.cols, depth);
+        std::vector<uint8_t> plane(pixelCount);
+        for (uint32_t s = 0; s < segmentCount; ++s) {
+            uint32_t begin = header[1 + s];
+            uint32_t end = s + 1 < segmentCount ? header[2 + s] : fragment.length;
+            if (begin >= end || end > fragment.length) {
+                throw std::runtime_error("Malformed RLE segment offsets");
+            }
+            decodeRleSegment(fragment.value + begin, end - begin, plane.data(), pixelCount);
+
+            uint8_t* dst = stored.ptr<uint8_t>() + (bytesPerPixel - 1 - s);
+            for (size_t i = 0; i < pixelCount; ++i) {
+                dst[i * bytesPerPixel] = plane[i];
+            }
+        }
+    }
+
+    // Some scanners leave other data in the unused high bits, and signed
+    // data may not be sign-extended; only then are the pixels copied
+    if (info_.bitsStored > 0 && info_.bitsStored < info_.bitsAllocated) {
+        const bool stray = bytesPerPixel == 2
+            ? hasStrayHighBits<uint16_t>(stored, info_.bitsStored, info_.isSigned)
+            : hasStrayHighBits<uint8_t>(stored, info_.bitsStored, info_.isSigned);
+        if (stray) {
+            if (!encapsulated) {
+                stored = stored.clone();    // The mapping is read only
+            }
+            if (bytesPerPixel == 2) {
+                keepStoredBits<uint16_t>(stored, info_.bitsStored, info_.isSigned);
+            } else {
+                keepStoredBits<uint8_t>(stored, info_.bitsStored, info_.isSigned);
+            }
+        }
+    }
+
+    if (depth == CV_16U) {
+        pixels_ = stored;
+        return;
+    }
+
+    // Everything else is brought to the unsigned 16-bit range
+    double offset = info_.isSigned ? (bytesPerPixel == 2 ? 32768.0 : 128.0) : 0.0;
+    stored.convertTo(pixels_, CV_16U, 1.0, offset);
+    info_.rescaleIntercept -= offset * info_.rescaleSlope;
+}
+
+cv::Mat DicomImage::window(double center, double width) const {
+    if (pixels_.empty()) return cv::Mat();
+
+    // Linear VOI LUT from PS3.3 C.11.2.1.2 folded with the modality rescale
+    // into a single scale and offset on stored values
+    double span = std::max(width - 1.0, 1.0);
+    double alpha = info_.rescaleSlope * 255.0 / span;
+    double beta = ((info_.rescaleIntercept - (center - 0.5)) / span + 0.5) * 255.0;
+
+    if (info_.photometricInterpretation == "MONOCHROME1") {
+        alpha = -alpha;
+        beta = 255.0 - beta;
+    }
+
+    cv::Mat result;
+    pixels_.convertTo(result, CV_8U, alpha, beta);
+    return result;
+}
+
+cv::Mat DicomImage::window() const {
+    if (info_.windowWidth > 0.0) {
+        return window(info_.windowCenter, info_.windowWidth);
+    }
+
+    double minValue = 0.0, maxValue = 0.0;
+    cv::minMaxLoc(pixels_, &minValue, &maxValue);
+    minValue = minValue * info_.rescaleSlope + info_.rescaleIntercept;
+    maxValue = maxValue * info_.rescaleSlope + info_.rescaleIntercept;
+    if (minValue > maxValue) std::swap(minValue, maxValue);
+    return window((minValue + maxValue) / 2.0 + 0.5, maxValue - minValue + 1.0);
+}
+
+} // namespace medical_vision
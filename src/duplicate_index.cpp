@@ -0,0 +1,246 @@
+/**
+ * @file duplicate_index.cpp
+ * @brief Perceptual hashing and multi-index Hamming search
+ */
+
+#include "../include/medical_vision/duplicate_index.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace medical_vision {
+
+namespace {
+
+constexpr int HASH_SIZE = 32;       // Side of the downsample both hashes start from
+constexpr int LOW_FREQUENCIES = 8;  // Side of the DCT block behind the perceptual hash
+
+// Beyond this many bits per chunk the buckets visited cost more than a scan
+constexpr int MAX_CHUNK_DISTANCE = 4;
+
+// File layout: magic, version, hash count, then the hashes in host byte order
+const char INDEX_MAGIC[4] = {'M', 'V', 'D', 'I'};
+constexpr uint32_t INDEX_VERSION = 1;
+
+inline int popcount(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(value);
+#else
+    return static_cast<int>(std::bitset<64>(value).count());
+#endif
+}
+
+// Calls fn with every value within distance bits of value, flipping bits
+// from bit upwards
+template <typename Fn>
+void forEachWithin(uint32_t value, int distance, int bit, int bits, Fn& fn) {
+    fn(value);
+    if (distance == 0) return;
+    for (int b = bit; b < bits; ++b) {
+        forEachWithin(value ^ (1u << b), distance - 1, b + 1, bits, fn);
+    }
+}
+
+} // namespace
+
+ImageHashes computeImageHashes(const cv::Mat& image) {
+    if (image.empty() || (image.depth() != CV_8U && image.depth() != CV_16U)) {
+        throw std::runtime_error("Hashing needs an 8 or 16-bit image");
+    }
+
+    cv::Mat gray = image;
+    if (image.channels() == 3) {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    } else if (image.channels() == 4) {
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    } else if (image.channels() != 1) {
+        throw std::runtime_error("Hashing needs a gray or color image");
+    }
+
+    // Area averaging removes codec noise and makes the hashes size independent
+    cv::Mat small;
+    cv::resize(gray, small, cv::Size(HASH_SIZE, HASH_SIZE), 0, 0, cv::INTER_AREA);
+    small.convertTo(small, CV_32F);
+
+    ImageHashes hashes;
+
+    // Brighter or darker than the right neighbour on a 9x8 grid
+    cv::Mat reduced;
+    cv::resize(small, reduced, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+    for (int y = 0; y < 8; ++y) {
+        const float* row = reduced.ptr<float>(y);
+        for (int x = 0; x < 8; ++x) {
+            if (row[x] < row[x + 1]) {
+                hashes.difference |= uint64_t(1) << (y * 8 + x);
+            }
+        }
+    }
+
+    // Lowest frequencies after the constant row and column, above their median
+    cv::Mat frequencies;
+    cv::dct(small, frequencies);
+    float low[LOW_FREQUENCIES * LOW_FREQUENCIES];
+    for (int y = 0; y < LOW_FREQUENCIES; ++y) {
+        const float* row = frequencies.ptr<float>(y + 1) + 1;
+        std::copy(row, row + LOW_FREQUENCIES, low + y * LOW_FREQUENCIES);
+    }
+    float sorted[LOW_FREQUENCIES * LOW_FREQUENCIES];
+    std::copy(std::begin(low), std::end(low), sorted);
+    float* middle = sorted + LOW_FREQUENCIES * LOW_FREQUENCIES / 2;
+    std::nth_element(std::begin(sorted), middle, std::end(sorted));
+    const float median = *middle;
+    for (int i = 0; i < LOW_FREQUENCIES * LOW_FREQUENCIES; ++i) {
+        if (low[i] > median) {
+            hashes.perceptual |= uint64_t(1) << i;
+        }
+    }
+
+    return hashes;
+}
+
+int hammingDistance(uint64_t a, uint64_t b) {
+    return popcount(a ^ b);
+}
+
+// ---------- DuplicateIndex ----------
+
+uint32_t DuplicateIndex::add(uint64_t hash) {
+    if (hashes_.size() >= std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Duplicate index is full");
+    }
+    hashes_.push_back(hash);
+    return static_cast<uint32_t>(hashes_.size() - 1);
+}
+
+void DuplicateIndex::build() {
+    const size_t count = hashes_.size();
+
+    // Counting sort of the ids on each chunk, one chunk per task
+    TaskScheduler::instance().parallelFor(0, CHUNK_COUNT, [&](int first, int last) {
+        for (int chunk = first; chunk < last; ++chunk) {
+            ChunkTable& table = tables_[chunk];
+            table.offsets.assign(CHUNK_VALUES + 1, 0);
+            for (size_t id = 0; id < count; ++id) {
+                ++table.offsets[chunkOf(hashes_[id], chunk) + 1];
+            }
+            for (size_t value = 0; value < CHUNK_VALUES; ++value) {
+                table.offsets[value + 1] += table.offsets[value];
+            }
+
+            std::vector<uint32_t> next(table.offsets.begin(), table.offsets.end() - 1);
+            table.ids.resize(count);
+            table.hashes.resize(count);
+            for (size_t id = 0; id < count; ++id) {
+                const uint32_t slot = next[chunkOf(hashes_[id], chunk)]++;
+                table.ids[slot] = static_cast<uint32_t>(id);
+                table.hashes[slot] = hashes_[id];
+            }
+        }
+    }, 1);
+
+    indexed_ = count;
+}
+
+std::vector<DuplicateIndex::Match> DuplicateIndex::query(uint64_t hash, int maxDistance) const {
+    std::vector<Match> matches;
+    if (maxDistance < 0) return matches;
+
+    auto check = [&](uint32_t id, uint64_t other) {
+        const int distance = hammingDistance(hash, other);
+        if (distance <= maxDistance) {
+            matches.push_back({id, distance});
+        }
+    };
+
+    // maxDistance = CHUNK_COUNT * s + a: a match is within s bits on one of
+    // the first a + 1 chunks or within s - 1 bits on one of the others
+    int chunkDistances[CHUNK_COUNT];
+    for (int chunk = 0; chunk < CHUNK_COUNT; ++chunk) {
+        chunkDistances[chunk] = maxDistance / CHUNK_COUNT -
+                                (chunk > maxDistance % CHUNK_COUNT ? 1 : 0);
+    }
+
+    size_t scanFrom = indexed_;
+    if (chunkDistances[0] > MAX_CHUNK_DISTANCE) {
+        scanFrom = 0;
+    } else if (indexed_ > 0) {
+        uint32_t chunks[CHUNK_COUNT];
+        for (int chunk = 0; chunk < CHUNK_COUNT; ++chunk) {
+            chunks[chunk] = chunkOf(hash, chunk);
+        }
+
+        for (int chunk = 0; chunk < CHUNK_COUNT && chunkDistances[chunk] >= 0; ++chunk) {
+            const ChunkTable& table = tables_[chunk];
+            auto visit = [&](uint32_t value) {
+                for (uint32_t i = table.offsets[value]; i < table.offsets[value + 1]; ++i) {
+                    const uint64_t other = table.hashes[i];
+                    // Hashes close on an earlier chunk were checked there
+                    bool seen = false;
+                    for (int earlier = 0; earlier < chunk && !seen; ++earlier) {
+                        seen = popcount(chunkOf(other, earlier) ^ chunks[earlier]) <= chunkDistances[earlier];
+                    }
+                    if (!seen) {
+                        check(table.ids[i], other);
+                    }
+                }
+            };
+            forEachWithin(chunks[chunk], chunkDistances[chunk], 0, CHUNK_BITS, visit);
+        }
+    }
+
+    // Hashes added since the last build
+    for (size_t id = scanFrom; id < hashes_.size(); ++id) {
+        check(static_cast<uint32_t>(id), hashes_[id]);
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+        return a.distance != b.distance ? a.distance < b.distance : a.id < b.id;
+    });
+    return matches;
+}
+
+bool DuplicateIndex::nearest(uint64_t hash, int maxDistance, Match& match) const {
+    std::vector<Match> matches = query(hash, maxDistance);
+    if (matches.empty()) return false;
+    match = matches.front();
+    return true;
+}
+
+bool DuplicateIndex::save(const std::string& filepath) const {
+    std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+    const uint64_t count = hashes_.size();
+    out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    out.write(reinterpret_cast<const char*>(&INDEX_VERSION), sizeof(INDEX_VERSION));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(hashes_.data()), count * sizeof(uint64_t));
+    return static_cast<bool>(out);
+}
+
+bool DuplicateIndex::load(const std::string& filepath) {
+    std::ifstream in(filepath, std::ios::binary);
+    char magic[sizeof(INDEX_MAGIC)];
+    uint32_t version = 0;
+    uint64_t count = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || std::memcmp(magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        version != INDEX_VERSION || count >= std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+
+    std::vector<uint64_t> hashes(count);
+    in.read(reinterpret_cast<char*>(hashes.data()), count * sizeof(uint64_t));
+    if (!in) return false;
+
+    hashes_ = std::move(hashes);
+    build();
+    return true;
+}
+
+} // namespace medical_vision
@@ -4,8 +4,11 @@
  */
 
 #include "../include/medical_vision/feature_detector.hpp"
+#include "../include/medical_vision/segmentation.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
 #include <opencv2/imgproc.hpp>
 #include <opencv2/features2d.hpp>
+#include <algorithm>
 #include <stdexcept>
 
 namespace medical_vision {
@@ -65,13 +68,15 @@ cv::Mat FeatureDetector::applyCanny(const cv::Mat& input, const EdgeParams& para
 cv::Mat FeatureDetector::applySobel(const cv::Mat& input, const EdgeParams& params) {
     cv::Mat gradX, gradY, grad;
     
-    // Compute gradients in x and y directions
-    cv::Sobel(input, gradX, CV_16S, 1, 0, params.apertureSize);
+    // Compute gradients in x and y directions, the two run concurrently
+    TaskGroup group;
+    group.run([&]() {
+        cv::Sobel(input, gradX, CV_16S, 1, 0, params.apertureSize);
+        cv::convertScaleAbs(gradX, gradX);
+    });
     cv::Sobel(input, gradY, CV_16S, 0, 1, params.apertureSize);
-    
-    // Convert gradients to absolute values
-    cv::convertScaleAbs(gradX, gradX);
     cv::convertScaleAbs(gradY, gradY);
+    group.wait();
     
     // Combine gradients
     cv::addWeighted(gradX, 0.5, gradY, 0.5, 0, grad);
@@ -94,36 +99,62 @@ cv::Mat FeatureDetector::applyLaplacian(const cv::Mat& input, const EdgeParams&
 // Keypoint detection implementations
 std::vector<cv::KeyPoint> FeatureDetector::detectKeypoints(const cv::Mat& input,
                                                          KeypointDetector method,
-                                                         const KeypointParams& params) {
+                                                         const KeypointParams& params,
+                                                         const cv::Mat& mask) {
     try {
         validateInput(input);
-        cv::Mat processed = prepareImage(input);
 
+        // With a mask only its bounds are searched, plus the border the
+        // detectors need around a keypoint
+        cv::Rect bounds(0, 0, input.cols, input.rows);
+        cv::Mat regionMask;
+        if (!mask.empty()) {
+            if (mask.type() != CV_8UC1 || mask.size() != input.size()) {
+                throw std::runtime_error("Mask must be 8-bit single channel of the image size");
+            }
+            bounds = Segmentation::maskBounds(mask, std::max(params.edgeThreshold, 16));
+            if (bounds.empty()) {
+                return {};
+            }
+            regionMask = mask(bounds);
+        }
+        cv::Mat processed = prepareImage(input(bounds));
+
+        std::vector<cv::KeyPoint> keypoints;
         switch (method) {
             case KeypointDetector::SIFT:
-                return applySIFT(processed, params);
+                keypoints = applySIFT(processed, regionMask, params);
+                break;
             case KeypointDetector::ORB:
-                return applyORB(processed, params);
+                keypoints = applyORB(processed, regionMask, params);
+                break;
             case KeypointDetector::FAST:
-                return applyFAST(processed, params);
+                keypoints = applyFAST(processed, regionMask, params);
+                break;
             default:
                 throw std::runtime_error("Unknown keypoint detection method");
         }
+
+        for (auto& keypoint : keypoints) {
+            keypoint.pt.x += bounds.x;
+            keypoint.pt.y += bounds.y;
+        }
+        return keypoints;
     }
     catch (const std::exception& e) {
         throw std::runtime_error(std::string("Keypoint detection failed: ") + e.what());
     }
 }
 
-std::vector<cv::KeyPoint> FeatureDetector::applySIFT(const cv::Mat& input, 
+std::vector<cv::KeyPoint> FeatureDetector::applySIFT(const cv::Mat& input, const cv::Mat& mask,
                                                     const KeypointParams& params) {
     auto detector = cv::SIFT::create(params.maxKeypoints);
     std::vector<cv::KeyPoint> keypoints;
-    detector->detect(input, keypoints);
+    detector->detect(input, keypoints, mask);
     return keypoints;
 }
 
-std::vector<cv::KeyPoint> FeatureDetector::applyORB(const cv::Mat& input, 
+std::vector<cv::KeyPoint> FeatureDetector::applyORB(const cv::Mat& input, const cv::Mat& mask,
                                                    const KeypointParams& params) {
     auto detector = cv::ORB::create(
         params.maxKeypoints,
@@ -132,14 +163,17 @@ std::vector<cv::KeyPoint> FeatureDetector::applyORB(const cv::Mat& input,
         params.edgeThreshold
     );
     std::vector<cv::KeyPoint> keypoints;
-    detector->detect(input, keypoints);
+    detector->detect(input, keypoints, mask);
     return keypoints;
 }
 
-std::vector<cv::KeyPoint> FeatureDetector::applyFAST(const cv::Mat& input, 
+std::vector<cv::KeyPoint> FeatureDetector::applyFAST(const cv::Mat& input, const cv::Mat& mask,
                                                     const KeypointParams& params) {
     std::vector<cv::KeyPoint> keypoints;
     cv::FAST(input, keypoints, params.fastThreshold);
+    if (!mask.empty()) {
+        cv::KeyPointsFilter::runByPixelsMask(keypoints, mask);
+    }
     
     // Limit number of keypoints if necessary
     if (keypoints.size() > params.maxKeypoints) {
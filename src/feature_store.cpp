@@ -0,0 +1,446 @@
+/**
+ * @file feature_store.cpp
+ * @brief Implementation of the columnar feature store
+ */
+
+#include "../include/medical_vision/feature_store.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+namespace medical_vision {
+
+namespace {
+
+const char STORE_MAGIC[4] = {'M', 'V', 'F', 'S'};
+const char BLOCK_MAGIC[4] = {'M', 'V', 'F', 'B'};
+constexpr uint32_t STORE_VERSION = 1;
+
+struct BlockHeader {
+    char magic[4];
+    uint32_t count;
+    uint64_t bodyBytes;
+};
+
+// ---------- Writing ----------
+
+void padTo8(std::vector<char>& bytes) {
+    bytes.resize((bytes.size() + 7) & ~size_t(7), 0);
+}
+
+template <typename T>
+void appendColumn(std::vector<char>& body, const T* values, size_t count) {
+    const char* data = reinterpret_cast<const char*>(values);
+    body.insert(body.end(), data, data + count * sizeof(T));
+    padTo8(body);
+}
+
+template <typename T>
+T checkedOffset(size_t value) {
+    if (value > std::numeric_limits<T>::max()) {
+        throw std::runtime_error("Feature store block too large, use a smaller block size");
+    }
+    return static_cast<T>(value);
+}
+
+// Alternating run lengths of zero and nonzero pixels, row by row,
+// starting with a zero run that may be empty
+void encodeMask(const cv::Mat& mask, std::vector<uint32_t>& runs) {
+    bool inside = false;
+    uint32_t length = 0;
+    for (int y = 0; y < mask.rows; ++y) {
+        const uchar* row = mask.ptr<uchar>(y);
+        for (int x = 0; x < mask.cols; ++x) {
+            if ((row[x] != 0) != inside) {
+                runs.push_back(length);
+                inside = !inside;
+                length = 0;
+            }
+            ++length;
+        }
+    }
+    runs.push_back(length);
+}
+
+// ---------- Reading ----------
+
+// Walks a block body column by column, checking every bound
+class Columns {
+public:
+    Columns(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    const T* take(size_t count) {
+        if (count > (size_ - position_) / sizeof(T)) {
+            throw std::runtime_error("Truncated feature store column");
+        }
+        const T* column = reinterpret_cast<const T*>(data_ + position_);
+        position_ = std::min(size_, (position_ + count * sizeof(T) + 7) & ~size_t(7));
+        return column;
+    }
+
+    // Offsets column whose entries must grow up to its last one
+    const uint32_t* offsets(size_t count) {
+        const uint32_t* column = take<uint32_t>(count + 1);
+        for (size_t i = 0; i < count; ++i) {
+            if (column[i] > column[i + 1]) {
+                throw std::runtime_error("Corrupt feature store offsets");
+            }
+        }
+        return column;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_{0};
+};
+
+} // namespace
+
+// ---------- FeatureRecord ----------
+
+void FeatureRecord::setPredictions(const std::vector<ChestXRayAnalyzer::Detection>& detections,
+                                   const std::vector<std::string>& labels) {
+    predictions.assign(labels.size(), std::numeric_limits<float>::quiet_NaN());
+    for (const auto& detection : detections) {
+        auto it = std::find(labels.begin(), labels.end(), detection.pathology);
+        if (it != labels.end()) {
+            predictions[it - labels.begin()] = detection.confidence;
+        }
+    }
+}
+
+// ---------- FeatureStoreWriter ----------
+
+struct FeatureStoreWriter::PendingBlock {
+    std::vector<uint64_t> perceptual, difference;
+    std::vector<uint32_t> idOffsets{0};
+    std::vector<char> idChars;
+    std::vector<float> predictions, texture;
+    std::vector<int32_t> maskSizes;
+    std::vector<uint32_t> runOffsets{0};
+    std::vector<uint32_t> runs;
+    std::vector<uint32_t> keypointOffsets{0};
+    std::vector<FeatureStoreReader::StoredKeypoint> keypoints;
+};
+
+FeatureStoreWriter::FeatureStoreWriter(const std::string& filepath, const std::vector<std::string>& labels,
+                                       int textureSize, size_t blockSize)
+    : filepath_(filepath),
+      labelCount_(labels.size()),
+      textureSize_(static_cast<size_t>(std::max(textureSize, 0))),
+      blockSize_(std::max<size_t>(blockSize, 1)),
+      pending_(std::make_unique<PendingBlock>()) {
+    std::error_code error;
+    if (std::filesystem::exists(filepath, error) && std::filesystem::file_size(filepath, error) > 0) {
+        size_t validBytes = 0;
+        {
+            FeatureStoreReader existing(filepath);
+            if (existing.labels() != labels || existing.textureSize() != textureSize_) {
+                throw std::runtime_error("Feature store has other labels or texture size: " + filepath);
+            }
+            written_ = existing.size();
+            validBytes = existing.validBytes();
+        }
+        // Drop a block a crash left unfinished
+        if (std::filesystem::file_size(filepath) > validBytes) {
+            std::filesystem::resize_file(filepath, validBytes);
+        }
+        out_.open(filepath, std::ios::binary | std::ios::app);
+        if (!out_) {
+            throw std::runtime_error("Cannot open feature store: " + filepath);
+        }
+        return;
+    }
+
+    out_.open(filepath, std::ios::binary | std::ios::trunc);
+    std::vector<char> header(STORE_MAGIC, STORE_MAGIC + sizeof(STORE_MAGIC));
+    const uint32_t fields[] = {STORE_VERSION, static_cast<uint32_t>(labelCount_),
+                               static_cast<uint32_t>(textureSize_)};
+    header.insert(header.end(), reinterpret_cast<const char*>(fields),
+                  reinterpret_cast<const char*>(fields) + sizeof(fields));
+    for (const std::string& label : labels) {
+        const uint32_t length = static_cast<uint32_t>(label.size());
+        header.insert(header.end(), reinterpret_cast<const char*>(&length),
+                      reinterpret_cast<const char*>(&length) + sizeof(length));
+        header.insert(header.end(), label.begin(), label.end());
+    }
+    padTo8(header);
+    out_.write(header.data(), header.size());
+    out_.flush();
+    if (!out_) {
+        throw std::runtime_error("Cannot write feature store: " + filepath);
+    }
+}
+
+FeatureStoreWriter::~FeatureStoreWriter() {
+    try {
+        flush();
+    }
+    catch (const std::exception&) {
+        // Nothing to report to from a destructor
+    }
+}
+
+void FeatureStoreWriter::append(const FeatureRecord& record) {
+    if (record.predictions.size() != labelCount_) {
+        throw std::runtime_error("Feature record has " + std::to_string(record.predictions.size()) +
+                                 " predictions, the store " + std::to_string(labelCount_));
+    }
+    if (record.texture.size() != textureSize_) {
+        throw std::runtime_error("Feature record has " + std::to_string(record.texture.size()) +
+                                 " texture features, the store " + std::to_string(textureSize_));
+    }
+    if (!record.mask.empty() && record.mask.type() != CV_8UC1) {
+        throw std::runtime_error("Feature record masks must be CV_8UC1");
+    }
+
+    std::vector<uint32_t> runs;
+    if (!record.mask.empty()) {
+        encodeMask(record.mask, runs);
+    }
+
+    // Offsets are 32-bit within a block, checked before anything changes
+    PendingBlock& block = *pending_;
+    const uint32_t idEnd = checkedOffset<uint32_t>(block.idChars.size() + record.imageId.size());
+    const uint32_t runEnd = checkedOffset<uint32_t>(block.runs.size() + runs.size());
+    const uint32_t keypointEnd = checkedOffset<uint32_t>(block.keypoints.size() + record.keypoints.size());
+
+    block.perceptual.push_back(record.hashes.perceptual);
+    block.difference.push_back(record.hashes.difference);
+    block.idChars.insert(block.idChars.end(), record.imageId.begin(), record.imageId.end());
+    block.idOffsets.push_back(idEnd);
+    block.predictions.insert(block.predictions.end(), record.predictions.begin(), record.predictions.end());
+    block.texture.insert(block.texture.end(), record.texture.begin(), record.texture.end());
+    block.maskSizes.push_back(record.mask.empty() ? 0 : record.mask.rows);
+    block.maskSizes.push_back(record.mask.empty() ? 0 : record.mask.cols);
+    block.runs.insert(block.runs.end(), runs.begin(), runs.end());
+    block.runOffsets.push_back(runEnd);
+    for (const cv::KeyPoint& keypoint : record.keypoints) {
+        block.keypoints.push_back({keypoint.pt.x, keypoint.pt.y, keypoint.size, keypoint.angle,
+                                   keypoint.response, keypoint.octave, keypoint.class_id});
+    }
+    block.keypointOffsets.push_back(keypointEnd);
+
+    if (++pendingCount_ >= blockSize_) {
+        flush();
+    }
+}
+
+void FeatureStoreWriter::flush() {
+    if (pendingCount_ == 0) return;
+    const size_t count = pendingCount_;
+    const PendingBlock& block = *pending_;
+
+    // Same column order as FeatureStoreReader::Block
+    std::vector<char> body;
+    appendColumn(body, block.perceptual.data(), count);
+    appendColumn(body, block.difference.data(), count);
+    appendColumn(body, block.idOffsets.data(), count + 1);
+    appendColumn(body, block.idChars.data(), block.idChars.size());
+    appendColumn(body, block.predictions.data(), block.predictions.size());
+    appendColumn(body, block.texture.data(), block.texture.size());
+    appendColumn(body, block.maskSizes.data(), block.maskSizes.size());
+    appendColumn(body, block.runOffsets.data(), count + 1);
+    appendColumn(body, block.runs.data(), block.runs.size());
+    appendColumn(body, block.keypointOffsets.data(), count + 1);
+    appendColumn(body, block.keypoints.data(), block.keypoints.size());
+
+    BlockHeader header;
+    std::memcpy(header.magic, BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+    header.count = static_cast<uint32_t>(count);
+    header.bodyBytes = body.size();
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.write(body.data(), body.size());
+    out_.flush();
+    if (!out_) {
+        throw std::runtime_error("Cannot write feature store: " + filepath_);
+    }
+    written_ += count;
+    pendingCount_ = 0;
+    *pending_ = PendingBlock();
+}
+
+// ---------- FeatureStoreReader ----------
+
+FeatureStoreReader::FeatureStoreReader(const std::string& filepath)
+    : file_(std::make_unique<MappedFile>(filepath)) {
+    const uint8_t* data = file_->data();
+    const size_t size = file_->size();
+
+    uint32_t fields[3];
+    if (size < sizeof(STORE_MAGIC) + sizeof(fields) ||
+        std::memcmp(data, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0) {
+        throw std::runtime_error("Not a feature store: " + filepath);
+    }
+    std::memcpy(fields, data + sizeof(STORE_MAGIC), sizeof(fields));
+    if (fields[0] != STORE_VERSION) {
+        throw std::runtime_error("Unsupported feature store version: " + filepath);
+    }
+    textureSize_ = fields[2];
+
+    size_t position = sizeof(STORE_MAGIC) + sizeof(fields);
+    for (uint32_t i = 0; i < fields[1]; ++i) {
+        uint32_t length = 0;
+        if (size - position < sizeof(length)) {
+            throw std::runtime_error("Truncated feature store header: " + filepath);
+        }
+        std::memcpy(&length, data + position, sizeof(length));
+        position += sizeof(length);
+        if (size - position < length) {
+            throw std::runtime_error("Truncated feature store header: " + filepath);
+        }
+        labels_.emplace_back(reinterpret_cast<const char*>(data + position), length);
+        position += length;
+    }
+    position = (position + 7) & ~size_t(7);
+    validBytes_ = std::min(position, size);
+
+    // Blocks up to the first incomplete or damaged one
+    const size_t labelCount = labels_.size();
+    while (position <= size && size - position >= sizeof(BlockHeader)) {
+        BlockHeader header;
+        std::memcpy(&header, data + position, sizeof(header));
+        const size_t bodyStart = position + sizeof(header);
+        if (std::memcmp(header.magic, BLOCK_MAGIC, sizeof(BLOCK_MAGIC)) != 0 ||
+            header.bodyBytes > size - bodyStart) {
+            break;
+        }
+
+        Block block;
+        block.first = size_;
+        block.count = header.count;
+        try {
+            Columns columns(data + bodyStart, header.bodyBytes);
+            block.perceptual = columns.take<uint64_t>(block.count);
+            block.difference = columns.take<uint64_t>(block.count);
+            block.idOffsets = columns.offsets(block.count);
+            block.idChars = columns.take<char>(block.idOffsets[block.count]);
+            block.predictions = columns.take<float>(block.count * labelCount);
+            block.texture = columns.take<float>(block.count * textureSize_);
+            block.maskSizes = columns.take<int32_t>(2 * block.count);
+            block.runOffsets = columns.offsets(block.count);
+            block.runs = columns.take<uint32_t>(block.runOffsets[block.count]);
+            block.keypointOffsets = columns.offsets(block.count);
+            block.keypoints = columns.take<StoredKeypoint>(block.keypointOffsets[block.count]);
+        }
+        catch (const std::runtime_error&) {
+            break;
+        }
+
+        blocks_.push_back(block);
+        size_ += block.count;
+        position = bodyStart + header.bodyBytes;
+        validBytes_ = position;
+    }
+}
+
+const FeatureStoreReader::Block& FeatureStoreReader::locate(size_t i, size_t& row) const {
+    if (i >= size_) {
+        throw std::out_of_range("Feature store record out of range");
+    }
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), i,
+                               [](size_t index, const Block& block) { return index < block.first; });
+    const Block& block = *(it - 1);
+    row = i - block.first;
+    return block;
+}
+
+std::string_view FeatureStoreReader::imageId(size_t i) const {
+    size_t row;
+    const Block& block = locate(i, row);
+    return std::string_view(block.idChars + block.idOffsets[row], block.idOffsets[row + 1] - block.idOffsets[row]);
+}
+
+ImageHashes FeatureStoreReader::hashes(size_t i) const {
+    size_t row;
+    const Block& block = locate(i, row);
+    ImageHashes result;
+    result.perceptual = block.perceptual[row];
+    result.difference = block.difference[row];
+    return result;
+}
+
+const float* FeatureStoreReader::predictions(size_t i) const {
+    size_t row;
+    const Block& block = locate(i, row);
+    return block.predictions + row * labels_.size();
+}
+
+const float* FeatureStoreReader::texture(size_t i) const {
+    size_t row;
+    const Block& block = locate(i, row);
+    return block.texture + row * textureSize_;
+}
+
+cv::Mat FeatureStoreReader::mask(size_t i) const {
+    size_t row;
+    const Block& block = locate(i, row);
+    const int rows = block.maskSizes[2 * row];
+    const int cols = block.maskSizes[2 * row + 1];
+    if (rows <= 0 || cols <= 0) return cv::Mat();
+
+    cv::Mat mask(rows, cols, CV_8UC1);
+    uchar* pixels = mask.ptr<uchar>();
+    const size_t total = mask.total();
+    size_t filled = 0;
+    bool inside = false;
+    for (uint32_t r = block.runOffsets[row]; r < block.runOffsets[row + 1]; ++r) {
+        const size_t length = std::min<size_t>(block.runs[r], total - filled);
+        std::memset(pixels + filled, inside ? 255 : 0, length);
+        filled += length;
+        inside = !inside;
+    }
+    std::memset(pixels + filled, 0, total - filled);
+    return mask;
+}
+
+std::vector<cv::KeyPoint> FeatureStoreReader::keypoints(size_t i) const {
+    size_t row;
+    const Block& block = locate(i, row);
+    std::vector<cv::KeyPoint> result;
+    result.reserve(block.keypointOffsets[row + 1] - block.keypointOffsets[row]);
+    for (uint32_t k = block.keypointOffsets[row]; k < block.keypointOffsets[row + 1]; ++k) {
+        const StoredKeypoint& stored = block.keypoints[k];
+        result.emplace_back(stored.x, stored.y, stored.size, stored.angle, stored.response,
+                            stored.octave, stored.classId);
+    }
+    return result;
+}
+
+FeatureRecord FeatureStoreReader::record(size_t i) const {
+    FeatureRecord result;
+    result.imageId = std::string(imageId(i));
+    result.hashes = hashes(i);
+    const float* scores = predictions(i);
+    result.predictions.assign(scores, scores + labels_.size());
+    const float* features = texture(i);
+    result.texture.assign(features, features + textureSize_);
+    result.mask = mask(i);
+    result.keypoints = keypoints(i);
+    return result;
+}
+
+std::vector<size_t> FeatureStoreReader::find(uint64_t perceptualHash, int maxDistance) const {
+    std::call_once(indexed_, [this]() {
+        index_.reserve(size_);
+        for (const Block& block : blocks_) {
+            for (size_t row = 0; row < block.count; ++row) {
+                index_.add(block.perceptual[row]);
+            }
+        }
+        index_.build();
+    });
+
+    std::vector<size_t> records;
+    for (const DuplicateIndex::Match& match : index_.query(perceptualHash, maxDistance)) {
+        records.push_back(match.id);
+    }
+    return records;
+}
+
+} // namespace medical_vision
@@ -0,0 +1,250 @@
+/**
+ * @file frequency_filter.cpp
+ * @brief Implementation of DFT based linear filtering
+ */
+
+#include "../include/medical_vision/frequency_filter.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace medical_vision {
+
+namespace {
+
+// Sampled sizes kept per response, an image size rarely changes in a batch
+constexpr size_t MAX_SAMPLED_SIZES = 4;
+
+// Plans kept by the filter, least recently used ones go first
+constexpr size_t MAX_PLANS = 32;
+
+// Ballpark costs in nanoseconds, only their ratio matters: one tap of a
+// separable row or column filter per pixel (fixed point for 8-bit
+// images), one butterfly of a real DFT per element and level, and the
+// conversion, padding, product and crop around the transforms per element
+constexpr double TAP_COST_8U = 0.1;
+constexpr double TAP_COST = 0.25;
+constexpr double DFT_COST = 0.5;
+constexpr double FREQUENCY_OVERHEAD = 3.0;
+
+// Frequency in cycles per pixel of DFT bin k out of n
+double binFrequency(int k, int n) {
+    return (k <= n / 2 ? k : k - n) / static_cast<double>(n);
+}
+
+// Gain of a symmetric 1D kernel at frequency f
+double kernelGain(const std::vector<double>& kernel, double f) {
+    const int radius = static_cast<int>(kernel.size()) / 2;
+    double gain = kernel[radius];
+    for (int j = 1; j <= radius; ++j) {
+        gain += 2.0 * kernel[radius + j] * std::cos(2.0 * CV_PI * f * j);
+    }
+    return gain;
+}
+
+// Same default size as cv::GaussianBlur for a zero kernel size
+int gaussianKernelSize(int size, double sigma, int depth) {
+    if (size > 0) return size;
+    return std::max(1, cvRound(sigma * (depth == CV_8U ? 3 : 4) * 2 + 1) | 1);
+}
+
+std::vector<double> gaussianKernel(int size, double sigma) {
+    const cv::Mat kernel = cv::getGaussianKernel(size, sigma, CV_64F);
+    return std::vector<double>(kernel.ptr<double>(), kernel.ptr<double>() + kernel.total());
+}
+
+} // namespace
+
+// ---------- FrequencyResponse ----------
+
+FrequencyResponse::FrequencyResponse(Gain gain, int supportX, int supportY)
+    : gain_(std::move(gain)),
+      supportX_(std::max(supportX, 0)),
+      supportY_(std::max(supportY, 0)),
+      samples_(std::make_shared<Samples>()) {}
+
+FrequencyResponse FrequencyResponse::gaussian(cv::Size kernelSize, double sigmaX, double sigmaY, int depth) {
+    if (sigmaY <= 0.0) sigmaY = sigmaX;
+    const int sizeX = gaussianKernelSize(kernelSize.width, sigmaX, depth);
+    const int sizeY = gaussianKernelSize(kernelSize.height, sigmaY, depth);
+    if (sizeX % 2 == 0 || sizeY % 2 == 0) {
+        throw std::runtime_error("Gaussian kernel sizes must be odd");
+    }
+
+    // Transform of the separable kernel, truncation included
+    auto kernelX = gaussianKernel(sizeX, sigmaX);
+    auto kernelY = gaussianKernel(sizeY, sigmaY);
+    return FrequencyResponse(
+        [kernelX = std::move(kernelX), kernelY = std::move(kernelY)](double fx, double fy) {
+            return kernelGain(kernelX, fx) * kernelGain(kernelY, fy);
+        },
+        sizeX / 2, sizeY / 2);
+}
+
+FrequencyResponse FrequencyResponse::gaussian(double sigma) {
+    const double spread = 2.0 * CV_PI * CV_PI * sigma * sigma;
+    const int support = static_cast<int>(std::ceil(3.0 * sigma));
+    return FrequencyResponse([spread](double fx, double fy) { return std::exp(-spread * (fx * fx + fy * fy)); },
+                             support, support);
+}
+
+cv::Mat FrequencyResponse::sampled(const cv::Size& dftSize) const {
+    const auto key = std::make_pair(dftSize.width, dftSize.height);
+    std::lock_guard<std::mutex> lock(samples_->mutex);
+    auto found = samples_->bySize.find(key);
+    if (found != samples_->bySize.end()) return found->second;
+
+    // CCS layout of cv::dft for a real M x N input. Interior columns hold
+    // Re/Im pairs of horizontal bin (c + 1) / 2 over all vertical bins.
+    // Column 0, and column N - 1 for even N (horizontal bin N / 2), hold
+    // the real first row, then Re/Im pairs of vertical bins over rows,
+    // then the real vertical bin M / 2 for even M. The gains are real, so
+    // Re and Im get the same one.
+    const int rows = dftSize.height;
+    const int cols = dftSize.width;
+    cv::Mat gains(dftSize, CV_32F);
+
+    auto packedColumn = [&](int c, int horizontalBin) {
+        const double fx = binFrequency(horizontalBin, cols);
+        for (int r = 0; r < rows; ++r) {
+            int verticalBin;
+            if (r == 0) {
+                verticalBin = 0;
+            } else if (rows % 2 == 0 && r == rows - 1) {
+                verticalBin = rows / 2;
+            } else {
+                verticalBin = (r + 1) / 2;
+            }
+            gains.at<float>(r, c) = static_cast<float>(gain_(fx, binFrequency(verticalBin, rows)));
+        }
+    };
+
+    packedColumn(0, 0);
+    const int lastInterior = cols % 2 == 0 ? cols - 2 : cols - 1;
+    if (cols % 2 == 0 && cols > 1) {
+        packedColumn(cols - 1, cols / 2);
+    }
+    for (int r = 0; r < rows; ++r) {
+        const double fy = binFrequency(r, rows);
+        float* row = gains.ptr<float>(r);
+        for (int c = 1; c <= lastInterior; c += 2) {
+            const float gain = static_cast<float>(gain_(binFrequency((c + 1) / 2, cols), fy));
+            row[c] = gain;
+            row[c + 1] = gain;
+        }
+    }
+
+    if (samples_->order.size() >= MAX_SAMPLED_SIZES) {
+        samples_->bySize.erase(samples_->order.front());
+        samples_->order.erase(samples_->order.begin());
+    }
+    samples_->order.push_back(key);
+    samples_->bySize.emplace(key, gains);
+    return gains;
+}
+
+// ---------- FrequencyFilter ----------
+
+FrequencyFilter& FrequencyFilter::instance() {
+    static FrequencyFilter filter;
+    return filter;
+}
+
+FrequencyFilter::Plan FrequencyFilter::makePlan(const cv::Size& imageSize, int supportX, int supportY) {
+    // Margins of at least the support on every side, so the circular
+    // convolution only wraps around inside the padding
+    Plan plan;
+    plan.dftSize = cv::Size(cv::getOptimalDFTSize(imageSize.width + 2 * supportX),
+                            cv::getOptimalDFTSize(imageSize.height + 2 * supportY));
+    plan.left = supportX;
+    plan.right = plan.dftSize.width - imageSize.width - supportX;
+    plan.top = supportY;
+    plan.bottom = plan.dftSize.height - imageSize.height - supportY;
+    return plan;
+}
+
+FrequencyFilter::Plan FrequencyFilter::plan(const cv::Size& imageSize, int supportX, int supportY) {
+    const auto key = std::make_tuple(imageSize.width, imageSize.height, supportX, supportY);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = plans_.find(key);
+    if (found != plans_.end()) {
+        planOrder_.erase(std::find(planOrder_.begin(), planOrder_.end(), key));
+        planOrder_.push_back(key);
+        return found->second;
+    }
+
+    if (planOrder_.size() >= MAX_PLANS) {
+        plans_.erase(planOrder_.front());
+        planOrder_.erase(planOrder_.begin());
+    }
+    const Plan plan = makePlan(imageSize, supportX, supportY);
+    planOrder_.push_back(key);
+    plans_.emplace(key, plan);
+    return plan;
+}
+
+void FrequencyFilter::apply(const cv::Mat& image, cv::Mat& output, const FrequencyResponse& response,
+                            int borderType) {
+    if (image.empty()) {
+        throw std::runtime_error("Frequency filtering needs an image");
+    }
+    const int depth = image.depth();
+    if (depth != CV_8U && depth != CV_16U && depth != CV_32F) {
+        throw std::runtime_error("Frequency filtering needs an 8-bit, 16-bit or float image");
+    }
+
+    // Buffers stay allocated per thread between images
+    thread_local Spectrum spectrum;
+    if (image.channels() == 1) {
+        forward(image, spectrum, response.supportX(), response.supportY(), borderType);
+        inverse(spectrum, response, output, depth);
+        return;
+    }
+    std::vector<cv::Mat> planes;
+    cv::split(image, planes);
+    for (cv::Mat& channel : planes) {
+        forward(channel, spectrum, response.supportX(), response.supportY(), borderType);
+        inverse(spectrum, response, channel, depth);
+    }
+    cv::merge(planes, output);
+}
+
+void FrequencyFilter::forward(const cv::Mat& plane, Spectrum& spectrum, int supportX, int supportY,
+                              int borderType) {
+    if (plane.empty() || plane.channels() != 1) {
+        throw std::runtime_error("Frequency filtering transforms single channel images");
+    }
+    thread_local cv::Mat converted, padded;
+    spectrum.plan = plan(plane.size(), supportX, supportY);
+    spectrum.imageSize = plane.size();
+    const Plan& planned = spectrum.plan;
+    plane.convertTo(converted, CV_32F);
+    cv::copyMakeBorder(converted, padded, planned.top, planned.bottom, planned.left, planned.right, borderType);
+    cv::dft(padded, spectrum.data);
+}
+
+void FrequencyFilter::inverse(const Spectrum& spectrum, const FrequencyResponse& response, cv::Mat& output,
+                              int depth) {
+    thread_local cv::Mat product, filtered;
+    const Plan& planned = spectrum.plan;
+    cv::multiply(spectrum.data, response.sampled(planned.dftSize), product);
+    cv::dft(product, filtered, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+    filtered(cv::Rect(planned.left, planned.top, spectrum.imageSize.width, spectrum.imageSize.height))
+        .convertTo(output, depth);
+}
+
+double FrequencyFilter::spatialCost(const cv::Mat& image, cv::Size kernelSize) {
+    const double tap = image.depth() == CV_8U ? TAP_COST_8U : TAP_COST;
+    return static_cast<double>(image.total()) * image.channels() *
+           (kernelSize.width + kernelSize.height) * tap;
+}
+
+double FrequencyFilter::frequencyCost(const cv::Mat& image, cv::Size kernelSize) {
+    // Not cached, most images costed here end up on the spatial path
+    const Plan plan = makePlan(image.size(), kernelSize.width / 2, kernelSize.height / 2);
+    const double elements = static_cast<double>(plan.dftSize.area());
+    return image.channels() * elements * (2.0 * DFT_COST * std::log2(std::max(elements, 2.0)) + FREQUENCY_OVERHEAD);
+}
+
+} // namespace medical_vision
@@ -0,0 +1,73 @@
+/**
+ * @file gaussian_scale_space.cpp
+ * @brief Implementation of the shared Gaussian scale space
+ */
+
+#include "../include/medical_vision/gaussian_scale_space.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace medical_vision {
+
+void GaussianScaleSpace::prepare(const cv::Size& imageSize, const std::vector<double>& sigmas) {
+    if (imageSize == imageSize_ && sigmas == sigmas_) return;
+    if (sigmas.empty() || *std::min_element(sigmas.begin(), sigmas.end()) <= 0.0) {
+        throw std::runtime_error("Scale space sigmas must be positive");
+    }
+    imageSize_ = imageSize;
+    sigmas_ = sigmas;
+
+    const double smallest = *std::min_element(sigmas.begin(), sigmas.end());
+    const double scale = std::min(1.0, std::max(minWorkSigma_, 0.5) / smallest);
+    workSize_ = cv::Size(std::max(1, cvRound(imageSize.width * scale)),
+                         std::max(1, cvRound(imageSize.height * scale)));
+
+    // Padding beyond the image size adds cost but little accuracy: the
+    // reflected image already averages out at such sigmas
+    const double largest = *std::max_element(sigmas.begin(), sigmas.end()) * scale;
+    support_ = std::min(static_cast<int>(std::ceil(3.0 * largest)), std::max(workSize_.width, workSize_.height));
+
+    responses_.clear();
+    const cv::Size dftSize = FrequencyFilter::instance().plan(workSize_, support_, support_).dftSize;
+    for (double sigma : sigmas) {
+        responses_.push_back(FrequencyResponse::gaussian(sigma * scale));
+        responses_.back().sampled(dftSize);
+    }
+}
+
+void GaussianScaleSpace::compute(const cv::Mat& image, const std::vector<double>& sigmas) {
+    if (image.empty() || image.channels() != 1) {
+        throw std::runtime_error("Scale space needs a single channel image");
+    }
+    prepare(image.size(), sigmas);
+
+    if (workSize_ == image.size()) {
+        image.convertTo(work_, CV_32F);
+    } else {
+        // Area averaging first, in float so nothing is rounded twice
+        image.convertTo(work_, CV_32F);
+        cv::resize(work_, work_, workSize_, 0, 0, cv::INTER_AREA);
+    }
+
+    FrequencyFilter& filter = FrequencyFilter::instance();
+    filter.forward(work_, spectrum_, support_, support_);
+    levels_.resize(responses_.size());
+    for (size_t i = 0; i < responses_.size(); ++i) {
+        filter.inverse(spectrum_, responses_[i], levels_[i]);
+    }
+}
+
+void GaussianScaleSpace::level(size_t i, cv::Mat& output) const {
+    if (i >= levels_.size()) {
+        throw std::runtime_error("Scale space level out of range");
+    }
+    if (workSize_ == imageSize_) {
+        levels_[i].copyTo(output);
+    } else {
+        cv::resize(levels_[i], output, imageSize_, 0, 0, cv::INTER_LINEAR);
+    }
+}
+
+} // namespace medical_vision
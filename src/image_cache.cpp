@@ -0,0 +1,596 @@
+/**
+ * @file image_cache.cpp
+ * @brief Implementation of the cache image codec
+ */
+
+#include "../include/medical_vision/image_cache.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <stdexcept>
+#include <type_traits>
+
+namespace medical_vision {
+
+namespace {
+
+// File layout: header, stripe size table, stripes. Each stripe holds
+// stripeRows rows and starts with its StripeEncoding.
+// Values are written in host byte order.
+const char CACHE_MAGIC[4] = {'M', 'V', 'I', 'C'};
+constexpr uint32_t CACHE_VERSION = 1;
+
+// Stripes of about this many raw bytes are encoded in parallel
+constexpr size_t STRIPE_BYTES = 256 * 1024;
+
+constexpr int MAX_CODE_LENGTH = 12;
+constexpr size_t LENGTH_TABLE_SIZE = 128;   // 256 code lengths as nibbles
+
+enum class StripeEncoding : uint8_t {
+    RAW = 0,
+    DELTA_HUFFMAN = 1,
+    RLE = 2
+};
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+    uint32_t stripeRows;
+    uint32_t stripeCount;
+};
+
+[[noreturn]] void corrupted() {
+    throw std::runtime_error("Corrupted cache image");
+}
+
+template <typename T>
+void appendValue(std::vector<uchar>& out, T value) {
+    const auto* bytes = reinterpret_cast<const uchar*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Bounds checked reader over an encoded buffer
+class Reader {
+public:
+    Reader(const uchar* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T read() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    const uchar* take(size_t count) {
+        if (count > size_ - position_) corrupted();
+        const uchar* p = data_ + position_;
+        position_ += count;
+        return p;
+    }
+
+    size_t readVarint() {
+        size_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uchar byte = read<uchar>();
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        corrupted();
+    }
+
+private:
+    const uchar* data_;
+    size_t size_;
+    size_t position_{0};
+};
+
+void appendVarint(std::vector<uchar>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uchar>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uchar>(value));
+}
+
+// ---------- Huffman coding of byte planes ----------
+
+using CodeLengths = std::array<uint8_t, 256>;
+
+CodeLengths buildCodeLengths(std::array<uint64_t, 256> frequencies) {
+    CodeLengths lengths{};
+    while (true) {
+        lengths.fill(0);
+
+        std::vector<uint64_t> weights;
+        std::vector<int> parents;
+        std::vector<int> symbols;
+        using Node = std::pair<uint64_t, int>;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+        for (int s = 0; s < 256; ++s) {
+            if (frequencies[s] == 0) continue;
+            heap.push({frequencies[s], static_cast<int>(weights.size())});
+            weights.push_back(frequencies[s]);
+            parents.push_back(-1);
+            symbols.push_back(s);
+        }
+        if (symbols.empty()) return lengths;
+        if (symbols.size() == 1) {
+            lengths[symbols[0]] = 1;
+            return lengths;
+        }
+
+        while (heap.size() > 1) {
+            Node a = heap.top(); heap.pop();
+            Node b = heap.top(); heap.pop();
+            int node = static_cast<int>(weights.size());
+            weights.push_back(a.first + b.first);
+            parents.push_back(-1);
+            parents[a.second] = node;
+            parents[b.second] = node;
+            heap.push({a.first + b.first, node});
+        }
+
+        int maxLength = 0;
+        for (size_t leaf = 0; leaf < symbols.size(); ++leaf) {
+            int depth = 0;
+            for (int n = static_cast<int>(leaf); parents[n] != -1; n = parents[n]) ++depth;
+            lengths[symbols[leaf]] = static_cast<uint8_t>(depth);
+            maxLength = std::max(maxLength, depth);
+        }
+        if (maxLength <= MAX_CODE_LENGTH) return lengths;
+
+        // Flatten the distribution until the tree fits the decode table
+        for (auto& f : frequencies) {
+            if (f > 0) f = (f + 1) / 2;
+        }
+    }
+}
+
+// Canonical codes, bit reversed for LSB-first streams
+std::array<uint32_t, 256> buildCodes(const CodeLengths& lengths) {
+    int lengthCount[MAX_CODE_LENGTH + 1] = {};
+    for (uint8_t length : lengths) lengthCount[length]++;
+    lengthCount[0] = 0;
+
+    uint32_t nextCode[MAX_CODE_LENGTH + 1] = {};
+    uint32_t code = 0;
+    for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+        code = (code + lengthCount[length - 1]) << 1;
+        nextCode[length] = code;
+    }
+
+    std::array<uint32_t, 256> codes{};
+    for (int s = 0; s < 256; ++s) {
+        int length = lengths[s];
+        if (length == 0) continue;
+        uint32_t canonical = nextCode[length]++;
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) {
+            reversed |= ((canonical >> i) & 1u) << (length - 1 - i);
+        }
+        codes[s] = reversed;
+    }
+    return codes;
+}
+
+// Block: symbol count, nibble packed code lengths, bitstream size, bitstream
+void huffmanEncode(const std::vector<uchar>& symbols, std::vector<uchar>& out) {
+    appendValue<uint32_t>(out, static_cast<uint32_t>(symbols.size()));
+    if (symbols.empty()) return;
+
+    std::array<uint64_t, 256> frequencies{};
+    for (uchar s : symbols) frequencies[s]++;
+    const CodeLengths lengths = buildCodeLengths(frequencies);
+    const auto codes = buildCodes(lengths);
+
+    for (size_t i = 0; i < LENGTH_TABLE_SIZE; ++i) {
+        out.push_back(static_cast<uchar>(lengths[2 * i] | (lengths[2 * i + 1] << 4)));
+    }
+
+    size_t sizeOffset = out.size();
+    appendValue<uint32_t>(out, 0);
+    size_t streamBegin = out.size();
+
+    uint64_t buffer = 0;
+    int bitCount = 0;
+    for (uchar s : symbols) {
+        buffer |= static_cast<uint64_t>(codes[s]) << bitCount;
+        bitCount += lengths[s];
+        if (bitCount >= 32) {
+            appendValue<uint32_t>(out, static_cast<uint32_t>(buffer));
+            buffer >>= 32;
+            bitCount -= 32;
+        }
+    }
+    while (bitCount > 0) {
+        out.push_back(static_cast<uchar>(buffer));
+        buffer >>= 8;
+        bitCount -= 8;
+    }
+
+    uint32_t streamSize = static_cast<uint32_t>(out.size() - streamBegin);
+    std::memcpy(out.data() + sizeOffset, &streamSize, sizeof(streamSize));
+}
+
+void huffmanDecode(Reader& reader, std::vector<uchar>& symbols, size_t expectedCount) {
+    uint32_t count = reader.read<uint32_t>();
+    if (count != expectedCount) corrupted();
+    symbols.resize(count);
+    if (count == 0) return;
+
+    CodeLengths lengths{};
+    const uchar* packed = reader.take(LENGTH_TABLE_SIZE);
+    for (size_t i = 0; i < LENGTH_TABLE_SIZE; ++i) {
+        lengths[2 * i] = packed[i] & 0x0F;
+        lengths[2 * i + 1] = packed[i] >> 4;
+    }
+
+    // Over-subscribed lengths would make table entries collide
+    uint32_t kraft = 0;
+    for (uint8_t length : lengths) {
+        if (length > MAX_CODE_LENGTH) corrupted();
+        if (length > 0) kraft += 1u << (MAX_CODE_LENGTH - length);
+    }
+    if (kraft == 0 || kraft > (1u << MAX_CODE_LENGTH)) corrupted();
+
+    // Entry: symbol in the low byte, code length above, 0 for unused codes
+    const auto codes = buildCodes(lengths);
+    std::vector<uint16_t> table(1u << MAX_CODE_LENGTH, 0);
+    for (int s = 0; s < 256; ++s) {
+        int length = lengths[s];
+        if (length == 0) continue;
+        for (uint32_t fill = codes[s]; fill < table.size(); fill += 1u << length) {
+            table[fill] = static_cast<uint16_t>(s | (length << 8));
+        }
+    }
+
+    uint32_t streamSize = reader.read<uint32_t>();
+    const uchar* in = reader.take(streamSize);
+    const uchar* end = in + streamSize;
+
+    uint64_t buffer = 0;
+    int bitCount = 0;
+    const uint32_t mask = (1u << MAX_CODE_LENGTH) - 1;
+    for (uint32_t i = 0; i < count; ++i) {
+        while (bitCount <= 56) {
+            buffer |= static_cast<uint64_t>(in < end ? *in++ : 0) << bitCount;
+            bitCount += 8;
+        }
+        uint16_t entry = table[buffer & mask];
+        int length = entry >> 8;
+        if (length == 0) corrupted();
+        symbols[i] = static_cast<uchar>(entry);
+        buffer >>= length;
+        bitCount -= length;
+    }
+}
+
+// ---------- Delta prediction ----------
+
+// LOCO-I median edge detector, left only on the first row of a stripe
+template <typename T>
+inline int predict(const T* row, const T* up, int x, int cn) {
+    if (!up) return x >= cn ? row[x - cn] : 0;
+    if (x < cn) return up[x];
+    int a = row[x - cn];
+    int b = up[x];
+    int c = up[x - cn];
+    if (c >= std::max(a, b)) return std::min(a, b);
+    if (c <= std::min(a, b)) return std::max(a, b);
+    return a + b - c;
+}
+
+// Small residuals of either sign map to small codes
+template <typename T>
+inline T zigzag(T residual) {
+    int value = static_cast<std::make_signed_t<T>>(residual);
+    return static_cast<T>((static_cast<unsigned>(value) << 1) ^ static_cast<unsigned>(value >> 31));
+}
+
+template <typename T>
+inline T unzigzag(unsigned code) {
+    return static_cast<T>((code >> 1) ^ (0u - (code & 1u)));
+}
+
+template <typename T>
+void deltaEncode(const cv::Mat& image, int rowBegin, int rowEnd, std::vector<uchar>& out) {
+    const int cn = image.channels();
+    const int width = image.cols * cn;
+    const size_t count = static_cast<size_t>(rowEnd - rowBegin) * width;
+
+    // One byte plane per byte of the residual, least significant first
+    std::vector<std::vector<uchar>> planes(sizeof(T), std::vector<uchar>(count));
+    size_t i = 0;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const T* row = image.ptr<T>(y);
+        const T* up = y > rowBegin ? image.ptr<T>(y - 1) : nullptr;
+        for (int x = 0; x < width; ++x, ++i) {
+            T code = zigzag(static_cast<T>(row[x] - predict(row, up, x, cn)));
+            for (size_t k = 0; k < sizeof(T); ++k) {
+                planes[k][i] = static_cast<uchar>(code >> (8 * k));
+            }
+        }
+    }
+
+    for (const auto& plane : planes) {
+        huffmanEncode(plane, out);
+    }
+}
+
+template <typename T>
+void deltaDecode(Reader& reader, cv::Mat& image, int rowBegin, int rowEnd) {
+    const int cn = image.channels();
+    const int width = image.cols * cn;
+    const size_t count = static_cast<size_t>(rowEnd - rowBegin) * width;
+
+    std::vector<std::vector<uchar>> planes(sizeof(T));
+    for (auto& plane : planes) {
+        huffmanDecode(reader, plane, count);
+    }
+
+    size_t i = 0;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        T* row = image.ptr<T>(y);
+        const T* up = y > rowBegin ? image.ptr<T>(y - 1) : nullptr;
+        for (int x = 0; x < width; ++x, ++i) {
+            unsigned code = 0;
+            for (size_t k = 0; k < sizeof(T); ++k) {
+                code |= static_cast<unsigned>(planes[k][i]) << (8 * k);
+            }
+            row[x] = static_cast<T>(predict(row, up, x, cn) + unzigzag<T>(code));
+        }
+    }
+}
+
+// ---------- Run-length coding of masks ----------
+
+// Runs continue across rows, a mask stripe is usually a handful of runs
+size_t countRuns(const cv::Mat& image, int rowBegin, int rowEnd) {
+    size_t runs = 1;
+    uchar previous = image.ptr<uchar>(rowBegin)[0];
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const uchar* row = image.ptr<uchar>(y);
+        for (int x = 0; x < image.cols; ++x) {
+            if (row[x] != previous) {
+                ++runs;
+                previous = row[x];
+            }
+        }
+    }
+    return runs;
+}
+
+void rleEncode(const cv::Mat& image, int rowBegin, int rowEnd, std::vector<uchar>& out) {
+    uchar value = image.ptr<uchar>(rowBegin)[0];
+    size_t length = 0;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const uchar* row = image.ptr<uchar>(y);
+        for (int x = 0; x < image.cols; ++x) {
+            if (row[x] != value) {
+                out.push_back(value);
+                appendVarint(out, length);
+                value = row[x];
+                length = 0;
+            }
+            ++length;
+        }
+    }
+    out.push_back(value);
+    appendVarint(out, length);
+}
+
+void rleDecode(Reader& reader, cv::Mat& image, int rowBegin, int rowEnd) {
+    int y = rowBegin;
+    int x = 0;
+    while (y < rowEnd) {
+        uchar value = reader.read<uchar>();
+        size_t length = reader.readVarint();
+        while (length > 0) {
+            if (y >= rowEnd) corrupted();
+            size_t span = std::min<size_t>(length, image.cols - x);
+            std::memset(image.ptr<uchar>(y) + x, value, span);
+            length -= span;
+            x += static_cast<int>(span);
+            if (x == image.cols) {
+                x = 0;
+                ++y;
+            }
+        }
+    }
+}
+
+// ---------- Stripes ----------
+
+std::vector<uchar> encodeStripe(const cv::Mat& image, int rowBegin, int rowEnd,
+                                CacheCompression compression) {
+    const size_t rowBytes = image.cols * image.elemSize();
+    const size_t rawSize = (rowEnd - rowBegin) * rowBytes;
+    const bool isMask = image.type() == CV_8UC1;
+    const bool canDelta = image.depth() == CV_8U || image.depth() == CV_16U;
+
+    bool useRle = false;
+    if (compression == CacheCompression::MASK_RLE) {
+        useRle = isMask;
+    } else if (compression == CacheCompression::AUTO && isMask) {
+        // Each run costs two bytes or more, delta coding a byte at least one bit
+        useRle = countRuns(image, rowBegin, rowEnd) * 2 < rawSize / 8;
+    }
+
+    std::vector<uchar> out;
+    if (useRle) {
+        out.push_back(static_cast<uchar>(StripeEncoding::RLE));
+        rleEncode(image, rowBegin, rowEnd, out);
+    } else if (canDelta) {
+        out.push_back(static_cast<uchar>(StripeEncoding::DELTA_HUFFMAN));
+        if (image.depth() == CV_8U) {
+            deltaEncode<uint8_t>(image, rowBegin, rowEnd, out);
+        } else {
+            deltaEncode<uint16_t>(image, rowBegin, rowEnd, out);
+        }
+    }
+
+    // Incompressible stripes are kept as they are
+    if (out.empty() || out.size() > rawSize) {
+        out.clear();
+        out.reserve(rawSize + 1);
+        out.push_back(static_cast<uchar>(StripeEncoding::RAW));
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            const uchar* row = image.ptr<uchar>(y);
+            out.insert(out.end(), row, row + rowBytes);
+        }
+    }
+    return out;
+}
+
+void decodeStripe(const uchar* data, size_t size, cv::Mat& image, int rowBegin, int rowEnd) {
+    Reader reader(data, size);
+    const size_t rowBytes = image.cols * image.elemSize();
+
+    switch (static_cast<StripeEncoding>(reader.read<uchar>())) {
+        case StripeEncoding::RAW:
+            for (int y = rowBegin; y < rowEnd; ++y) {
+                std::memcpy(image.ptr<uchar>(y), reader.take(rowBytes), rowBytes);
+            }
+            break;
+        case StripeEncoding::DELTA_HUFFMAN:
+            if (image.depth() == CV_8U) {
+                deltaDecode<uint8_t>(reader, image, rowBegin, rowEnd);
+            } else if (image.depth() == CV_16U) {
+                deltaDecode<uint16_t>(reader, image, rowBegin, rowEnd);
+            } else {
+                corrupted();
+            }
+            break;
+        case StripeEncoding::RLE:
+            if (image.type() != CV_8UC1) corrupted();
+            rleDecode(reader, image, rowBegin, rowEnd);
+            break;
+        default:
+            corrupted();
+    }
+}
+
+} // namespace
+
+// ---------- Public interface ----------
+
+std::vector<uchar> encodeCacheImage(const cv::Mat& image, CacheCompression compression) {
+    if (image.empty() || image.dims != 2) {
+        throw std::invalid_argument("Cache images must be non-empty 2D matrices");
+    }
+
+    const size_t rowBytes = image.cols * image.elemSize();
+    const int stripeRows = static_cast<int>(std::max<size_t>(1, STRIPE_BYTES / rowBytes));
+    const int stripeCount = (image.rows + stripeRows - 1) / stripeRows;
+
+    std::vector<std::vector<uchar>> stripes(stripeCount);
+    cv::parallel_for_(cv::Range(0, stripeCount), [&](const cv::Range& range) {
+        for (int s = range.start; s < range.end; ++s) {
+            int rowBegin = s * stripeRows;
+            int rowEnd = std::min(image.rows, rowBegin + stripeRows);
+            stripes[s] = encodeStripe(image, rowBegin, rowEnd, compression);
+        }
+    });
+
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.rows = image.rows;
+    header.cols = image.cols;
+    header.type = image.type();
+    header.stripeRows = static_cast<uint32_t>(stripeRows);
+    header.stripeCount = static_cast<uint32_t>(stripeCount);
+
+    size_t total = sizeof(header) + stripeCount * sizeof(uint32_t);
+    for (const auto& stripe : stripes) total += stripe.size();
+
+    std::vector<uchar> out;
+    out.reserve(total);
+    appendValue(out, header);
+    for (const auto& stripe : stripes) {
+        appendValue<uint32_t>(out, static_cast<uint32_t>(stripe.size()));
+    }
+    for (const auto& stripe : stripes) {
+        out.insert(out.end(), stripe.begin(), stripe.end());
+    }
+    return out;
+}
+
+cv::Mat decodeCacheImage(const uchar* data, size_t size) {
+    Reader reader(data, size);
+    CacheHeader header = reader.read<CacheHeader>();
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+        throw std::runtime_error("Not a cache image");
+    }
+    if (header.version != CACHE_VERSION) {
+        throw std::runtime_error("Unsupported cache image version");
+    }
+    if (header.rows <= 0 || header.cols <= 0 || header.stripeRows == 0 ||
+        header.stripeCount != (static_cast<uint32_t>(header.rows) + header.stripeRows - 1) / header.stripeRows) {
+        corrupted();
+    }
+
+    // Stripe offsets from the size table
+    std::vector<size_t> offsets(header.stripeCount + 1, 0);
+    std::vector<uint32_t> sizes(header.stripeCount);
+    for (uint32_t s = 0; s < header.stripeCount; ++s) {
+        sizes[s] = reader.read<uint32_t>();
+    }
+    const uchar* stripeData = reader.take(0);
+    for (uint32_t s = 0; s < header.stripeCount; ++s) {
+        offsets[s + 1] = offsets[s] + sizes[s];
+    }
+    reader.take(offsets.back());
+
+    cv::Mat image(header.rows, header.cols, header.type);
+    const int stripeRows = static_cast<int>(header.stripeRows);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(header.stripeCount)), [&](const cv::Range& range) {
+        for (int s = range.start; s < range.end; ++s) {
+            int rowBegin = s * stripeRows;
+            int rowEnd = std::min(image.rows, rowBegin + stripeRows);
+            decodeStripe(stripeData + offsets[s], sizes[s], image, rowBegin, rowEnd);
+        }
+    });
+    return image;
+}
+
+bool writeCacheImage(const std::string& filepath, const cv::Mat& image,
+                     CacheCompression compression) {
+    std::vector<uchar> encoded = encodeCacheImage(image, compression);
+    std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    return static_cast<bool>(out);
+}
+
+cv::Mat readCacheImage(const std::string& filepath) {
+    std::ifstream in(filepath, std::ios::binary);
+    if (!in) return cv::Mat();
+
+    std::vector<uchar> data((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+    try {
+        return decodeCacheImage(data.data(), data.size());
+    }
+    catch (const std::exception&) {
+        return cv::Mat();
+    }
+}
+
+bool isCacheImagePath(const std::string& filepath) {
+    const std::string extension = CACHE_IMAGE_EXTENSION;
+    if (filepath.size() < extension.size()) return false;
+    std::string suffix = filepath.substr(filepath.size() - extension.size());
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return suffix == extension;
+}
+
+} // namespace medical_vision
@@ -4,10 +4,18 @@
  */
 
 #include "../include/medical_vision/image_preprocessor.hpp"
+#include "../include/medical_vision/image_cache.hpp"
+#include "../include/medical_vision/segmentation.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/photo.hpp>
+#include <mutex>
 #include <stdexcept>
 
 namespace medical_vision {
@@ -15,7 +23,29 @@ namespace medical_vision {
 // ---------- Basic Operations ----------
 
 bool ImagePreprocessor::loadImage(const std::string& filepath) {
-    image_ = cv::imread(filepath, cv::IMREAD_UNCHANGED);
+    // DICOM pixels stay 16-bit in the mapped file, the working image
+    // is the windowed 8-bit view of them
+    dicom_.reset();
+    region_ = cv::Rect();
+    crop_ = cv::Rect();
+    if (DicomImage::isDicomFile(filepath)) {
+        dicom_ = std::make_unique<DicomImage>();
+        try {
+            dicom_->open(filepath);
+            image_ = dicom_->window();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "DICOM error: " << e.what() << std::endl;
+            dicom_.reset();
+            image_.release();
+            return false;
+        }
+        updateOriginalImage();
+        return true;
+    }
+
+    image_ = isCacheImagePath(filepath) ? readCacheImage(filepath)
+                                        : cv::imread(filepath, cv::IMREAD_UNCHANGED);
     if (image_.empty()) {
         return false;
     }
@@ -23,8 +53,21 @@ bool ImagePreprocessor::loadImage(const std::string& filepath) {
     return true;
 }
 
+bool ImagePreprocessor::setWindow(double center, double width) {
+    if (!dicom_ || width <= 0.0) return false;
+    image_ = dicom_->window(center, width);
+    if (!crop_.empty()) {
+        image_ = image_(crop_);
+    }
+    updateOriginalImage();
+    return true;
+}
+
 bool ImagePreprocessor::saveImage(const std::string& filepath) const {
     if (!checkImageLoaded()) return false;
+    if (isCacheImagePath(filepath)) {
+        return writeCacheImage(filepath, image_);
+    }
     return cv::imwrite(filepath, image_);
 }
 
@@ -74,36 +117,28 @@ bool ImagePreprocessor::denoise(NoiseReductionMethod method) {
                 return medianBlur();
             
             case NoiseReductionMethod::BILATERAL: {
-                cv::Mat temp;
                 if (image_.type() != CV_8UC1 && image_.type() != CV_8UC3) {
-                    image_.convertTo(temp, CV_8U);
-                } else {
-                    temp = image_.clone();
-                }
-
-                if (temp.channels() == 1) {
-                    cv::bilateralFilter(temp, image_, 9, 75, 75);
-                } else {
-                    cv::Mat result;
-                    cv::bilateralFilter(temp, result, 9, 75, 75);
-                    result.copyTo(image_);
+                    image_.convertTo(image_, CV_8U);
                 }
+                applyInRegion([](cv::Mat& image) {
+                    cv::Mat temp = image.clone();
+                    cv::bilateralFilter(temp, image, 9, 75, 75);
+                });
                 return true;
             }
             
             case NoiseReductionMethod::NLM: {
-                cv::Mat temp;
                 if (image_.type() != CV_8UC1 && image_.type() != CV_8UC3) {
-                    image_.convertTo(temp, CV_8U);
-                } else {
-                    temp = image_.clone();
-                }
-
-                if (temp.channels() == 1) {
-                    cv::fastNlMeansDenoising(temp, image_);
-                } else {
-                    cv::fastNlMeansDenoisingColored(temp, image_);
+                    image_.convertTo(image_, CV_8U);
                 }
+                applyInRegion([](cv::Mat& image) {
+                    cv::Mat temp = image.clone();
+                    if (temp.channels() == 1) {
+                        cv::fastNlMeansDenoising(temp, image);
+                    } else {
+                        cv::fastNlMeansDenoisingColored(temp, image);
+                    }
+                });
                 return true;
             }
             
@@ -120,28 +155,38 @@ bool ImagePreprocessor::denoise(NoiseReductionMethod method) {
 bool ImagePreprocessor::gaussianBlur(int kernelSize, double sigma) {
     if (!checkImageLoaded() || !validateKernelSize(kernelSize)) return false;
     
-    cv::GaussianBlur(image_, image_, cv::Size(kernelSize, kernelSize), sigma);
+    applyInRegion([&](cv::Mat& image) {
+        gaussianFilter(image, image, cv::Size(kernelSize, kernelSize), sigma);
+    });
     return true;
 }
 
 bool ImagePreprocessor::medianBlur(int kernelSize) {
     if (!checkImageLoaded() || !validateKernelSize(kernelSize)) return false;
     
-    cv::medianBlur(image_, image_, kernelSize);
+    applyInRegion([&](cv::Mat& image) {
+        cv::medianBlur(image, image, kernelSize);
+    });
     return true;
 }
 
 bool ImagePreprocessor::bilateralFilter(int diameter, double sigmaColor, double sigmaSpace) {
     if (!checkImageLoaded()) return false;
     
-    cv::bilateralFilter(image_, image_, diameter, sigmaColor, sigmaSpace);
+    applyInRegion([&](cv::Mat& image) {
+        cv::Mat temp = image.clone();
+        cv::bilateralFilter(temp, image, diameter, sigmaColor, sigmaSpace);
+    });
     return true;
 }
 
 bool ImagePreprocessor::nonLocalMeans(float h, int templateWindowSize, int searchWindowSize) {
     if (!checkImageLoaded()) return false;
     
-    cv::fastNlMeansDenoising(image_, image_, h, templateWindowSize, searchWindowSize);
+    applyInRegion([&](cv::Mat& image) {
+        cv::Mat temp = image.clone();
+        cv::fastNlMeansDenoising(temp, image, h, templateWindowSize, searchWindowSize);
+    });
     return true;
 }
 
@@ -167,36 +212,44 @@ bool ImagePreprocessor::histogramProcessing(HistogramMethod method) {
 
     switch (method) {
         case HistogramMethod::EQUALIZATION: {
-            if (image_.channels() == 1) {
-                cv::equalizeHist(image_, image_);
-            } else {
-                cv::Mat ycrcb;
-                cv::cvtColor(image_, ycrcb, cv::COLOR_BGR2YCrCb);
-                std::vector<cv::Mat> channels;
-                cv::split(ycrcb, channels);
-                cv::equalizeHist(channels[0], channels[0]);
-                cv::merge(channels, ycrcb);
-                cv::cvtColor(ycrcb, image_, cv::COLOR_YCrCb2BGR);
-            }
+            applyInRegion([](cv::Mat& image) {
+                if (image.channels() == 1) {
+                    cv::equalizeHist(image, image);
+                } else {
+                    cv::Mat ycrcb;
+                    cv::cvtColor(image, ycrcb, cv::COLOR_BGR2YCrCb);
+                    std::vector<cv::Mat> channels;
+                    cv::split(ycrcb, channels);
+                    cv::equalizeHist(channels[0], channels[0]);
+                    cv::merge(channels, ycrcb);
+                    cv::cvtColor(ycrcb, image, cv::COLOR_YCrCb2BGR);
+                }
+            });
             return true;
         }
         case HistogramMethod::CLAHE:
             return clahe();
+        case HistogramMethod::HOMOMORPHIC:
+            return homomorphicFilter();
+        case HistogramMethod::RETINEX:
+            return multiScaleRetinex();
         case HistogramMethod::STRETCHING: {
-            if (image_.channels() == 1) {
-                double minVal, maxVal;
-                cv::minMaxLoc(image_, &minVal, &maxVal);
-                image_.convertTo(image_, -1, 255.0/(maxVal - minVal), -minVal * 255.0/(maxVal - minVal));
-            } else {
-                std::vector<cv::Mat> channels;
-                cv::split(image_, channels);
-                for (auto& channel : channels) {
+            applyInRegion([](cv::Mat& image) {
+                if (image.channels() == 1) {
                     double minVal, maxVal;
-                    cv::minMaxLoc(channel, &minVal, &maxVal);
-                    channel.convertTo(channel, -1, 255.0/(maxVal - minVal), -minVal * 255.0/(maxVal - minVal));
+                    cv::minMaxLoc(image, &minVal, &maxVal);
+                    image.convertTo(image, -1, 255.0/(maxVal - minVal), -minVal * 255.0/(maxVal - minVal));
+                } else {
+                    std::vector<cv::Mat> channels;
+                    cv::split(image, channels);
+                    for (auto& channel : channels) {
+                        double minVal, maxVal;
+                        cv::minMaxLoc(channel, &minVal, &maxVal);
+                        channel.convertTo(channel, -1, 255.0/(maxVal - minVal), -minVal * 255.0/(maxVal - minVal));
+                    }
+                    cv::merge(channels, image);
                 }
-                cv::merge(channels, image_);
-            }
+            });
             return true;
         }
         default:
@@ -209,16 +262,172 @@ bool ImagePreprocessor::clahe(double clipLimit, cv::Size tileGridSize) {
 
     cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(clipLimit, tileGridSize);
     
-    if (image_.channels() == 1) {
-        clahe->apply(image_, image_);
-    } else {
-        cv::Mat lab;
-        cv::cvtColor(image_, lab, cv::COLOR_BGR2Lab);
-        std::vector<cv::Mat> channels;
-        cv::split(lab, channels);
-        clahe->apply(channels[0], channels[0]);
-        cv::merge(channels, lab);
-        cv::cvtColor(lab, image_, cv::COLOR_Lab2BGR);
+    applyInRegion([&clahe](cv::Mat& image) {
+        if (image.channels() == 1) {
+            clahe->apply(image, image);
+        } else {
+            cv::Mat lab;
+            cv::cvtColor(image, lab, cv::COLOR_BGR2Lab);
+            std::vector<cv::Mat> channels;
+            cv::split(lab, channels);
+            clahe->apply(channels[0], channels[0]);
+            cv::merge(channels, lab);
+            cv::cvtColor(lab, image, cv::COLOR_Lab2BGR);
+        }
+    });
+    return true;
+}
+
+// ---------- Exposure Equalization ----------
+
+namespace {
+
+// Intensities in 8-bit units, so the log offset of 1 means the same
+// everywhere; float images are taken as 0-1
+double intensityScale(int depth) {
+    switch (depth) {
+        case CV_8U: return 1.0;
+        case CV_16U: return 1.0 / 257.0;
+        case CV_32F: return 255.0;
+        default: throw std::runtime_error("Exposure equalization needs an 8-bit, 16-bit or float image");
+    }
+}
+
+// Full range of a depth, float images are taken as 0-1
+double depthRange(int depth) {
+    return depth == CV_8U ? 255.0 : depth == CV_16U ? 65535.0 : 1.0;
+}
+
+// Map the 0.5th to 99.5th percentiles of a float result onto the full
+// range of the plane it replaces
+void stretchInto(const cv::Mat& values, cv::Mat& plane) {
+    // Range of the finite values, NaN and infinities are left out
+    double minVal = std::numeric_limits<double>::max();
+    double maxVal = std::numeric_limits<double>::lowest();
+    for (int y = 0; y < values.rows; ++y) {
+        const float* row = values.ptr<float>(y);
+        for (int x = 0; x < values.cols; ++x) {
+            if (std::isfinite(row[x])) {
+                minVal = std::min(minVal, static_cast<double>(row[x]));
+                maxVal = std::max(maxVal, static_cast<double>(row[x]));
+            }
+        }
+    }
+    if (maxVal <= minVal) {
+        values.convertTo(plane, plane.depth(), 0.0, 0.0);
+        return;
+    }
+
+    constexpr int BINS = 1024;
+    std::vector<int64_t> histogram(BINS, 0);
+    const double binScale = (BINS - 1) / (maxVal - minVal);
+    for (int y = 0; y < values.rows; ++y) {
+        const float* row = values.ptr<float>(y);
+        for (int x = 0; x < values.cols; ++x) {
+            if (std::isfinite(row[x])) {
+                ++histogram[std::clamp(static_cast<int>((row[x] - minVal) * binScale), 0, BINS - 1)];
+            }
+        }
+    }
+    const int64_t clipped = static_cast<int64_t>(0.005 * values.total());
+    int low = 0, high = BINS - 1;
+    for (int64_t count = 0; low < BINS - 1 && count + histogram[low] <= clipped; ++low) count += histogram[low];
+    for (int64_t count = 0; high > low && count + histogram[high] <= clipped; --high) count += histogram[high];
+
+    const double from = minVal + low / binScale;
+    const double to = std::max(minVal + high / binScale, from + 1e-6);
+    const double range = depthRange(plane.depth());
+    values.convertTo(plane, plane.depth(), range / (to - from), -from * range / (to - from));
+}
+
+// Single channel images directly, color ones on their lightness. Color
+// goes through float Lab whatever the depth (there is no 16-bit Lab), and
+// the operation gets L as a 0-1 float plane like a float gray image.
+void applyToLightness(cv::Mat& image, const std::function<void(cv::Mat&)>& operation) {
+    if (image.channels() == 1) {
+        operation(image);
+        return;
+    }
+    const int depth = image.depth();
+    intensityScale(depth);              // Rejects other depths
+    const double range = depthRange(depth);
+    cv::Mat lab;
+    image.convertTo(lab, CV_32F, 1.0 / range);
+    cv::cvtColor(lab, lab, cv::COLOR_BGR2Lab);
+    std::vector<cv::Mat> channels;
+    cv::split(lab, channels);
+    channels[0] *= 1.0 / 100.0;
+    operation(channels[0]);
+    channels[0] *= 100.0;
+    cv::merge(channels, lab);
+    cv::cvtColor(lab, lab, cv::COLOR_Lab2BGR);
+    lab.convertTo(image, depth, range);
+}
+
+} // namespace
+
+bool ImagePreprocessor::homomorphicFilter(double sigma, double lowGain, double highGain) {
+    if (!checkImageLoaded()) return false;
+
+    try {
+        applyInRegion([&](cv::Mat& image) {
+            applyToLightness(image, [&](cv::Mat& plane) {
+                const double pixels = sigma * std::max(plane.rows, plane.cols);
+                cv::Mat logImage, illumination;
+                plane.convertTo(logImage, CV_32F, intensityScale(plane.depth()), 1.0);
+                // Float images may go below 0, keep the log finite
+                cv::max(logImage, 1.0, logImage);
+                cv::log(logImage, logImage);
+
+                // Illumination is the blurred log image; scaling it down
+                // flattens the exposure, scaling the rest up keeps detail
+                scaleSpace_.compute(logImage, {pixels});
+                scaleSpace_.level(0, illumination);
+                cv::Mat result = highGain * logImage + (lowGain - highGain) * illumination;
+                cv::exp(result, result);
+                stretchInto(result, plane);
+            });
+        });
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Homomorphic filter error: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ImagePreprocessor::multiScaleRetinex(const std::vector<double>& scales) {
+    if (!checkImageLoaded() || scales.empty()) return false;
+
+    try {
+        applyInRegion([&](cv::Mat& image) {
+            applyToLightness(image, [&](cv::Mat& plane) {
+                const double longest = std::max(plane.rows, plane.cols);
+                std::vector<double> sigmas;
+                for (double scale : scales) sigmas.push_back(scale * longest);
+
+                cv::Mat intensity, reflectance, surround;
+                plane.convertTo(intensity, CV_32F, intensityScale(plane.depth()));
+                cv::max(intensity, 0.0, intensity);     // Float images may go below 0
+                scaleSpace_.compute(intensity, sigmas);
+
+                // log I - mean over scales of log(G * I)
+                intensity += 1.0;
+                cv::log(intensity, reflectance);
+                const double weight = 1.0 / sigmas.size();
+                for (size_t i = 0; i < sigmas.size(); ++i) {
+                    scaleSpace_.level(i, surround);
+                    surround += 1.0;
+                    cv::log(surround, surround);
+                    cv::scaleAdd(surround, -weight, reflectance, reflectance);
+                }
+                stretchInto(reflectance, plane);
+            });
+        });
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Retinex error: " << e.what() << std::endl;
+        return false;
     }
     return true;
 }
@@ -252,14 +461,14 @@ bool ImagePreprocessor::unsharpMask(double sigma, double strength) {
     
     if (image_.channels() == 1) {
         cv::Mat blurred;
-        cv::GaussianBlur(image_, blurred, cv::Size(), sigma);
+        gaussianFilter(image_, blurred, cv::Size(), sigma);
         cv::addWeighted(image_, 1.0 + strength, blurred, -strength, 0, image_);
     } else {
         std::vector<cv::Mat> channels;
         cv::split(image_, channels);
         for (auto& channel : channels) {
             cv::Mat blurred;
-            cv::GaussianBlur(channel, blurred, cv::Size(), sigma);
+            gaussianFilter(channel, blurred, cv::Size(), sigma);
             cv::addWeighted(channel, 1.0 + strength, blurred, -strength, 0, channel);
         }
         cv::merge(channels, image_);
@@ -267,6 +476,226 @@ bool ImagePreprocessor::unsharpMask(double sigma, double strength) {
     return true;
 }
 
+// ---------- Bone Suppression ----------
+
+bool ImagePreprocessor::suppressBones(double strength) {
+    if (!checkImageLoaded()) return false;
+
+    if (boneSuppressor_.params().strength != strength) {
+        BoneSuppressor::Params params = boneSuppressor_.params();
+        params.strength = strength;
+        boneSuppressor_.setParams(params);
+    }
+
+    try {
+        applyInRegion([this](cv::Mat& image) {
+            if (image.channels() == 1) {
+                boneSuppressor_.apply(image, image);
+            } else {
+                cv::Mat lab;
+                cv::cvtColor(image, lab, cv::COLOR_BGR2Lab);
+                std::vector<cv::Mat> channels;
+                cv::split(lab, channels);
+                boneSuppressor_.apply(channels[0], channels[0]);
+                cv::merge(channels, lab);
+                cv::cvtColor(lab, image, cv::COLOR_Lab2BGR);
+            }
+        });
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Bone suppression error: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ---------- Cropping ----------
+
+namespace {
+
+// Median of one row or column, the level of a uniform margin
+template <typename T>
+int borderLevel(const cv::Mat& line) {
+    std::vector<T> values(line.begin<T>(), line.end<T>());
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+enum Side { TOP, BOTTOM, LEFT, RIGHT, SIDE_COUNT };
+
+constexpr int BLOCK = 64;   // Rows per stripe and columns per block of the counts
+
+// Pixels differing from each side's level: per row and column block for the
+// top and bottom levels, per stripe and column for the left and right ones.
+// Keeping the blocks lets each direction be judged inside the other's bounds.
+struct ContentCounts {
+    int blocks{0};
+    int stripes{0};
+    std::vector<int> rowsTop, rowsBottom;
+    std::vector<int> columnsLeft, columnsRight;
+};
+
+template <typename T>
+void countContent(const cv::Mat& gray, const int levels[SIDE_COUNT], int tolerance,
+                  ContentCounts& counts) {
+    const int cols = gray.cols;
+
+    // Stripes write disjoint rows and column slices
+    TaskScheduler::instance().parallelFor(0, counts.stripes, [&](int first, int last) {
+        for (int stripe = first; stripe < last; ++stripe) {
+            int* left = &counts.columnsLeft[static_cast<size_t>(stripe) * cols];
+            int* right = &counts.columnsRight[static_cast<size_t>(stripe) * cols];
+            const int end = std::min(gray.rows, (stripe + 1) * BLOCK);
+            for (int y = stripe * BLOCK; y < end; ++y) {
+                const T* row = gray.ptr<T>(y);
+                int* top = &counts.rowsTop[static_cast<size_t>(y) * counts.blocks];
+                int* bottom = &counts.rowsBottom[static_cast<size_t>(y) * counts.blocks];
+                for (int block = 0; block < counts.blocks; ++block) {
+                    const int blockEnd = std::min(cols, (block + 1) * BLOCK);
+                    int topCount = 0, bottomCount = 0;
+                    for (int x = block * BLOCK; x < blockEnd; ++x) {
+                        const int value = row[x];
+                        topCount += std::abs(value - levels[TOP]) > tolerance;
+                        bottomCount += std::abs(value - levels[BOTTOM]) > tolerance;
+                        left[x] += std::abs(value - levels[LEFT]) > tolerance;
+                        right[x] += std::abs(value - levels[RIGHT]) > tolerance;
+                    }
+                    top[block] = topCount;
+                    bottom[block] = bottomCount;
+                }
+            }
+        }
+    });
+}
+
+// Blocks lying inside [begin, end), or the ones covering it when none do
+std::pair<int, int> blocksWithin(int begin, int end, int blockCount) {
+    int first = (begin + BLOCK - 1) / BLOCK;
+    int last = end / BLOCK;
+    if (first >= last) {
+        first = begin / BLOCK;
+        last = std::min(blockCount, (end + BLOCK - 1) / BLOCK);
+    }
+    return {first, last};
+}
+
+} // namespace
+
+cv::Rect ImagePreprocessor::detectContentBounds(const cv::Mat& image, const AutoCropParams& params) {
+    const cv::Rect full(0, 0, image.cols, image.rows);
+    if (image.rows < 3 || image.cols < 3 ||
+        (image.depth() != CV_8U && image.depth() != CV_16U)) {
+        return full;
+    }
+
+    cv::Mat gray = image;
+    if (image.channels() == 3) {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    } else if (image.channels() == 4) {
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    } else if (image.channels() != 1) {
+        return full;
+    }
+
+    const bool wide = gray.depth() == CV_16U;
+    const int tolerance = cvRound(params.tolerance * (wide ? 257.0 : 1.0));
+    int levels[SIDE_COUNT];
+    auto level = [wide](const cv::Mat& line) {
+        return wide ? borderLevel<ushort>(line) : borderLevel<uchar>(line);
+    };
+    levels[TOP] = level(gray.row(0));
+    levels[BOTTOM] = level(gray.row(gray.rows - 1));
+    levels[LEFT] = level(gray.col(0));
+    levels[RIGHT] = level(gray.col(gray.cols - 1));
+
+    // The only pass over the pixels
+    ContentCounts counts;
+    counts.blocks = (gray.cols + BLOCK - 1) / BLOCK;
+    counts.stripes = (gray.rows + BLOCK - 1) / BLOCK;
+    counts.rowsTop.resize(static_cast<size_t>(gray.rows) * counts.blocks);
+    counts.rowsBottom.resize(static_cast<size_t>(gray.rows) * counts.blocks);
+    counts.columnsLeft.assign(static_cast<size_t>(counts.stripes) * gray.cols, 0);
+    counts.columnsRight.assign(static_cast<size_t>(counts.stripes) * gray.cols, 0);
+    if (wide) {
+        countContent<ushort>(gray, levels, tolerance, counts);
+    } else {
+        countContent<uchar>(gray, levels, tolerance, counts);
+    }
+
+    // Rows are judged inside the horizontal content and columns inside the
+    // vertical content, so an L-shaped collimation does not count as content
+    // of the other sides. The first estimate looks at the central half only.
+    int top = gray.rows / 4, bottom = gray.rows - gray.rows / 4 - 1;
+    int leftEdge = gray.cols / 4, rightEdge = gray.cols - gray.cols / 4 - 1;
+    std::vector<int> rowTop(gray.rows), rowBottom(gray.rows);
+    std::vector<int> columnLeft(gray.cols), columnRight(gray.cols);
+    for (int pass = 0; pass < 2; ++pass) {
+        const auto blocks = blocksWithin(leftEdge, rightEdge + 1, counts.blocks);
+        const auto stripes = blocksWithin(top, bottom + 1, counts.stripes);
+
+        std::fill(rowTop.begin(), rowTop.end(), 0);
+        std::fill(rowBottom.begin(), rowBottom.end(), 0);
+        for (int y = 0; y < gray.rows; ++y) {
+            const size_t offset = static_cast<size_t>(y) * counts.blocks;
+            for (int block = blocks.first; block < blocks.second; ++block) {
+                rowTop[y] += counts.rowsTop[offset + block];
+                rowBottom[y] += counts.rowsBottom[offset + block];
+            }
+        }
+        std::fill(columnLeft.begin(), columnLeft.end(), 0);
+        std::fill(columnRight.begin(), columnRight.end(), 0);
+        for (int stripe = stripes.first; stripe < stripes.second; ++stripe) {
+            const size_t offset = static_cast<size_t>(stripe) * gray.cols;
+            for (int x = 0; x < gray.cols; ++x) {
+                columnLeft[x] += counts.columnsLeft[offset + x];
+                columnRight[x] += counts.columnsRight[offset + x];
+            }
+        }
+
+        // Margins are the outer rows and columns with too little content
+        const int countedColumns = std::min(gray.cols, blocks.second * BLOCK) - blocks.first * BLOCK;
+        const int countedRows = std::min(gray.rows, stripes.second * BLOCK) - stripes.first * BLOCK;
+        const int rowLimit = static_cast<int>(params.maxContentFraction * countedColumns);
+        const int columnLimit = static_cast<int>(params.maxContentFraction * countedRows);
+        top = 0;
+        while (top < gray.rows && rowTop[top] <= rowLimit) ++top;
+        bottom = gray.rows - 1;
+        while (bottom > top && rowBottom[bottom] <= rowLimit) --bottom;
+        leftEdge = 0;
+        while (leftEdge < gray.cols && columnLeft[leftEdge] <= columnLimit) ++leftEdge;
+        rightEdge = gray.cols - 1;
+        while (rightEdge > leftEdge && columnRight[rightEdge] <= columnLimit) --rightEdge;
+        if (top >= bottom || leftEdge >= rightEdge) return full;
+    }
+
+    const int margin = std::max(params.margin, 0);
+    cv::Rect bounds(leftEdge - margin, top - margin,
+                    rightEdge - leftEdge + 1 + 2 * margin, bottom - top + 1 + 2 * margin);
+    bounds &= full;
+    if (bounds.width < params.minKeptFraction * full.width ||
+        bounds.height < params.minKeptFraction * full.height) {
+        return full;
+    }
+    return bounds;
+}
+
+bool ImagePreprocessor::autoCrop(const AutoCropParams& params) {
+    if (!checkImageLoaded()) return false;
+
+    const cv::Rect bounds = detectContentBounds(image_, params);
+    if (bounds.size() == image_.size()) return true;
+
+    // Views of the content, the full buffers stay alive behind them
+    if (originalImage_.size() == image_.size()) {
+        originalImage_ = originalImage_(bounds);
+    }
+    image_ = image_(bounds);
+    region_ = (region_ - bounds.tl()) & cv::Rect(cv::Point(), bounds.size());
+    crop_ = cv::Rect(crop_.tl() + bounds.tl(), bounds.size());
+    return true;
+}
+
 // ---------- Utility Functions ----------
 
 cv::Mat ImagePreprocessor::getHistogram() const {
@@ -332,8 +761,122 @@ cv::Mat ImagePreprocessor::getHistogram() const {
     return histImage;
 }
 
+std::vector<cv::Mat> ImagePreprocessor::computeHistogram(const cv::Mat& image, int bins) {
+    std::vector<cv::Mat> histograms;
+    if (image.empty() || bins <= 0) return histograms;
+
+    // calcHist only handles 8U, 16U and 32F
+    cv::Mat source = image;
+    if (source.depth() != CV_8U && source.depth() != CV_16U && source.depth() != CV_32F) {
+        image.convertTo(source, CV_32F);
+    }
+
+    // 8-bit bins cover 0-255. 16-bit bins cover the bits in use, so 12-bit
+    // data spreads over all bins instead of the first sixteenth. Floats use
+    // their actual range, and calcHist excludes the upper bound, so it is
+    // moved just past the maximum.
+    float range[] = { 0, 256 };
+    if (source.depth() == CV_16U || source.depth() == CV_32F) {
+        double minVal, maxVal;
+        cv::Mat flat = source.isContinuous() ? source : source.clone();
+        cv::minMaxLoc(flat.reshape(1), &minVal, &maxVal);
+        if (source.depth() == CV_16U) {
+            while (range[1] <= maxVal) range[1] *= 2;
+        } else if (maxVal > minVal) {
+            range[0] = static_cast<float>(minVal);
+            range[1] = std::nextafter(static_cast<float>(maxVal), std::numeric_limits<float>::infinity());
+        } else {
+            range[0] = static_cast<float>(minVal);
+            range[1] = static_cast<float>(minVal + 1);
+        }
+    }
+    const float* histRange = { range };
+
+    // Row stripes are counted in parallel and their counts summed
+    constexpr int STRIPE_ROWS = 64;
+    std::vector<cv::Mat> totals(source.channels());
+    std::mutex totalsMutex;
+    TaskScheduler::instance().parallelFor(0, source.rows, [&](int begin, int end) {
+        cv::Mat stripe = source.rowRange(begin, end);
+        for (int c = 0; c < source.channels(); ++c) {
+            cv::Mat hist;
+            cv::calcHist(&stripe, 1, &c, cv::Mat(), hist, 1, &bins, &histRange);
+
+            std::lock_guard<std::mutex> lock(totalsMutex);
+            if (totals[c].empty()) {
+                totals[c] = hist;
+            } else {
+                totals[c] += hist;
+            }
+        }
+    }, STRIPE_ROWS);
+
+    histograms = std::move(totals);
+    return histograms;
+}
+
 // ---------- Private Methods ----------
 
+void ImagePreprocessor::setRegionOfInterest(const cv::Rect& region) {
+    region_ = region;
+}
+
+void ImagePreprocessor::setRegionOfInterest(const cv::Mat& mask, int margin) {
+    region_ = Segmentation::maskBounds(mask, margin);
+}
+
+void ImagePreprocessor::applyInRegion(const std::function<void(cv::Mat&)>& operation) {
+    cv::Rect region = region_ & cv::Rect(0, 0, image_.cols, image_.rows);
+    if (region.empty() || region.size() == image_.size()) {
+        operation(image_);
+        return;
+    }
+
+    // Operations write through the view unless they change the format,
+    // which the rest of the image can only follow by processing it all
+    cv::Mat view = image_(region);
+    cv::Mat result = view;
+    operation(result);
+    if (result.type() != image_.type()) {
+        operation(image_);
+    } else if (result.data != view.data) {
+        result.copyTo(view);
+    }
+}
+
+void ImagePreprocessor::gaussianFilter(const cv::Mat& image, cv::Mat& output, cv::Size kernelSize, double sigma) {
+    const int depth = image.depth();
+    const bool supported = depth == CV_8U || depth == CV_16U || depth == CV_32F;
+
+    // The recursive filter is the untruncated Gaussian, so AUTO only uses
+    // it when the kernel is not cut much short of +-3 sigma
+    const bool wholeKernel = kernelSize.width <= 0 ||
+                             std::min(kernelSize.width, kernelSize.height) >= 6.0 * sigma;
+    if (supported && sigma >= 0.5 &&
+        (filterExecution_ == FilterExecution::RECURSIVE ||
+         (filterExecution_ == FilterExecution::AUTO && sigma >= recursiveSigmaThreshold_ && wholeKernel))) {
+        RecursiveGaussian(sigma).apply(image, output);
+        return;
+    }
+
+    if (supported && filterExecution_ != FilterExecution::SPATIAL) {
+        const auto key = std::make_tuple(kernelSize.width, kernelSize.height, sigma, depth);
+        if (!blurResponse_ || blurKey_ != key) {
+            blurResponse_.emplace(FrequencyResponse::gaussian(kernelSize, sigma, sigma, depth));
+            blurKey_ = key;
+        }
+
+        // Kernel size OpenCV derives when none is given
+        const cv::Size kernel(2 * blurResponse_->supportX() + 1, 2 * blurResponse_->supportY() + 1);
+        FrequencyFilter& filter = FrequencyFilter::instance();
+        if (filterExecution_ == FilterExecution::FREQUENCY || filter.prefersFrequency(image, kernel)) {
+            filter.apply(image, output, *blurResponse_);
+            return;
+        }
+    }
+    cv::GaussianBlur(image, output, kernelSize, sigma);
+}
+
 bool ImagePreprocessor::checkImageLoaded() const {
     return !image_.empty();
 }
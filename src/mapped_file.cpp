@@ -0,0 +1,77 @@
+/**
+ * @file mapped_file.cpp
+ * @brief Implementation of read-only file mapping
+ */
+
+#include "../include/medical_vision/mapped_file.hpp"
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace medical_vision {
+
+MappedFile::MappedFile(const std::string& filepath) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    file_ = file;
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize)) {
+        file_ = nullptr;
+        throw std::runtime_error("Cannot open file: " + filepath);
+    }
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    mapping_ = mapping;
+    if (mapping) {
+        data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!data_) {
+        release();
+        throw std::runtime_error("Cannot map file: " + filepath);
+    }
+#else
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Cannot open file: " + filepath);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    void* address = size_ > 0 ? mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Cannot map file: " + filepath);
+    }
+    data_ = static_cast<const uint8_t*>(address);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+void MappedFile::release() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(static_cast<HANDLE>(mapping_));
+    if (file_) CloseHandle(static_cast<HANDLE>(file_));
+    mapping_ = nullptr;
+    file_ = nullptr;
+#else
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    data_ = nullptr;
+}
+
+} // namespace medical_vision
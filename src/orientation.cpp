@@ -0,0 +1,157 @@
+/**
+ * @file orientation.cpp
+ * @brief Implementation of orientation and inversion normalization
+ */
+
+#include "../include/medical_vision/orientation.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace medical_vision {
+
+namespace {
+
+// Mean level inside a rectangle of an 8-bit image
+double regionMean(const cv::Mat& gray, const cv::Rect& rect) {
+    const cv::Rect area = rect & cv::Rect(0, 0, gray.cols, gray.rows);
+    if (area.empty()) return 0.0;
+    int64_t sum = 0;
+    for (int y = area.y; y < area.y + area.height; ++y) {
+        const uchar* row = gray.ptr<uchar>(y);
+        for (int x = area.x; x < area.x + area.width; ++x) {
+            sum += row[x];
+        }
+    }
+    return static_cast<double>(sum) / area.area();
+}
+
+// Smallest value with at least fraction of the counts at or below it
+int percentile(const std::array<int64_t, 256>& histogram, double fraction) {
+    int64_t total = 0;
+    for (int64_t count : histogram) total += count;
+    const int64_t target = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(fraction * total)));
+    int64_t cumulative = 0;
+    for (int value = 0; value < 256; ++value) {
+        cumulative += histogram[value];
+        if (cumulative >= target) return value;
+    }
+    return 255;
+}
+
+void rotateQuarters(const cv::Mat& image, cv::Mat& output, int quarterTurns) {
+    static const int CODES[] = {-1, cv::ROTATE_90_CLOCKWISE, cv::ROTATE_180, cv::ROTATE_90_COUNTERCLOCKWISE};
+    const int turns = ((quarterTurns % 4) + 4) % 4;
+    if (turns == 0) {
+        output = image;
+        return;
+    }
+    // Into a new buffer, cv::rotate cannot work in place
+    cv::Mat turned;
+    cv::rotate(image, turned, CODES[turns]);
+    output = turned;
+}
+
+} // namespace
+
+OrientationEstimate estimateOrientation(const cv::Mat& image, int analysisSize, double minConfidence) {
+    OrientationEstimate estimate;
+    if (image.empty() || (image.depth() != CV_8U && image.depth() != CV_16U) ||
+        (image.channels() != 1 && image.channels() != 3 && image.channels() != 4)) {
+        return estimate;
+    }
+
+    // Same reduction as assessQuality: area downsample, then 8-bit gray
+    cv::Mat gray = image;
+    const int longest = std::max(image.rows, image.cols);
+    analysisSize = std::max(analysisSize, 16);
+    if (longest > analysisSize) {
+        const double scale = static_cast<double>(analysisSize) / longest;
+        cv::Size size(std::max(8, cvRound(image.cols * scale)), std::max(8, cvRound(image.rows * scale)));
+        cv::resize(image, gray, size, 0, 0, cv::INTER_AREA);
+    }
+    if (gray.channels() == 3) {
+        cv::cvtColor(gray, gray, cv::COLOR_BGR2GRAY);
+    } else if (gray.channels() == 4) {
+        cv::cvtColor(gray, gray, cv::COLOR_BGRA2GRAY);
+    }
+    if (gray.depth() == CV_16U) {
+        gray.convertTo(gray, CV_8U, 1.0 / 257.0);
+    }
+
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+    if (rows < 8 || cols < 8) return estimate;
+
+    // Histograms of the whole image and of a ring a twentieth wide
+    std::array<int64_t, 256> histogram{}, borderHistogram{};
+    const int ring = std::max(1, std::min(rows, cols) / 20);
+    for (int y = 0; y < rows; ++y) {
+        const uchar* row = gray.ptr<uchar>(y);
+        const bool borderRow = y < ring || y >= rows - ring;
+        for (int x = 0; x < cols; ++x) {
+            ++histogram[row[x]];
+            if (borderRow || x < ring || x >= cols - ring) {
+                ++borderHistogram[row[x]];
+            }
+        }
+    }
+    const double contrast = std::max(percentile(histogram, 0.99) - percentile(histogram, 0.01), 1);
+
+    // Central thirds against the lateral ones, leaving out a tenth at the
+    // edges where borders and collimation sit
+    const int mx = cols / 10, my = rows / 10;
+    const int third = cols / 3, rowThird = rows / 3;
+    const double verticalAxis = regionMean(gray, cv::Rect(third, my, cols - 2 * third, rows - 2 * my)) -
+        0.5 * (regionMean(gray, cv::Rect(mx, my, third - mx, rows - 2 * my)) +
+               regionMean(gray, cv::Rect(cols - third, my, third - mx, rows - 2 * my)));
+    const double horizontalAxis = regionMean(gray, cv::Rect(mx, rowThird, cols - 2 * mx, rows - 2 * rowThird)) -
+        0.5 * (regionMean(gray, cv::Rect(mx, my, cols - 2 * mx, rowThird - my)) +
+               regionMean(gray, cv::Rect(mx, rows - rowThird, cols - 2 * mx, rowThird - my)));
+
+    // The spine runs along the band standing out most from its sides
+    const bool rotated = std::abs(horizontalAxis) > std::abs(verticalAxis);
+    const double spineAxis = rotated ? horizontalAxis : verticalAxis;
+    estimate.rotationConfidence = std::abs(std::abs(horizontalAxis) - std::abs(verticalAxis)) / contrast;
+
+    // Bright spine and a border darker than the median mean upright polarity
+    const double structural = spineAxis / contrast;
+    const double border = (percentile(histogram, 0.5) - percentile(borderHistogram, 0.5)) / contrast;
+    const double inversionScore = structural + 0.5 * border;
+    estimate.inversionConfidence = std::abs(inversionScore);
+    estimate.inverted = inversionScore < -minConfidence;
+
+    if (rotated && estimate.rotationConfidence >= minConfidence) {
+        // Along the spine the heart, the denser lower spine and the abdomen
+        // make the lower end brighter than the upper one, the shoulders
+        // aside. If the lower end is on the right, the film was turned
+        // counterclockwise; too little difference leaves it as is.
+        const int bandHeight = rows - 2 * rowThird;
+        double towardsRight = regionMean(gray, cv::Rect(cols - third, rowThird, third - mx, bandHeight)) -
+                              regionMean(gray, cv::Rect(mx, rowThird, third - mx, bandHeight));
+        if (estimate.inverted) towardsRight = -towardsRight;
+        estimate.directionConfidence = std::abs(towardsRight) / contrast;
+        if (estimate.directionConfidence >= minConfidence) {
+            estimate.quarterTurns = towardsRight > 0 ? 1 : 3;
+        }
+    }
+    return estimate;
+}
+
+void correctOrientation(const cv::Mat& image, cv::Mat& output, const OrientationEstimate& estimate) {
+    cv::Mat turned;
+    rotateQuarters(image, turned, estimate.quarterTurns);
+    if (estimate.inverted) {
+        // max - value for unsigned depths
+        cv::bitwise_not(turned, output);
+    } else {
+        output = turned;
+    }
+}
+
+void restoreOrientation(const cv::Mat& image, cv::Mat& output, const OrientationEstimate& estimate) {
+    rotateQuarters(image, output, -estimate.quarterTurns);
+}
+
+} // namespace medical_vision
@@ -0,0 +1,888 @@
+/**
+ * @file pipeline.cpp
+ * @brief Implementation of pipeline specs, planning and execution
+ */
+
+#include "../include/medical_vision/pipeline.hpp"
+#include "../include/medical_vision/bone_suppression.hpp"
+#include <opencv2/imgproc.hpp>
+#include <opencv2/photo.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace medical_vision {
+
+namespace {
+
+// ---------- Formats ----------
+
+enum DepthFlags : unsigned {
+    DEPTH_8U = 1,
+    DEPTH_16U = 2,
+    DEPTH_32F = 4,
+    ANY_DEPTH = DEPTH_8U | DEPTH_16U | DEPTH_32F
+};
+
+enum class Channels {
+    ANY,
+    GRAY,
+    COLOR,
+    GRAY_OR_COLOR
+};
+
+unsigned depthFlag(int depth) {
+    switch (depth) {
+        case CV_8U: return DEPTH_8U;
+        case CV_16U: return DEPTH_16U;
+        case CV_32F: return DEPTH_32F;
+        default: return 0;
+    }
+}
+
+// Value of full intensity, 32F images are in [0, 1]
+double depthMax(int depth) {
+    switch (depth) {
+        case CV_8U: return 255.0;
+        case CV_16U: return 65535.0;
+        default: return 1.0;
+    }
+}
+
+int precision(int depth) {
+    return depth == CV_8U ? 0 : depth == CV_16U ? 1 : 2;
+}
+
+const char* depthName(int depth) {
+    switch (depth) {
+        case CV_8U: return "8U";
+        case CV_16U: return "16U";
+        default: return "32F";
+    }
+}
+
+// Keep the depth if accepted, otherwise the closest accepted one that does
+// not lose precision, or the most precise one if they all do
+int chooseDepth(int depth, unsigned accepted) {
+    if (accepted & depthFlag(depth)) return depth;
+    const int depths[] = {CV_8U, CV_16U, CV_32F};
+    for (int candidate : depths) {
+        if ((accepted & depthFlag(candidate)) && precision(candidate) >= precision(depth)) {
+            return candidate;
+        }
+    }
+    for (int i = 2; i >= 0; --i) {
+        if (accepted & depthFlag(depths[i])) return depths[i];
+    }
+    return depth;
+}
+
+int chooseChannels(int channels, Channels accepted) {
+    switch (accepted) {
+        case Channels::GRAY: return 1;
+        case Channels::COLOR: return 3;
+        case Channels::GRAY_OR_COLOR: return channels == 4 ? 3 : channels;
+        default: return channels;
+    }
+}
+
+int colorConversion(int from, int to) {
+    if (from == 3 && to == 1) return cv::COLOR_BGR2GRAY;
+    if (from == 4 && to == 1) return cv::COLOR_BGRA2GRAY;
+    if (from == 1 && to == 3) return cv::COLOR_GRAY2BGR;
+    if (from == 4 && to == 3) return cv::COLOR_BGRA2BGR;
+    if (from == 1 && to == 4) return cv::COLOR_GRAY2BGRA;
+    return cv::COLOR_BGR2BGRA;
+}
+
+// ---------- Step parameters ----------
+
+// Reads step parameters with their defaults, anything left unread is a typo
+class Params {
+public:
+    explicit Params(const PipelineStep& step) : step_(step) {}
+
+    double number(const std::string& name, double fallback) {
+        used_.insert(name);
+        if (step_.strings.count(name)) {
+            throw std::runtime_error("parameter '" + name + "' must be a number");
+        }
+        auto it = step_.numbers.find(name);
+        return it != step_.numbers.end() ? it->second : fallback;
+    }
+
+    double positive(const std::string& name, double fallback) {
+        double value = number(name, fallback);
+        if (value <= 0.0) {
+            throw std::runtime_error("parameter '" + name + "' must be positive");
+        }
+        return value;
+    }
+
+    int integer(const std::string& name, int fallback) {
+        double value = number(name, fallback);
+        if (value != static_cast<int>(value)) {
+            throw std::runtime_error("parameter '" + name + "' must be an integer");
+        }
+        return static_cast<int>(value);
+    }
+
+    int oddSize(const std::string& name, int fallback) {
+        int value = integer(name, fallback);
+        if (value < 1 || value % 2 == 0) {
+            throw std::runtime_error("parameter '" + name + "' must be a positive odd integer");
+        }
+        return value;
+    }
+
+    std::string text(const std::string& name, const std::string& fallback) {
+        used_.insert(name);
+        if (step_.numbers.count(name)) {
+            throw std::runtime_error("parameter '" + name + "' must be a string");
+        }
+        auto it = step_.strings.find(name);
+        return it != step_.strings.end() ? it->second : fallback;
+    }
+
+    void checkAllUsed() const {
+        for (const auto& entry : step_.numbers) checkUsed(entry.first);
+        for (const auto& entry : step_.strings) checkUsed(entry.first);
+    }
+
+private:
+    void checkUsed(const std::string& name) const {
+        if (!used_.count(name)) {
+            throw std::runtime_error("unknown parameter '" + name + "'");
+        }
+    }
+
+    const PipelineStep& step_;
+    std::set<std::string> used_;
+};
+
+// ---------- Operations ----------
+
+using Kernel = PipelinePlan::Kernel;
+
+struct Operation {
+    unsigned depths{ANY_DEPTH};
+    Channels channels{Channels::ANY};
+    // Output format for an accepted input format
+    std::function<ImageFormat(const ImageFormat&)> output = [](const ImageFormat& format) {
+        return format;
+    };
+    // Kernel for an accepted input, size is the planned size for scratch buffers
+    std::function<Kernel(const ImageFormat&, cv::Size)> build;
+
+    // target = source * alpha + beta, merged with neighbouring affine steps
+    bool affine{false};
+    double alpha{1.0};
+    double beta{0.0};
+
+    // Explicit conversion, planned like an inserted one
+    bool convert{false};
+    ImageFormat target;
+};
+
+ImageFormat withDepth(const ImageFormat& format, int depth) {
+    return ImageFormat{depth, format.channels};
+}
+
+Operation gaussianBlur(Params& params) {
+    int size = params.oddSize("kernel", 3);
+    double sigma = params.positive("sigma", 1.0);
+    Operation op;
+    op.build = [size, sigma](const ImageFormat&, cv::Size) -> Kernel {
+        return [size, sigma](const cv::Mat& source, cv::Mat& target) {
+            cv::GaussianBlur(source, target, cv::Size(size, size), sigma);
+        };
+    };
+    return op;
+}
+
+Operation medianBlur(Params& params) {
+    int size = params.oddSize("kernel", 3);
+    if (size < 3) throw std::runtime_error("parameter 'kernel' must be at least 3");
+    Operation op;
+    // Larger apertures are only implemented for 8-bit images
+    op.depths = size <= 5 ? ANY_DEPTH : DEPTH_8U;
+    op.build = [size](const ImageFormat&, cv::Size) -> Kernel {
+        return [size](const cv::Mat& source, cv::Mat& target) {
+            cv::medianBlur(source, target, size);
+        };
+    };
+    return op;
+}
+
+Operation bilateral(Params& params) {
+    int diameter = params.integer("diameter", 9);
+    double sigmaColor = params.positive("sigma_color", 75.0);
+    double sigmaSpace = params.positive("sigma_space", 75.0);
+    Operation op;
+    op.depths = DEPTH_8U | DEPTH_32F;
+    op.channels = Channels::GRAY_OR_COLOR;
+    op.build = [=](const ImageFormat&, cv::Size) -> Kernel {
+        return [=](const cv::Mat& source, cv::Mat& target) {
+            cv::bilateralFilter(source, target, diameter, sigmaColor, sigmaSpace);
+        };
+    };
+    return op;
+}
+
+Operation nlMeans(Params& params) {
+    float h = static_cast<float>(params.positive("h", 3.0));
+    int templateSize = params.oddSize("template", 7);
+    int searchSize = params.oddSize("search", 21);
+    Operation op;
+    op.depths = DEPTH_8U;
+    op.channels = Channels::GRAY_OR_COLOR;
+    op.build = [=](const ImageFormat& input, cv::Size) -> Kernel {
+        if (input.channels == 1) {
+            return [=](const cv::Mat& source, cv::Mat& target) {
+                cv::fastNlMeansDenoising(source, target, h, templateSize, searchSize);
+            };
+        }
+        return [=](const cv::Mat& source, cv::Mat& target) {
+            cv::fastNlMeansDenoisingColored(source, target, h, h, templateSize, searchSize);
+        };
+    };
+    return op;
+}
+
+Operation normalize(Params& params) {
+    double minValue = params.number("min", 0.0);
+    double maxValue = params.number("max", 255.0);
+    Operation op;
+    op.build = [=](const ImageFormat&, cv::Size) -> Kernel {
+        return [=](const cv::Mat& source, cv::Mat& target) {
+            cv::normalize(source, target, minValue, maxValue, cv::NORM_MINMAX, target.depth());
+        };
+    };
+    return op;
+}
+
+Operation contrast(Params& params) {
+    Operation op;
+    op.affine = true;
+    op.alpha = params.number("alpha", 1.0);
+    op.beta = params.number("beta", 0.0);
+    return op;
+}
+
+Operation equalize(Params&) {
+    Operation op;
+    op.depths = DEPTH_8U;
+    op.channels = Channels::GRAY_OR_COLOR;
+    op.build = [](const ImageFormat& input, cv::Size size) -> Kernel {
+        if (input.channels == 1) {
+            return [](const cv::Mat& source, cv::Mat& target) {
+                cv::equalizeHist(source, target);
+            };
+        }
+        // Luma only, like ImagePreprocessor
+        auto ycrcb = std::make_shared<cv::Mat>(size, CV_8UC3);
+        auto planes = std::make_shared<std::vector<cv::Mat>>();
+        return [ycrcb, planes](const cv::Mat& source, cv::Mat& target) {
+            cv::cvtColor(source, *ycrcb, cv::COLOR_BGR2YCrCb);
+            cv::split(*ycrcb, *planes);
+            cv::equalizeHist((*planes)[0], (*planes)[0]);
+            cv::merge(*planes, *ycrcb);
+            cv::cvtColor(*ycrcb, target, cv::COLOR_YCrCb2BGR);
+        };
+    };
+    return op;
+}
+
+Operation clahe(Params& params) {
+    double clipLimit = params.positive("clip_limit", 2.0);
+    int tiles = params.integer("tiles", 8);
+    if (tiles < 1) throw std::runtime_error("parameter 'tiles' must be positive");
+    Operation op;
+    op.depths = DEPTH_8U | DEPTH_16U;
+    op.channels = Channels::GRAY_OR_COLOR;
+    op.build = [=](const ImageFormat& input, cv::Size size) -> Kernel {
+        cv::Ptr<cv::CLAHE> equalizer = cv::createCLAHE(clipLimit, cv::Size(tiles, tiles));
+        if (input.channels == 1) {
+            return [equalizer](const cv::Mat& source, cv::Mat& target) {
+                equalizer->apply(source, target);
+            };
+        }
+        // Lab lightness only, like ImagePreprocessor
+        auto planes = std::make_shared<std::vector<cv::Mat>>();
+        if (input.depth == CV_8U) {
+            auto lab = std::make_shared<cv::Mat>(size, CV_8UC3);
+            return [equalizer, lab, planes](const cv::Mat& source, cv::Mat& target) {
+                cv::cvtColor(source, *lab, cv::COLOR_BGR2Lab);
+                cv::split(*lab, *planes);
+                equalizer->apply((*planes)[0], (*planes)[0]);
+                cv::merge(*planes, *lab);
+                cv::cvtColor(*lab, target, cv::COLOR_Lab2BGR);
+            };
+        }
+        // No 16-bit Lab conversion, so go through float and equalize L
+        // (0-100) scaled onto the 16-bit range
+        auto lab = std::make_shared<cv::Mat>(size, CV_32FC3);
+        auto lightness = std::make_shared<cv::Mat>(size, CV_16UC1);
+        return [equalizer, lab, lightness, planes](const cv::Mat& source, cv::Mat& target) {
+            source.convertTo(*lab, CV_32F, 1.0 / 65535.0);
+            cv::cvtColor(*lab, *lab, cv::COLOR_BGR2Lab);
+            cv::split(*lab, *planes);
+            (*planes)[0].convertTo(*lightness, CV_16U, 655.35);
+            equalizer->apply(*lightness, *lightness);
+            lightness->convertTo((*planes)[0], CV_32F, 1.0 / 655.35);
+            cv::merge(*planes, *lab);
+            cv::cvtColor(*lab, *lab, cv::COLOR_Lab2BGR);
+            lab->convertTo(target, CV_16U, 65535.0);
+        };
+    };
+    return op;
+}
+
+Operation stretch(Params&) {
+    Operation op;
+    op.build = [](const ImageFormat& input, cv::Size) -> Kernel {
+        const double range = depthMax(input.depth);
+        auto stretchPlane = [range](const cv::Mat& source, cv::Mat& target) {
+            double minVal, maxVal;
+            cv::minMaxLoc(source, &minVal, &maxVal);
+            double scale = maxVal > minVal ? range / (maxVal - minVal) : 1.0;
+            source.convertTo(target, -1, scale, -minVal * scale);
+        };
+        if (input.channels == 1) {
+            return stretchPlane;
+        }
+        // Each channel over its own range
+        auto planes = std::make_shared<std::vector<cv::Mat>>();
+        return [stretchPlane, planes](const cv::Mat& source, cv::Mat& target) {
+            cv::split(source, *planes);
+            for (auto& plane : *planes) {
+                stretchPlane(plane, plane);
+            }
+            cv::merge(*planes, target);
+        };
+    };
+    return op;
+}
+
+Operation sharpen(Params& params) {
+    double strength = params.number("strength", 1.0);
+    Operation op;
+    op.build = [strength](const ImageFormat&, cv::Size) -> Kernel {
+        // Same kernel as ImagePreprocessor::sharpen, applied to every channel
+        cv::Mat kernel = (cv::Mat_<float>(3, 3) <<
+            -1, -1, -1,
+            -1,  9, -1,
+            -1, -1, -1);
+        kernel *= strength;
+        return [kernel](const cv::Mat& source, cv::Mat& target) {
+            cv::filter2D(source, target, -1, kernel);
+        };
+    };
+    return op;
+}
+
+Operation unsharpMask(Params& params) {
+    double sigma = params.positive("sigma", 1.0);
+    double strength = params.number("strength", 1.5);
+    Operation op;
+    op.build = [=](const ImageFormat& input, cv::Size size) -> Kernel {
+        auto blurred = std::make_shared<cv::Mat>(size, input.type());
+        return [=](const cv::Mat& source, cv::Mat& target) {
+            cv::GaussianBlur(source, *blurred, cv::Size(), sigma);
+            cv::addWeighted(source, 1.0 + strength, *blurred, -strength, 0, target);
+        };
+    };
+    return op;
+}
+
+Operation suppressBones(Params& params) {
+    BoneSuppressor::Params settings;
+    settings.strength = params.number("strength", settings.strength);
+    settings.workSize = params.integer("work_size", settings.workSize);
+    if (settings.workSize < 16) throw std::runtime_error("parameter 'work_size' must be at least 16");
+    Operation op;
+    op.channels = Channels::GRAY;
+    op.build = [settings](const ImageFormat&, cv::Size size) -> Kernel {
+        auto suppressor = std::make_shared<BoneSuppressor>(settings);
+        suppressor->prepare(size);
+        return [suppressor](const cv::Mat& source, cv::Mat& target) {
+            suppressor->apply(source, target);
+        };
+    };
+    return op;
+}
+
+Operation grayscale(Params&) {
+    Operation op;
+    op.output = [](const ImageFormat& format) { return ImageFormat{format.depth, 1}; };
+    op.build = [](const ImageFormat& input, cv::Size) -> Kernel {
+        if (input.channels == 1) {
+            return [](const cv::Mat& source, cv::Mat& target) { source.copyTo(target); };
+        }
+        int code = colorConversion(input.channels, 1);
+        return [code](const cv::Mat& source, cv::Mat& target) {
+            cv::cvtColor(source, target, code);
+        };
+    };
+    return op;
+}
+
+Operation convert(Params& params) {
+    Operation op;
+    op.convert = true;
+    std::string depth = params.text("depth", "");
+    if (depth.empty()) {
+        throw std::runtime_error("parameter 'depth' is required");
+    }
+    op.target.depth = ImageFormat::parse(depth).depth;
+    op.target.channels = params.integer("channels", 0);
+    if (op.target.channels != 0 && op.target.channels != 1 &&
+        op.target.channels != 3 && op.target.channels != 4) {
+        throw std::runtime_error("parameter 'channels' must be 1, 3 or 4");
+    }
+    return op;
+}
+
+Operation canny(Params& params) {
+    double threshold1 = params.number("threshold1", 100.0);
+    double threshold2 = params.number("threshold2", 200.0);
+    int aperture = params.oddSize("aperture", 3);
+    bool l2 = params.number("l2", 0.0) != 0.0;
+    Operation op;
+    op.depths = DEPTH_8U;
+    op.channels = Channels::GRAY_OR_COLOR;
+    op.output = [](const ImageFormat&) { return ImageFormat{CV_8U, 1}; };
+    op.build = [=](const ImageFormat&, cv::Size) -> Kernel {
+        return [=](const cv::Mat& source, cv::Mat& target) {
+            cv::Canny(source, target, threshold1, threshold2, aperture, l2);
+        };
+    };
+    return op;
+}
+
+// Gradient magnitude scaled back to 8 bits, like FeatureDetector::applySobel
+Operation sobel(Params& params) {
+    int aperture = params.oddSize("aperture", 3);
+    Operation op;
+    op.output = [](const ImageFormat& format) { return withDepth(format, CV_8U); };
+    op.build = [aperture](const ImageFormat& input, cv::Size size) -> Kernel {
+        const int gradientDepth = input.depth == CV_8U ? CV_16S : CV_32F;
+        const double scale = 255.0 / depthMax(input.depth);
+        auto gradX = std::make_shared<cv::Mat>(size, CV_MAKETYPE(gradientDepth, input.channels));
+        auto gradY = std::make_shared<cv::Mat>(size, CV_MAKETYPE(gradientDepth, input.channels));
+        auto absY = std::make_shared<cv::Mat>(size, CV_MAKETYPE(CV_8U, input.channels));
+        return [=](const cv::Mat& source, cv::Mat& target) {
+            cv::Sobel(source, *gradX, gradientDepth, 1, 0, aperture);
+            cv::Sobel(source, *gradY, gradientDepth, 0, 1, aperture);
+            cv::convertScaleAbs(*gradX, target, scale);
+            cv::convertScaleAbs(*gradY, *absY, scale);
+            cv::addWeighted(target, 0.5, *absY, 0.5, 0, target);
+        };
+    };
+    return op;
+}
+
+Operation threshold(Params& params) {
+    double value = params.number("value", 127.0);
+    double maxValue = params.number("max", 255.0);
+    bool invert = params.number("invert", 0.0) != 0.0;
+    Operation op;
+    op.depths = DEPTH_8U | DEPTH_32F;
+    op.channels = Channels::GRAY;
+    op.build = [=](const ImageFormat&, cv::Size) -> Kernel {
+        return [=](const cv::Mat& source, cv::Mat& target) {
+            cv::threshold(source, target, value, maxValue,
+                          invert ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY);
+        };
+    };
+    return op;
+}
+
+Operation otsu(Params&) {
+    Operation op;
+    op.depths = DEPTH_8U;
+    op.channels = Channels::GRAY;
+    op.build = [](const ImageFormat&, cv::Size) -> Kernel {
+        return [](const cv::Mat& source, cv::Mat& target) {
+            cv::threshold(source, target, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+        };
+    };
+    return op;
+}
+
+using Factory = Operation (*)(Params&);
+
+const std::map<std::string, Factory>& factories() {
+    static const std::map<std::string, Factory> table = {
+        {"gaussian_blur", gaussianBlur},
+        {"median_blur", medianBlur},
+        {"bilateral", bilateral},
+        {"nl_means", nlMeans},
+        {"normalize", normalize},
+        {"contrast", contrast},
+        {"equalize", equalize},
+        {"clahe", clahe},
+        {"stretch", stretch},
+        {"sharpen", sharpen},
+        {"unsharp_mask", unsharpMask},
+        {"suppress_bones", suppressBones},
+        {"grayscale", grayscale},
+        {"convert", convert},
+        {"canny", canny},
+        {"sobel", sobel},
+        {"threshold", threshold},
+        {"otsu", otsu}
+    };
+    return table;
+}
+
+// ---------- Planning ----------
+
+// Stage before buffers are assigned
+struct PlannedStage {
+    std::string label;
+    ImageFormat input;
+    ImageFormat output;
+    Operation op;
+    // Affine stages whose result is exact (32F, or a widening conversion)
+    // can be merged with the affine stage that follows
+    bool exact{false};
+};
+
+class Planner {
+public:
+    Planner(const ImageFormat& input, cv::Size size) : current_(input), size_(size) {}
+
+    void add(const std::string& label, const Operation& op) {
+        if (op.convert) {
+            ImageFormat target{op.target.depth, op.target.channels ? op.target.channels : current_.channels};
+            convertTo(target, "");
+            return;
+        }
+
+        ImageFormat accepted{chooseDepth(current_.depth, op.depths),
+                             chooseChannels(current_.channels, op.channels)};
+        convertTo(accepted, " (inserted)");
+
+        if (op.affine) {
+            addAffine(label, op.alpha, op.beta, current_.depth, current_.depth == CV_32F);
+            return;
+        }
+        append(label, op, op.output(current_));
+    }
+
+    // Channels are reduced before converting the depth and added after,
+    // so conversions run on the smaller image and depth changes stay
+    // next to affine steps they can be merged with
+    void convertTo(const ImageFormat& target, const std::string& note) {
+        if (target.channels < current_.channels) convertChannels(target.channels, note);
+        convertDepth(target.depth, note);
+        if (target.channels > current_.channels) convertChannels(target.channels, note);
+    }
+
+    std::vector<PlannedStage> finish() {
+        // Identity affine stages are left out
+        std::vector<PlannedStage> stages;
+        for (auto& stage : stages_) {
+            if (stage.op.affine && stage.op.alpha == 1.0 && stage.op.beta == 0.0 &&
+                stage.input == stage.output) {
+                continue;
+            }
+            stages.push_back(std::move(stage));
+        }
+        return stages;
+    }
+
+    ImageFormat current() const { return current_; }
+    cv::Size size() const { return size_; }
+
+private:
+    void convertDepth(int depth, const std::string& note) {
+        if (depth == current_.depth) return;
+        std::string label = std::string("convert ") + depthName(current_.depth) + "->" + depthName(depth) + note;
+        bool widening = precision(depth) > precision(current_.depth);
+        addAffine(label, depthMax(depth) / depthMax(current_.depth), 0.0, depth, widening);
+    }
+
+    void convertChannels(int channels, const std::string& note) {
+        if (channels == current_.channels) return;
+        int code = colorConversion(current_.channels, channels);
+        Operation op;
+        op.build = [code](const ImageFormat&, cv::Size) -> Kernel {
+            return [code](const cv::Mat& source, cv::Mat& target) {
+                cv::cvtColor(source, target, code);
+            };
+        };
+        append("convert " + std::to_string(current_.channels) + "->" + std::to_string(channels) +
+               " channels" + note, op, ImageFormat{current_.depth, channels});
+    }
+
+    void addAffine(const std::string& label, double alpha, double beta, int depth, bool exact) {
+        if (!stages_.empty() && stages_.back().op.affine && stages_.back().exact) {
+            PlannedStage& previous = stages_.back();
+            previous.label += " + " + label;
+            previous.op.beta = alpha * previous.op.beta + beta;
+            previous.op.alpha *= alpha;
+            previous.output = withDepth(previous.output, depth);
+            previous.exact = exact;
+            current_ = previous.output;
+            return;
+        }
+
+        Operation op;
+        op.affine = true;
+        op.alpha = alpha;
+        op.beta = beta;
+        append(label, op, withDepth(current_, depth));
+        stages_.back().exact = exact;
+    }
+
+    void append(const std::string& label, const Operation& op, const ImageFormat& output) {
+        PlannedStage stage;
+        stage.label = label;
+        stage.input = current_;
+        stage.output = output;
+        stage.op = op;
+        stages_.push_back(std::move(stage));
+        current_ = output;
+    }
+
+    ImageFormat current_;
+    cv::Size size_;
+    std::vector<PlannedStage> stages_;
+};
+
+Kernel affineKernel(double alpha, double beta) {
+    return [alpha, beta](const cv::Mat& source, cv::Mat& target) {
+        source.convertTo(target, target.depth(), alpha, beta);
+    };
+}
+
+PipelineSpec readSpec(cv::FileStorage& storage) {
+    if (!storage.isOpened()) {
+        throw std::runtime_error("Cannot read pipeline spec");
+    }
+
+    PipelineSpec spec;
+    cv::FileNode steps = storage["steps"];
+    if (!steps.isSeq()) {
+        throw std::runtime_error("Pipeline spec needs a \"steps\" sequence");
+    }
+    for (cv::FileNodeIterator it = steps.begin(); it != steps.end(); ++it) {
+        cv::FileNode node = *it;
+        const std::string where = "Pipeline step " + std::to_string(spec.steps.size() + 1);
+        if (!node.isMap()) {
+            throw std::runtime_error(where + " must be a map");
+        }
+
+        PipelineStep step;
+        for (const std::string& key : node.keys()) {
+            cv::FileNode value = node[key];
+            if (key == "op" && value.isString()) {
+                step.op = value.string();
+            } else if (value.isString()) {
+                step.strings[key] = value.string();
+            } else if (value.isInt() || value.isReal()) {
+                step.numbers[key] = value.real();
+            } else {
+                throw std::runtime_error(where + ": parameter '" + key + "' must be a number or a string");
+            }
+        }
+        if (step.op.empty()) {
+            throw std::runtime_error(where + " has no \"op\"");
+        }
+        spec.steps.push_back(std::move(step));
+    }
+
+    cv::FileNode input = storage["input"];
+    if (!input.empty()) {
+        spec.input = ImageFormat::parse(input.string());
+        spec.hasInput = true;
+    }
+    cv::FileNode output = storage["output"];
+    if (!output.empty()) {
+        spec.output = ImageFormat::parse(output.string());
+        spec.hasOutput = true;
+    }
+    return spec;
+}
+
+const ImageFormat& declaredInput(const PipelineSpec& spec) {
+    if (!spec.hasInput) {
+        throw std::runtime_error("Pipeline spec has no input format");
+    }
+    return spec.input;
+}
+
+} // namespace
+
+// ---------- ImageFormat ----------
+
+ImageFormat ImageFormat::of(const cv::Mat& image) {
+    ImageFormat format{image.depth(), image.channels()};
+    if (!depthFlag(format.depth) || (format.channels != 1 && format.channels != 3 && format.channels != 4)) {
+        throw std::runtime_error("Pipelines do not handle " + cv::typeToString(image.type()) + " images");
+    }
+    return format;
+}
+
+ImageFormat ImageFormat::parse(const std::string& name) {
+    const int depths[] = {CV_8U, CV_16U, CV_32F};
+    for (int depth : depths) {
+        const std::string prefix = depthName(depth);
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+
+        const std::string rest = name.substr(prefix.size());
+        if (rest.empty() || rest == "C1") return ImageFormat{depth, 1};
+        if (rest == "C3") return ImageFormat{depth, 3};
+        if (rest == "C4") return ImageFormat{depth, 4};
+    }
+    throw std::runtime_error("Unsupported image format \"" + name + "\", expected e.g. 8UC1, 16UC1 or 32FC3");
+}
+
+std::string ImageFormat::name() const {
+    return std::string(depthName(depth)) + "C" + std::to_string(channels);
+}
+
+// ---------- PipelineSpec ----------
+
+PipelineSpec PipelineSpec::load(const std::string& filepath) {
+    try {
+        cv::FileStorage storage(filepath, cv::FileStorage::READ);
+        if (!storage.isOpened()) {
+            throw std::runtime_error("Cannot open pipeline spec " + filepath);
+        }
+        return readSpec(storage);
+    }
+    catch (const cv::Exception& e) {
+        throw std::runtime_error("Malformed pipeline spec " + filepath + ": " + e.what());
+    }
+}
+
+PipelineSpec PipelineSpec::parse(const std::string& text) {
+    try {
+        cv::FileStorage storage(text, cv::FileStorage::READ | cv::FileStorage::MEMORY);
+        return readSpec(storage);
+    }
+    catch (const cv::Exception& e) {
+        throw std::runtime_error(std::string("Malformed pipeline spec: ") + e.what());
+    }
+}
+
+std::vector<std::string> PipelineSpec::operations() {
+    std::vector<std::string> names;
+    for (const auto& entry : factories()) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+// ---------- PipelinePlan ----------
+
+PipelinePlan::PipelinePlan(const PipelineSpec& spec, cv::Size size)
+    : PipelinePlan(spec, declaredInput(spec), size) {}
+
+PipelinePlan::PipelinePlan(const PipelineSpec& spec, const ImageFormat& input, cv::Size size)
+    : input_(input), output_(input), size_(size) {
+    Planner planner(input, size);
+
+    for (size_t i = 0; i < spec.steps.size(); ++i) {
+        const PipelineStep& step = spec.steps[i];
+        try {
+            auto factory = factories().find(step.op);
+            if (factory == factories().end()) {
+                throw std::runtime_error("unknown operation");
+            }
+            Params params(step);
+            Operation op = factory->second(params);
+            params.checkAllUsed();
+            planner.add(step.op, op);
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("Pipeline step " + std::to_string(i + 1) +
+                                     " (" + step.op + "): " + e.what());
+        }
+    }
+    if (spec.hasOutput) {
+        planner.convertTo(spec.output, " (output)");
+    }
+    output_ = planner.current();
+
+    for (auto& planned : planner.finish()) {
+        Stage stage;
+        stage.label = planned.label;
+        stage.format = planned.output;
+        try {
+            stage.apply = planned.op.affine ? affineKernel(planned.op.alpha, planned.op.beta)
+                                            : planned.op.build(planned.input, size_);
+        }
+        catch (const cv::Exception& e) {
+            throw std::runtime_error("Pipeline stage " + stage.label + ": " + e.what());
+        }
+        stages_.push_back(std::move(stage));
+    }
+    assignBuffers();
+}
+
+// Every stage writes to a buffer of its output format other than the one
+// it reads, so a linear chain needs at most two buffers per format
+void PipelinePlan::assignBuffers() {
+    int source = -1;
+    for (auto& stage : stages_) {
+        int target = -1;
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            if (bufferFormats_[i] == stage.format && static_cast<int>(i) != source) {
+                target = static_cast<int>(i);
+                break;
+            }
+        }
+        if (target < 0) {
+            target = static_cast<int>(buffers_.size());
+            buffers_.emplace_back(size_, stage.format.type());
+            bufferFormats_.push_back(stage.format);
+        }
+        stage.source = source;
+        stage.target = target;
+        source = target;
+    }
+}
+
+cv::Mat PipelinePlan::run(const cv::Mat& input) {
+    if (input.type() != input_.type()) {
+        throw std::runtime_error("Pipeline planned for " + input_.name() + " images, got " +
+                                 cv::typeToString(input.type()));
+    }
+    if (stages_.empty()) {
+        return input;
+    }
+    if (input.size() != size_) {
+        size_ = input.size();
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            buffers_[i].create(size_, bufferFormats_[i].type());
+        }
+    }
+
+    for (const auto& stage : stages_) {
+        const cv::Mat& source = stage.source < 0 ? input : buffers_[stage.source];
+        stage.apply(source, buffers_[stage.target]);
+    }
+    return buffers_[stages_.back().target];
+}
+
+std::string PipelinePlan::describe() const {
+    std::ostringstream out;
+    out << "input " << input_.name() << " " << size_.width << "x" << size_.height << "\n";
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%2zu. %-48s %-6s buffer %d\n", i + 1,
+                      stages_[i].label.c_str(), stages_[i].format.name().c_str(), stages_[i].target);
+        out << line;
+    }
+    out << "output " << output_.name() << ", " << buffers_.size() << " buffer(s)";
+    return out.str();
+}
+
+} // namespace medical_vision
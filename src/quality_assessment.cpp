@@ -0,0 +1,182 @@
+/**
+ * @file quality_assessment.cpp
+ * @brief Implementation of the quality metrics
+ */
+
+#include "../include/medical_vision/quality_assessment.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace medical_vision {
+
+namespace {
+
+// 0.5 at the threshold, 1 once scale better and 0 once scale worse
+double marginScore(double value, double threshold, double scale, bool higherIsBetter) {
+    if (scale <= 0.0) {
+        return (higherIsBetter ? value >= threshold : value <= threshold) ? 1.0 : 0.0;
+    }
+    double margin = (higherIsBetter ? value - threshold : threshold - value) / scale;
+    return 0.5 + 0.5 * std::clamp(margin, -1.0, 1.0);
+}
+
+// Smallest value with at least fraction of the pixels at or below it
+int percentile(const std::array<int64_t, 256>& histogram, int64_t total, double fraction) {
+    const int64_t target = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(fraction * total)));
+    int64_t cumulative = 0;
+    for (int value = 0; value < 256; ++value) {
+        cumulative += histogram[value];
+        if (cumulative >= target) return value;
+    }
+    return 255;
+}
+
+// Mean of sums[first, last) divided by count
+double bandMean(const std::vector<int64_t>& sums, int first, int last, int count) {
+    if (last <= first || count <= 0) return 0.0;
+    int64_t total = 0;
+    for (int i = first; i < last; ++i) total += sums[i];
+    return static_cast<double>(total) / (static_cast<double>(last - first) * count);
+}
+
+} // namespace
+
+std::string QualityReport::describe() const {
+    static const std::pair<Issue, const char*> NAMES[] = {
+        {UNSUPPORTED, "unsupported"}, {TOO_SMALL, "too small"}, {BLURRY, "blurry"},
+        {LOW_CONTRAST, "low contrast"}, {UNDEREXPOSED, "underexposed"},
+        {OVEREXPOSED, "overexposed"}, {NOISY, "noisy"}, {ORIENTATION, "orientation"}
+    };
+    std::string text;
+    for (const auto& [issue, name] : NAMES) {
+        if (has(issue)) {
+            if (!text.empty()) text += ", ";
+            text += name;
+        }
+    }
+    return text;
+}
+
+QualityReport assessQuality(const cv::Mat& image, const QualityThresholds& thresholds) {
+    QualityReport report;
+    if (image.empty() || (image.depth() != CV_8U && image.depth() != CV_16U) ||
+        (image.channels() != 1 && image.channels() != 3 && image.channels() != 4)) {
+        report.issues = QualityReport::UNSUPPORTED;
+        return report;
+    }
+    if (image.rows < thresholds.minSize || image.cols < thresholds.minSize) {
+        report.issues |= QualityReport::TOO_SMALL;
+    }
+
+    // Downsample before converting, so only the small image is touched twice
+    cv::Mat small = image;
+    const int longest = std::max(image.rows, image.cols);
+    const int analysisSize = std::max(thresholds.analysisSize, 16);
+    if (longest > analysisSize) {
+        const double scale = static_cast<double>(analysisSize) / longest;
+        cv::Size size(std::max(3, cvRound(image.cols * scale)), std::max(3, cvRound(image.rows * scale)));
+        cv::resize(image, small, size, 0, 0, cv::INTER_AREA);
+    }
+    cv::Mat gray = small;
+    if (small.channels() == 3) {
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    } else if (small.channels() == 4) {
+        cv::cvtColor(small, gray, cv::COLOR_BGRA2GRAY);
+    }
+    if (gray.depth() == CV_16U) {
+        gray.convertTo(gray, CV_8U, 1.0 / 257.0);
+    }
+
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+    if (rows < 3 || cols < 3) {
+        report.issues |= QualityReport::TOO_SMALL;
+        return report;
+    }
+
+    // The single pass: histogram, profiles, and on interior pixels the
+    // Laplacian and Immerkaer's noise operator
+    //   [ 1 -2  1]
+    //   [-2  4 -2]
+    //   [ 1 -2  1]
+    std::array<int64_t, 256> histogram{};
+    std::vector<int64_t> rowSums(rows, 0), columnSums(cols, 0);
+    int64_t laplacianSum = 0, laplacianSquares = 0, noiseSum = 0;
+    for (int y = 0; y < rows; ++y) {
+        const uchar* row = gray.ptr<uchar>(y);
+        int64_t rowSum = 0;
+        for (int x = 0; x < cols; ++x) {
+            ++histogram[row[x]];
+            rowSum += row[x];
+            columnSums[x] += row[x];
+        }
+        rowSums[y] = rowSum;
+
+        if (y == 0 || y == rows - 1) continue;
+        const uchar* above = gray.ptr<uchar>(y - 1);
+        const uchar* below = gray.ptr<uchar>(y + 1);
+        for (int x = 1; x < cols - 1; ++x) {
+            const int cross = above[x] + below[x] + row[x - 1] + row[x + 1];
+            const int diagonal = above[x - 1] + above[x + 1] + below[x - 1] + below[x + 1];
+            const int laplacian = cross - 4 * row[x];
+            laplacianSum += laplacian;
+            laplacianSquares += laplacian * laplacian;
+            noiseSum += std::abs(diagonal - 2 * cross + 4 * row[x]);
+        }
+    }
+
+    const int64_t total = static_cast<int64_t>(rows) * cols;
+    const double interior = static_cast<double>(rows - 2) * (cols - 2);
+    const double laplacianMean = laplacianSum / interior;
+    report.sharpness = laplacianSquares / interior - laplacianMean * laplacianMean;
+    report.noise = std::sqrt(CV_PI / 2.0) * noiseSum / (6.0 * interior);
+
+    report.darkLevel = percentile(histogram, total, 0.01);
+    report.medianLevel = percentile(histogram, total, 0.5);
+    report.brightLevel = percentile(histogram, total, 0.99);
+    report.contrast = report.brightLevel - report.darkLevel;
+    report.clippedFraction = static_cast<double>(histogram[255]) / total;
+
+    // Central thirds against the lateral ones, leaving out a tenth on each
+    // side where borders and collimation sit
+    const int columnMargin = cols / 10, rowMargin = rows / 10;
+    const double verticalAxis = bandMean(columnSums, cols / 3, cols - cols / 3, rows) -
+        0.5 * (bandMean(columnSums, columnMargin, cols / 3, rows) +
+               bandMean(columnSums, cols - cols / 3, cols - columnMargin, rows));
+    const double horizontalAxis = bandMean(rowSums, rows / 3, rows - rows / 3, cols) -
+        0.5 * (bandMean(rowSums, rowMargin, rows / 3, cols) +
+               bandMean(rowSums, rows - rows / 3, rows - rowMargin, cols));
+    report.orientation = (verticalAxis - horizontalAxis) / std::max(report.contrast, 1.0);
+
+    const QualityThresholds& t = thresholds;
+    auto flag = [&report](bool failed, QualityReport::Issue issue) {
+        if (failed) report.issues |= issue;
+    };
+    flag(report.sharpness < t.minSharpness, QualityReport::BLURRY);
+    flag(report.contrast < t.minContrast, QualityReport::LOW_CONTRAST);
+    flag(report.brightLevel < t.minBrightLevel, QualityReport::UNDEREXPOSED);
+    flag(report.darkLevel > t.maxDarkLevel || report.clippedFraction > t.maxClippedFraction,
+         QualityReport::OVEREXPOSED);
+    flag(report.noise > t.maxNoise, QualityReport::NOISY);
+    flag(report.orientation < t.minOrientation, QualityReport::ORIENTATION);
+
+    report.score = std::min({
+        marginScore(report.sharpness, t.minSharpness, t.minSharpness, true),
+        marginScore(report.contrast, t.minContrast, t.minContrast, true),
+        marginScore(report.brightLevel, t.minBrightLevel, t.minBrightLevel, true),
+        marginScore(report.darkLevel, t.maxDarkLevel, 255.0 - t.maxDarkLevel, false),
+        marginScore(report.clippedFraction, t.maxClippedFraction, t.maxClippedFraction, false),
+        marginScore(report.noise, t.maxNoise, t.maxNoise, false),
+        marginScore(report.orientation, t.minOrientation, 0.25, true)
+    });
+    if (report.has(QualityReport::TOO_SMALL)) {
+        report.score = 0.0;
+    }
+    return report;
+}
+
+} // namespace medical_vision
@@ -0,0 +1,165 @@
+/**
+ * @file recursive_gaussian.cpp
+ * @brief Implementation of the recursive Gaussian blur
+ */
+
+#include "../include/medical_vision/recursive_gaussian.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace medical_vision {
+
+namespace {
+
+// Rows transposed together by the horizontal pass, and columns filtered
+// together by one task of the vertical pass
+constexpr int ROW_BLOCK = 16;
+constexpr int COLUMN_STRIPE = 512;
+
+RecursiveGaussian::Coefficients coefficients(double sigma) {
+    if (!(sigma >= 0.5)) {
+        throw std::runtime_error("Recursive Gaussian needs a sigma of at least 0.5");
+    }
+
+    // Young and van Vliet (1995)
+    const double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330
+                                  : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+    const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+    const double a1 = (2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0;
+    const double a2 = -(1.4281 * q * q + 1.26661 * q * q * q) / b0;
+    const double a3 = 0.422205 * q * q * q / b0;
+    const double b = 1.0 - (a1 + a2 + a3);
+
+    RecursiveGaussian::Coefficients c;
+    c.sigma = sigma;
+    c.b = static_cast<float>(b);
+    c.a1 = static_cast<float>(a1);
+    c.a2 = static_cast<float>(a2);
+    c.a3 = static_cast<float>(a3);
+
+    // Past a replicated end the causal output relaxes towards the edge
+    // value as a free recursion from its last three deviations, and the
+    // anti-causal output there is linear in them (Triggs and Sdika).
+    // Running both recursions on unit deviations gives the matrix.
+    const int length = static_cast<int>(std::ceil(12.0 * sigma)) + 64;
+    std::vector<double> w(length + 3), y(length + 6, 0.0);
+    for (int j = 0; j < 3; ++j) {
+        std::fill(w.begin(), w.end(), 0.0);
+        w[2 - j] = 1.0;         // w[0..2] are the deviations at n - 3, n - 2, n - 1
+        for (int i = 3; i < length + 3; ++i) {
+            w[i] = a1 * w[i - 1] + a2 * w[i - 2] + a3 * w[i - 3];
+        }
+        std::fill(y.begin(), y.end(), 0.0);
+        for (int i = length + 2; i >= 3; --i) {
+            y[i] = b * w[i] + a1 * y[i + 1] + a2 * y[i + 2] + a3 * y[i + 3];
+        }
+        for (int k = 0; k < 3; ++k) {
+            c.m[k][j] = static_cast<float>(y[3 + k]);
+        }
+    }
+    return c;
+}
+
+// Blur along the rows of a float tile, every column independently and in
+// place. Inner loops run along the columns.
+void filterColumns(float* data, size_t step, int rows, int cols, const RecursiveGaussian::Coefficients& c) {
+    thread_local std::vector<float> scratch;
+    scratch.resize(static_cast<size_t>(cols) * 5);
+    float* first = scratch.data();      // Input at the top edge
+    float* last = first + cols;         // Input at the bottom edge
+    float* past[3] = {last + cols, last + 2 * cols, last + 3 * cols};   // Anti-causal output below the end
+
+    auto row = [&](int n) { return data + n * step; };
+    std::copy(row(0), row(0) + cols, first);
+    std::copy(row(rows - 1), row(rows - 1) + cols, last);
+
+    // Causal pass, the replicated top edge is its own steady state
+    const float b = c.b, a1 = c.a1, a2 = c.a2, a3 = c.a3;
+    for (int n = 0; n < rows; ++n) {
+        float* w = row(n);
+        const float* w1 = n >= 1 ? row(n - 1) : first;
+        const float* w2 = n >= 2 ? row(n - 2) : first;
+        const float* w3 = n >= 3 ? row(n - 3) : first;
+        for (int x = 0; x < cols; ++x) {
+            w[x] = b * w[x] + a1 * w1[x] + a2 * w2[x] + a3 * w3[x];
+        }
+    }
+
+    // Anti-causal state past the bottom edge
+    const float* w0 = row(rows - 1);
+    const float* w1 = rows >= 2 ? row(rows - 2) : first;
+    const float* w2 = rows >= 3 ? row(rows - 3) : first;
+    for (int x = 0; x < cols; ++x) {
+        const float u = last[x];
+        const float d0 = w0[x] - u, d1 = w1[x] - u, d2 = w2[x] - u;
+        for (int k = 0; k < 3; ++k) {
+            past[k][x] = u + c.m[k][0] * d0 + c.m[k][1] * d1 + c.m[k][2] * d2;
+        }
+    }
+
+    // Anti-causal pass
+    for (int n = rows - 1; n >= 0; --n) {
+        float* y = row(n);
+        const float* y1 = n + 1 < rows ? row(n + 1) : past[n + 1 - rows];
+        const float* y2 = n + 2 < rows ? row(n + 2) : past[n + 2 - rows];
+        const float* y3 = n + 3 < rows ? row(n + 3) : past[n + 3 - rows];
+        for (int x = 0; x < cols; ++x) {
+            y[x] = b * y[x] + a1 * y1[x] + a2 * y2[x] + a3 * y3[x];
+        }
+    }
+}
+
+} // namespace
+
+RecursiveGaussian::RecursiveGaussian(double sigmaX, double sigmaY)
+    : x_(coefficients(sigmaX)),
+      y_(sigmaY > 0.0 && sigmaY != sigmaX ? coefficients(sigmaY) : x_) {}
+
+void RecursiveGaussian::apply(const cv::Mat& image, cv::Mat& output) const {
+    const int depth = image.depth();
+    if (image.empty() || (depth != CV_8U && depth != CV_16U && depth != CV_32F)) {
+        throw std::runtime_error("Recursive Gaussian needs an 8-bit, 16-bit or float image");
+    }
+
+    // Not thread_local: waiting on parallelFor runs other tasks on this
+    // thread, which may blur too. The buffer pool recycles the allocation.
+    cv::Mat work;
+    image.convertTo(work, CV_32F);
+    const int rows = work.rows;
+    const int channels = work.channels();
+    const int width = work.cols * channels;
+    TaskScheduler& scheduler = TaskScheduler::instance();
+
+    // Vertical pass over stripes of columns
+    float* data = work.ptr<float>();
+    const size_t step = work.step1();
+    const int stripes = (width + COLUMN_STRIPE - 1) / COLUMN_STRIPE;
+    scheduler.parallelFor(0, stripes, [&](int first, int last) {
+        for (int s = first; s < last; ++s) {
+            const int x0 = s * COLUMN_STRIPE;
+            filterColumns(data + x0, step, rows, std::min(COLUMN_STRIPE, width - x0), y_);
+        }
+    });
+
+    // Horizontal pass over blocks of rows, transposed so the recursion
+    // again runs across contiguous columns
+    const int blocks = (rows + ROW_BLOCK - 1) / ROW_BLOCK;
+    scheduler.parallelFor(0, blocks, [&](int first, int last) {
+        cv::Mat transposed;
+        for (int block = first; block < last; ++block) {
+            const int y0 = block * ROW_BLOCK;
+            cv::Mat rowsView = work.rowRange(y0, std::min(rows, y0 + ROW_BLOCK));
+            cv::transpose(rowsView, transposed);
+            filterColumns(transposed.ptr<float>(), transposed.step1(), transposed.rows,
+                          transposed.cols * channels, x_);
+            cv::transpose(transposed, rowsView);
+        }
+    });
+
+    work.convertTo(output, depth);
+}
+
+} // namespace medical_vision
@@ -4,8 +4,15 @@
  */
 
 #include "../include/medical_vision/segmentation.hpp"
+#include "../include/medical_vision/image_cache.hpp"
+#include "../include/medical_vision/simd_kernels.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
+#include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/photo.hpp>
+#include <algorithm>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
 
 namespace medical_vision {
@@ -41,10 +48,18 @@ cv::Mat Segmentation::postProcessMask(const cv::Mat& mask) {
         processed.convertTo(processed, CV_8UC1);
     }
     
-    // Optional: Remove small objects and fill holes
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
-    cv::morphologyEx(processed, processed, cv::MORPH_OPEN, kernel);
-    cv::morphologyEx(processed, processed, cv::MORPH_CLOSE, kernel);
+    // Optional: Remove small objects and fill holes, opening then closing
+    // with the 3x3 ellipse (a cross at that size)
+    if (processed.channels() == 1) {
+        erodeCross3x3(processed, processed);
+        dilateCross3x3(processed, processed);
+        dilateCross3x3(processed, processed);
+        erodeCross3x3(processed, processed);
+    } else {
+        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
+        cv::morphologyEx(processed, processed, cv::MORPH_OPEN, kernel);
+        cv::morphologyEx(processed, processed, cv::MORPH_CLOSE, kernel);
+    }
     
     return processed;
 }
@@ -129,44 +144,56 @@ cv::Mat Segmentation::regionGrowing(const cv::Mat& input, const RegionGrowingPar
         throw std::runtime_error("No seeds provided for region growing");
     }
 
-    // Implementation of region growing algorithm
-    std::vector<cv::Point> seeds = params.seeds;
-    for (const auto& seed : seeds) {
-        if (mask.at<uchar>(seed) == 255) continue;
-        
+    // Implementation of region growing algorithm. The intensity criterion is
+    // symmetric, so each seed's region does not depend on the others: seeds
+    // are flooded in parallel into per-task masks that are merged at the end.
+    const std::vector<cv::Point>& seeds = params.seeds;
+    std::mutex maskMutex;
+    TaskScheduler::instance().parallelFor(0, static_cast<int>(seeds.size()),
+        [&](int begin, int end) {
+        cv::Mat local = cv::Mat::zeros(processed.size(), CV_8UC1);
         std::vector<cv::Point> queue;
-        queue.push_back(seed);
-        
-        while (!queue.empty()) {
-            cv::Point current = queue.back();
-            queue.pop_back();
-            
-            if (mask.at<uchar>(current) == 255) continue;
+
+        for (int s = begin; s < end; ++s) {
+            const cv::Point& seed = seeds[s];
+            if (local.at<uchar>(seed) == 255) continue;
             
-            mask.at<uchar>(current) = 255;
-            uchar currentIntensity = processed.at<uchar>(current);
+            queue.push_back(seed);
             
-            // Check 8-connected neighbors
-            for (int i = -1; i <= 1; i++) {
-                for (int j = -1; j <= 1; j++) {
-                    if (i == 0 && j == 0) continue;
-                    
-                    cv::Point neighbor(current.x + j, current.y + i);
-                    
-                    if (neighbor.x < 0 || neighbor.x >= processed.cols ||
-                        neighbor.y < 0 || neighbor.y >= processed.rows)
-                        continue;
-                    
-                    if (mask.at<uchar>(neighbor) == 255) continue;
-                    
-                    uchar neighborIntensity = processed.at<uchar>(neighbor);
-                    if (std::abs(currentIntensity - neighborIntensity) <= params.threshold) {
-                        queue.push_back(neighbor);
+            while (!queue.empty()) {
+                cv::Point current = queue.back();
+                queue.pop_back();
+                
+                if (local.at<uchar>(current) == 255) continue;
+                
+                local.at<uchar>(current) = 255;
+                uchar currentIntensity = processed.at<uchar>(current);
+                
+                // Check 8-connected neighbors
+                for (int i = -1; i <= 1; i++) {
+                    for (int j = -1; j <= 1; j++) {
+                        if (i == 0 && j == 0) continue;
+                        
+                        cv::Point neighbor(current.x + j, current.y + i);
+                        
+                        if (neighbor.x < 0 || neighbor.x >= processed.cols ||
+                            neighbor.y < 0 || neighbor.y >= processed.rows)
+                            continue;
+                        
+                        if (local.at<uchar>(neighbor) == 255) continue;
+                        
+                        uchar neighborIntensity = processed.at<uchar>(neighbor);
+                        if (std::abs(currentIntensity - neighborIntensity) <= params.threshold) {
+                            queue.push_back(neighbor);
+                        }
                     }
                 }
             }
         }
-    }
+
+        std::lock_guard<std::mutex> lock(maskMutex);
+        cv::bitwise_or(mask, local, mask);
+    });
     
     return mask;
 }
@@ -263,8 +290,98 @@ std::vector<std::vector<cv::Point>> Segmentation::getContours(const cv::Mat& mas
     return contours;
 }
 
+cv::Mat Segmentation::lungMask(const cv::Mat& input) {
+    validateInput(input);
+    cv::Mat processed = prepareImage(input);
+
+    // The lungs are large structures, a reduced copy is enough to find them
+    constexpr int WORKING_SIZE = 512;
+    const double scale = std::min(1.0, WORKING_SIZE / static_cast<double>(std::max(processed.cols, processed.rows)));
+    cv::Mat small;
+    if (scale < 1.0) {
+        cv::resize(processed, small, cv::Size(), scale, scale, cv::INTER_AREA);
+    } else {
+        small = processed;
+    }
+    cv::GaussianBlur(small, small, cv::Size(5, 5), 0);
+
+    cv::Mat dark;
+    cv::threshold(small, dark, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+
+    // Air around the body is connected to the border, the lungs are not
+    cv::Mat labels, stats, centroids;
+    int count = cv::connectedComponentsWithStats(dark, labels, stats, centroids, 8, CV_32S);
+    const int minArea = static_cast<int>(0.01 * small.total());
+    std::vector<std::pair<int, int>> candidates;   // (area, label)
+    for (int label = 1; label < count; ++label) {
+        int x = stats.at<int>(label, cv::CC_STAT_LEFT);
+        int y = stats.at<int>(label, cv::CC_STAT_TOP);
+        int width = stats.at<int>(label, cv::CC_STAT_WIDTH);
+        int height = stats.at<int>(label, cv::CC_STAT_HEIGHT);
+        int area = stats.at<int>(label, cv::CC_STAT_AREA);
+        bool touchesBorder = x == 0 || y == 0 || x + width == small.cols || y + height == small.rows;
+        if (!touchesBorder && area >= minArea) {
+            candidates.emplace_back(area, label);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), std::greater<>());
+    if (candidates.size() > 2) candidates.resize(2);
+
+    cv::Mat mask = cv::Mat::zeros(small.size(), CV_8UC1);
+    for (const auto& candidate : candidates) {
+        mask.setTo(255, labels == candidate.second);
+    }
+
+    // Vessels and the hila leave holes in the threshold
+    if (!candidates.empty()) {
+        int closeSize = std::max(3, small.cols / 32) | 1;
+        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(closeSize, closeSize));
+        cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, kernel);
+    }
+
+    if (mask.size() != input.size()) {
+        cv::resize(mask, mask, input.size(), 0, 0, cv::INTER_NEAREST);
+    }
+    return mask;
+}
+
+cv::Rect Segmentation::maskBounds(const cv::Mat& mask, int margin) {
+    if (mask.empty()) return cv::Rect();
+
+    cv::Rect bounds = cv::boundingRect(mask);
+    if (bounds.empty()) return cv::Rect();
+
+    margin = std::max(margin, 0);
+    bounds.x -= margin;
+    bounds.y -= margin;
+    bounds.width += 2 * margin;
+    bounds.height += 2 * margin;
+    return bounds & cv::Rect(0, 0, mask.cols, mask.rows);
+}
+
 cv::Mat Segmentation::drawSegmentation(const cv::Mat& input, const cv::Mat& mask, double alpha) {
     cv::Mat result;
+
+    // Red overlay for segmentation, blended per plane: blue and green fade
+    // towards 0 and red towards 255 under the mask
+    if (input.depth() == CV_8U && (input.channels() == 1 || input.channels() == 3) &&
+        mask.type() == CV_8UC1 && mask.size() == input.size()) {
+        std::vector<cv::Mat> planes;
+        if (input.channels() == 1) {
+            cv::Mat faded, red;
+            blendMasked(input, mask, 0, alpha, faded);
+            blendMasked(input, mask, 255, alpha, red);
+            planes = {faded, faded, red};
+        } else {
+            cv::split(input, planes);
+            for (int c = 0; c < 3; ++c) {
+                blendMasked(planes[c], mask, c == 2 ? 255 : 0, alpha, planes[c]);
+            }
+        }
+        cv::merge(planes, result);
+        return result;
+    }
+
     if (input.channels() == 1) {
         cv::cvtColor(input, result, cv::COLOR_GRAY2BGR);
     } else {
@@ -279,4 +396,12 @@ cv::Mat Segmentation::drawSegmentation(const cv::Mat& input, const cv::Mat& mask
     return result;
 }
 
+bool Segmentation::saveMask(const cv::Mat& mask, const std::string& filepath) {
+    if (mask.empty()) return false;
+    if (isCacheImagePath(filepath)) {
+        return writeCacheImage(filepath, mask, CacheCompression::MASK_RLE);
+    }
+    return cv::imwrite(filepath, mask);
+}
+
 } // namespace medical_vision
\ No newline at end of file
@@ -0,0 +1,218 @@
+/**
+ * @file session_log.cpp
+ * @brief Implementation of the session log format
+ */
+
+#include "../include/medical_vision/session_log.hpp"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace medical_vision {
+
+namespace {
+
+// File layout: magic, version, then one record per event.
+// Values are written in host byte order.
+const char SESSION_MAGIC[4] = {'M', 'V', 'S', 'L'};
+constexpr uint32_t SESSION_VERSION = 1;
+
+double nowSeconds() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+void writeValue(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readValue(std::istream& in) {
+    T value{};
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (!in) {
+        throw std::runtime_error("Truncated session log");
+    }
+    return value;
+}
+
+// Enums are stored as a single byte
+template <typename E>
+void writeEnum(std::ostream& out, E value) {
+    writeValue<uint8_t>(out, static_cast<uint8_t>(value));
+}
+
+template <typename E>
+E readEnum(std::istream& in) {
+    return static_cast<E>(readValue<uint8_t>(in));
+}
+
+void writeSettings(std::ostream& out, const SessionSettings& s) {
+    uint8_t flags = (s.denoiseEnabled      ? 1u  : 0u)
+                  | (s.claheEnabled        ? 2u  : 0u)
+                  | (s.sharpenEnabled      ? 4u  : 0u)
+                  | (s.edgesEnabled        ? 8u  : 0u)
+                  | (s.keypointsEnabled    ? 16u : 0u)
+                  | (s.segmentationEnabled ? 32u : 0u)
+                  | (s.edgeParams.L2gradient ? 64u : 0u);
+    writeValue<uint8_t>(out, flags);
+
+    writeEnum(out, s.denoiseMethod);
+    writeValue<float>(out, static_cast<float>(s.sharpenStrength));
+
+    writeEnum(out, s.edgeMethod);
+    writeValue<float>(out, static_cast<float>(s.edgeParams.threshold1));
+    writeValue<float>(out, static_cast<float>(s.edgeParams.threshold2));
+    writeValue<int32_t>(out, s.edgeParams.apertureSize);
+
+    writeEnum(out, s.keypointMethod);
+    writeValue<int32_t>(out, s.keypointParams.maxKeypoints);
+    writeValue<float>(out, s.keypointParams.scaleFactor);
+    writeValue<int32_t>(out, s.keypointParams.nlevels);
+    writeValue<int32_t>(out, s.keypointParams.edgeThreshold);
+    writeValue<int32_t>(out, s.keypointParams.fastThreshold);
+
+    writeEnum(out, s.segmentationMethod);
+}
+
+SessionSettings readSettings(std::istream& in) {
+    SessionSettings s;
+    uint8_t flags = readValue<uint8_t>(in);
+    s.denoiseEnabled      = flags & 1u;
+    s.claheEnabled        = flags & 2u;
+    s.sharpenEnabled      = flags & 4u;
+    s.edgesEnabled        = flags & 8u;
+    s.keypointsEnabled    = flags & 16u;
+    s.segmentationEnabled = flags & 32u;
+    s.edgeParams.L2gradient = flags & 64u;
+
+    s.denoiseMethod = readEnum<ImagePreprocessor::NoiseReductionMethod>(in);
+    s.sharpenStrength = readValue<float>(in);
+
+    s.edgeMethod = readEnum<FeatureDetector::EdgeDetector>(in);
+    s.edgeParams.threshold1 = readValue<float>(in);
+    s.edgeParams.threshold2 = readValue<float>(in);
+    s.edgeParams.apertureSize = readValue<int32_t>(in);
+
+    s.keypointMethod = readEnum<FeatureDetector::KeypointDetector>(in);
+    s.keypointParams.maxKeypoints = readValue<int32_t>(in);
+    s.keypointParams.scaleFactor = readValue<float>(in);
+    s.keypointParams.nlevels = readValue<int32_t>(in);
+    s.keypointParams.edgeThreshold = readValue<int32_t>(in);
+    s.keypointParams.fastThreshold = readValue<int32_t>(in);
+
+    s.segmentationMethod = readEnum<Segmentation::Method>(in);
+    return s;
+}
+
+} // namespace
+
+const char* sessionStageName(SessionStage stage) {
+    switch (stage) {
+        case SessionStage::LOAD:         return "load";
+        case SessionStage::DENOISE:      return "denoise";
+        case SessionStage::CLAHE:        return "clahe";
+        case SessionStage::SHARPEN:      return "sharpen";
+        case SessionStage::EDGES:        return "edges";
+        case SessionStage::KEYPOINTS:    return "keypoints";
+        case SessionStage::SEGMENTATION: return "segmentation";
+        default:                         return "unknown";
+    }
+}
+
+// ---------- SessionRecorder ----------
+
+bool SessionRecorder::open(const std::string& filepath) {
+    close();
+    file_.open(filepath, std::ios::binary | std::ios::trunc);
+    if (!file_) return false;
+
+    file_.write(SESSION_MAGIC, sizeof(SESSION_MAGIC));
+    writeValue<uint32_t>(file_, SESSION_VERSION);
+    startTime_ = nowSeconds();
+    return static_cast<bool>(file_);
+}
+
+void SessionRecorder::close() {
+    if (file_.is_open()) {
+        file_.close();
+    }
+}
+
+void SessionRecorder::record(SessionEvent event) {
+    if (!file_.is_open()) return;
+
+    event.timestamp = nowSeconds() - startTime_;
+
+    writeEnum(file_, event.type);
+    writeValue<double>(file_, event.timestamp);
+
+    if (event.type == SessionEvent::Type::NAVIGATION) {
+        writeValue<uint32_t>(file_, static_cast<uint32_t>(event.imagePath.size()));
+        file_.write(event.imagePath.data(), event.imagePath.size());
+    } else {
+        writeSettings(file_, event.settings);
+    }
+
+    writeValue<uint8_t>(file_, static_cast<uint8_t>(event.stageTimes.size()));
+    for (float ms : event.stageTimes) {
+        writeValue<float>(file_, ms);
+    }
+
+    // Keep the log usable if the application crashes
+    file_.flush();
+}
+
+// ---------- Reading ----------
+
+std::vector<SessionEvent> readSessionLog(const std::string& filepath) {
+    std::ifstream in(filepath, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open session log: " + filepath);
+    }
+
+    char magic[4];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, SESSION_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not a session log: " + filepath);
+    }
+    if (readValue<uint32_t>(in) != SESSION_VERSION) {
+        throw std::runtime_error("Unsupported session log version");
+    }
+
+    std::vector<SessionEvent> events;
+    while (in.peek() != std::char_traits<char>::eof()) {
+        SessionEvent event;
+        event.type = readEnum<SessionEvent::Type>(in);
+        event.timestamp = readValue<double>(in);
+
+        if (event.type == SessionEvent::Type::NAVIGATION) {
+            uint32_t length = readValue<uint32_t>(in);
+            event.imagePath.resize(length);
+            in.read(&event.imagePath[0], length);
+        } else if (event.type == SessionEvent::Type::SETTINGS) {
+            event.settings = readSettings(in);
+        } else {
+            throw std::runtime_error("Corrupted session log");
+        }
+
+        // Stage count is stored so newer stages can be skipped by older readers
+        uint8_t stages = readValue<uint8_t>(in);
+        for (uint8_t i = 0; i < stages; ++i) {
+            float ms = readValue<float>(in);
+            if (i < event.stageTimes.size()) {
+                event.stageTimes[i] = ms;
+            }
+        }
+
+        if (!in) {
+            throw std::runtime_error("Truncated session log");
+        }
+        events.push_back(std::move(event));
+    }
+
+    return events;
+}
+
+} // namespace medical_vision
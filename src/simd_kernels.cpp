@@ -0,0 +1,308 @@
+/**
+ * @file simd_kernels.cpp
+ * @brief Scalar, SSE4.2, AVX2 and AVX-512 variants of the SIMD kernels
+ */
+
+#include "../include/medical_vision/simd_kernels.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#if MEDICAL_VISION_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#if MEDICAL_VISION_X86_KERNELS && !defined(_MSC_VER)
+#define MV_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MV_TARGET(isa)
+#endif
+
+namespace medical_vision {
+
+namespace {
+
+// Rows per task when a kernel runs over an image
+constexpr int ROW_GRAIN = 32;
+
+// up and down point at row itself on the first and last rows, which
+// leaves the result unchanged and so ignores pixels outside the image
+using MorphRowFn = void (*)(const uchar* up, const uchar* row, const uchar* down,
+                            uchar* dst, int width);
+
+// dst = mask ? (src * (256 - weight) + offset) >> 8 : src
+using BlendRowFn = void (*)(const uchar* src, const uchar* mask, uchar* dst,
+                            int width, int weight, int offset);
+
+struct Kernels {
+    MorphRowFn erodeRow;
+    MorphRowFn dilateRow;
+    BlendRowFn blendRow;
+};
+
+// ---------- Scalar ----------
+
+template <bool DILATE>
+inline uchar combine(uchar a, uchar b) {
+    return DILATE ? std::max(a, b) : std::min(a, b);
+}
+
+template <bool DILATE>
+inline void morphPixels(const uchar* up, const uchar* row, const uchar* down,
+                        uchar* dst, int begin, int end, int width) {
+    for (int x = begin; x < end; ++x) {
+        uchar value = combine<DILATE>(row[x], combine<DILATE>(up[x], down[x]));
+        if (x > 0) value = combine<DILATE>(value, row[x - 1]);
+        if (x + 1 < width) value = combine<DILATE>(value, row[x + 1]);
+        dst[x] = value;
+    }
+}
+
+template <bool DILATE>
+void morphRowScalar(const uchar* up, const uchar* row, const uchar* down, uchar* dst, int width) {
+    morphPixels<DILATE>(up, row, down, dst, 0, width, width);
+}
+
+inline void blendPixels(const uchar* src, const uchar* mask, uchar* dst,
+                        int begin, int end, int weight, int offset) {
+    for (int x = begin; x < end; ++x) {
+        dst[x] = mask[x] ? static_cast<uchar>((src[x] * (256 - weight) + offset) >> 8) : src[x];
+    }
+}
+
+void blendRowScalar(const uchar* src, const uchar* mask, uchar* dst,
+                    int width, int weight, int offset) {
+    blendPixels(src, mask, dst, 0, width, weight, offset);
+}
+
+constexpr Kernels SCALAR_KERNELS = {
+    morphRowScalar<false>, morphRowScalar<true>, blendRowScalar
+};
+
+#if MEDICAL_VISION_X86_KERNELS
+
+// ---------- SSE4.2 ----------
+
+template <bool DILATE>
+MV_TARGET("sse4.2")
+void morphRowSse42(const uchar* up, const uchar* row, const uchar* down, uchar* dst, int width) {
+    // Interior pixels have both horizontal neighbours
+    int x = 1;
+    for (; x + 17 <= width; x += 16) {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 1));
+        __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 1));
+        __m128i above = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+        __m128i below = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x));
+        if (DILATE) {
+            value = _mm_max_epu8(_mm_max_epu8(value, left), _mm_max_epu8(right, _mm_max_epu8(above, below)));
+        } else {
+            value = _mm_min_epu8(_mm_min_epu8(value, left), _mm_min_epu8(right, _mm_min_epu8(above, below)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), value);
+    }
+    morphPixels<DILATE>(up, row, down, dst, 0, std::min(1, width), width);
+    morphPixels<DILATE>(up, row, down, dst, std::max(x, 1), width, width);
+}
+
+MV_TARGET("sse4.2")
+void blendRowSse42(const uchar* src, const uchar* mask, uchar* dst,
+                   int width, int weight, int offset) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i inverse = _mm_set1_epi16(static_cast<short>(256 - weight));
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(offset));
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i selected = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + x));
+        __m128i low = _mm_unpacklo_epi8(pixels, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels, zero);
+        low = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(low, inverse), bias), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(high, inverse), bias), 8);
+        __m128i blended = _mm_packus_epi16(low, high);
+        __m128i outside = _mm_cmpeq_epi8(selected, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_blendv_epi8(blended, pixels, outside));
+    }
+    blendPixels(src, mask, dst, x, width, weight, offset);
+}
+
+constexpr Kernels SSE42_KERNELS = {
+    morphRowSse42<false>, morphRowSse42<true>, blendRowSse42
+};
+
+// ---------- AVX2 ----------
+
+template <bool DILATE>
+MV_TARGET("avx2")
+void morphRowAvx2(const uchar* up, const uchar* row, const uchar* down, uchar* dst, int width) {
+    int x = 1;
+    for (; x + 33 <= width; x += 32) {
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 1));
+        __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 1));
+        __m256i above = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x));
+        __m256i below = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x));
+        if (DILATE) {
+            value = _mm256_max_epu8(_mm256_max_epu8(value, left),
+                                    _mm256_max_epu8(right, _mm256_max_epu8(above, below)));
+        } else {
+            value = _mm256_min_epu8(_mm256_min_epu8(value, left),
+                                    _mm256_min_epu8(right, _mm256_min_epu8(above, below)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), value);
+    }
+    morphPixels<DILATE>(up, row, down, dst, 0, std::min(1, width), width);
+    morphPixels<DILATE>(up, row, down, dst, std::max(x, 1), width, width);
+}
+
+MV_TARGET("avx2")
+void blendRowAvx2(const uchar* src, const uchar* mask, uchar* dst,
+                  int width, int weight, int offset) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i inverse = _mm256_set1_epi16(static_cast<short>(256 - weight));
+    const __m256i bias = _mm256_set1_epi16(static_cast<short>(offset));
+
+    // Unpacking and packing both work within 128-bit lanes, so the
+    // byte order comes out unchanged
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i selected = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + x));
+        __m256i low = _mm256_unpacklo_epi8(pixels, zero);
+        __m256i high = _mm256_unpackhi_epi8(pixels, zero);
+        low = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(low, inverse), bias), 8);
+        high = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(high, inverse), bias), 8);
+        __m256i blended = _mm256_packus_epi16(low, high);
+        __m256i outside = _mm256_cmpeq_epi8(selected, zero);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                            _mm256_blendv_epi8(blended, pixels, outside));
+    }
+    blendPixels(src, mask, dst, x, width, weight, offset);
+}
+
+constexpr Kernels AVX2_KERNELS = {
+    morphRowAvx2<false>, morphRowAvx2<true>, blendRowAvx2
+};
+
+// ---------- AVX-512 ----------
+
+template <bool DILATE>
+MV_TARGET("avx512f,avx512bw")
+void morphRowAvx512(const uchar* up, const uchar* row, const uchar* down, uchar* dst, int width) {
+    int x = 1;
+    for (; x + 65 <= width; x += 64) {
+        __m512i value = _mm512_loadu_si512(row + x);
+        __m512i left = _mm512_loadu_si512(row + x - 1);
+        __m512i right = _mm512_loadu_si512(row + x + 1);
+        __m512i above = _mm512_loadu_si512(up + x);
+        __m512i below = _mm512_loadu_si512(down + x);
+        if (DILATE) {
+            value = _mm512_max_epu8(_mm512_max_epu8(value, left),
+                                    _mm512_max_epu8(right, _mm512_max_epu8(above, below)));
+        } else {
+            value = _mm512_min_epu8(_mm512_min_epu8(value, left),
+                                    _mm512_min_epu8(right, _mm512_min_epu8(above, below)));
+        }
+        _mm512_storeu_si512(dst + x, value);
+    }
+    morphPixels<DILATE>(up, row, down, dst, 0, std::min(1, width), width);
+    morphPixels<DILATE>(up, row, down, dst, std::max(x, 1), width, width);
+}
+
+MV_TARGET("avx512f,avx512bw")
+void blendRowAvx512(const uchar* src, const uchar* mask, uchar* dst,
+                    int width, int weight, int offset) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i inverse = _mm512_set1_epi16(static_cast<short>(256 - weight));
+    const __m512i bias = _mm512_set1_epi16(static_cast<short>(offset));
+
+    int x = 0;
+    for (; x + 64 <= width; x += 64) {
+        __m512i pixels = _mm512_loadu_si512(src + x);
+        __m512i selected = _mm512_loadu_si512(mask + x);
+        __m512i low = _mm512_unpacklo_epi8(pixels, zero);
+        __m512i high = _mm512_unpackhi_epi8(pixels, zero);
+        low = _mm512_srli_epi16(_mm512_add_epi16(_mm512_mullo_epi16(low, inverse), bias), 8);
+        high = _mm512_srli_epi16(_mm512_add_epi16(_mm512_mullo_epi16(high, inverse), bias), 8);
+        __m512i blended = _mm512_packus_epi16(low, high);
+        __mmask64 inside = _mm512_test_epi8_mask(selected, selected);
+        _mm512_storeu_si512(dst + x, _mm512_mask_blend_epi8(inside, pixels, blended));
+    }
+    blendPixels(src, mask, dst, x, width, weight, offset);
+}
+
+constexpr Kernels AVX512_KERNELS = {
+    morphRowAvx512<false>, morphRowAvx512<true>, blendRowAvx512
+};
+
+#endif // MEDICAL_VISION_X86_KERNELS
+
+// ---------- Dispatch ----------
+
+const Kernels& kernels() {
+    switch (cpuLevel()) {
+#if MEDICAL_VISION_X86_KERNELS
+        case CpuLevel::AVX512: return AVX512_KERNELS;
+        case CpuLevel::AVX2: return AVX2_KERNELS;
+        case CpuLevel::SSE42: return SSE42_KERNELS;
+#endif
+        default: return SCALAR_KERNELS;
+    }
+}
+
+void morphCross3x3(const cv::Mat& src, cv::Mat& dst, bool dilate) {
+    if (src.type() != CV_8UC1) {
+        throw std::runtime_error("3x3 cross morphology needs an 8-bit single channel image");
+    }
+    if (src.empty()) {
+        dst.release();
+        return;
+    }
+
+    // Rows read their neighbours, so the result cannot overwrite src
+    cv::Mat result(src.size(), CV_8UC1);
+    MorphRowFn rowKernel = dilate ? kernels().dilateRow : kernels().erodeRow;
+    const int lastRow = src.rows - 1;
+
+    TaskScheduler::instance().parallelFor(0, src.rows, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const uchar* row = src.ptr<uchar>(y);
+            rowKernel(src.ptr<uchar>(std::max(y - 1, 0)), row,
+                      src.ptr<uchar>(std::min(y + 1, lastRow)), result.ptr<uchar>(y), src.cols);
+        }
+    }, ROW_GRAIN);
+
+    dst = result;
+}
+
+} // namespace
+
+void erodeCross3x3(const cv::Mat& src, cv::Mat& dst) {
+    morphCross3x3(src, dst, false);
+}
+
+void dilateCross3x3(const cv::Mat& src, cv::Mat& dst) {
+    morphCross3x3(src, dst, true);
+}
+
+void blendMasked(const cv::Mat& src, const cv::Mat& mask, uchar value, double alpha, cv::Mat& dst) {
+    if (src.type() != CV_8UC1 || mask.type() != CV_8UC1 || mask.size() != src.size()) {
+        throw std::runtime_error("Masked blending needs 8-bit single channel images of the same size");
+    }
+
+    const int weight = cvRound(std::min(std::max(alpha, 0.0), 1.0) * 256.0);
+    const int offset = value * weight + 128;
+    dst.create(src.size(), CV_8UC1);
+    BlendRowFn rowKernel = kernels().blendRow;
+
+    // Pixels only depend on themselves, so dst may alias src
+    TaskScheduler::instance().parallelFor(0, src.rows, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            rowKernel(src.ptr<uchar>(y), mask.ptr<uchar>(y), dst.ptr<uchar>(y),
+                      src.cols, weight, offset);
+        }
+    }, ROW_GRAIN);
+}
+
+} // namespace medical_vision
@@ -0,0 +1,234 @@
+/**
+ * @file static_pipeline.cpp
+ * @brief Stages of compile-time pipelines
+ */
+
+#include "../include/medical_vision/static_pipeline.hpp"
+#include "../include/medical_vision/simd_kernels.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
+#include <cfloat>
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+namespace medical_vision {
+
+namespace {
+
+// Gray 8-bit view of an image, as Segmentation::prepareImage makes it
+void toGray8u(cv::Mat& image) {
+    if (image.channels() > 1) {
+        cv::cvtColor(image, image, cv::COLOR_BGR2GRAY);
+    }
+    if (image.type() != CV_8UC1) {
+        image.convertTo(image, CV_8UC1);
+    }
+}
+
+// Sizes ImagePreprocessor accepts, checked once instead of per image
+void checkKernelSize(int kernelSize) {
+    if (kernelSize <= 0 || kernelSize % 2 == 0) {
+        throw std::runtime_error("Kernel size must be odd and positive");
+    }
+}
+
+// Threshold cv::threshold picks with THRESH_OTSU, from the counts alone
+double otsuThreshold(const Histogram8u& histogram) {
+    int64_t total = 0;
+    for (int64_t count : histogram) total += count;
+    if (total == 0) return 0;
+
+    double mu = 0;
+    const double scale = 1.0 / static_cast<double>(total);
+    for (int i = 0; i < 256; ++i) {
+        mu += i * static_cast<double>(histogram[i]);
+    }
+    mu *= scale;
+
+    double mu1 = 0, q1 = 0;
+    double maxSigma = 0, maxValue = 0;
+    for (int i = 0; i < 256; ++i) {
+        double p = static_cast<double>(histogram[i]) * scale;
+        mu1 *= q1;
+        q1 += p;
+        double q2 = 1.0 - q1;
+        if (std::min(q1, q2) < FLT_EPSILON || std::max(q1, q2) > 1.0 - FLT_EPSILON) {
+            continue;
+        }
+        mu1 = (mu1 + i * p) / q1;
+        double mu2 = (mu - q1 * mu1) / q2;
+        double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+        if (sigma > maxSigma) {
+            maxSigma = sigma;
+            maxValue = i;
+        }
+    }
+    return maxValue;
+}
+
+} // namespace
+
+void countValues(const cv::Mat& image, Histogram8u& counts) {
+    CV_Assert(image.depth() == CV_8U);
+    counts.fill(0);
+
+    // Row stripes are counted in parallel and their counts summed
+    constexpr int STRIPE_ROWS = 64;
+    const int rowValues = image.cols * image.channels();
+    std::mutex countsMutex;
+    TaskScheduler::instance().parallelFor(0, image.rows, [&](int begin, int end) {
+        Histogram8u local{};
+        for (int y = begin; y < end; ++y) {
+            const uchar* row = image.ptr<uchar>(y);
+            for (int x = 0; x < rowValues; ++x) {
+                ++local[row[x]];
+            }
+        }
+        std::lock_guard<std::mutex> lock(countsMutex);
+        for (int value = 0; value < 256; ++value) {
+            counts[value] += local[value];
+        }
+    }, STRIPE_ROWS);
+}
+
+namespace stages {
+
+// ---------- Point Stages ----------
+// Tables are transformed with the same OpenCV calls the stages make on
+// images, so fused and unfused runs round identically.
+
+void Normalize::apply(cv::Mat& image) {
+    cv::normalize(image, image, minValue, maxValue, cv::NORM_MINMAX);
+}
+
+void Normalize::mapTable(const Histogram8u& histogram, cv::Mat& table) {
+    int low = 0, high = 255;
+    while (low < 255 && histogram[low] == 0) ++low;
+    while (high > 0 && histogram[high] == 0) --high;
+    if (low > high) return;     // No pixels
+
+    // Scale and shift as cv::normalize computes them for NORM_MINMAX
+    const double dmin = std::min(minValue, maxValue);
+    const double dmax = std::max(minValue, maxValue);
+    const double range = high - low;
+    const double scale = (dmax - dmin) * (range > DBL_EPSILON ? 1.0 / range : 0);
+    table.convertTo(table, -1, scale, dmin - low * scale);
+}
+
+void Contrast::apply(cv::Mat& image) {
+    image.convertTo(image, -1, alpha, beta);
+}
+
+void Contrast::mapTable(const Histogram8u&, cv::Mat& table) {
+    table.convertTo(table, -1, alpha, beta);
+}
+
+void Threshold::apply(cv::Mat& image) {
+    toGray8u(image);
+    cv::threshold(image, image, value, maxValue, invert ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY);
+}
+
+void Threshold::mapTable(const Histogram8u&, cv::Mat& table) {
+    cv::threshold(table, table, value, maxValue, invert ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY);
+}
+
+void Otsu::apply(cv::Mat& image) {
+    toGray8u(image);
+    cv::threshold(image, image, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+}
+
+void Otsu::mapTable(const Histogram8u& histogram, cv::Mat& table) {
+    cv::threshold(table, table, otsuThreshold(histogram), 255, cv::THRESH_BINARY);
+}
+
+// ---------- Filter Stages ----------
+
+void Clahe::apply(cv::Mat& image) {
+    if (!equalizer_) {
+        equalizer_ = cv::createCLAHE(clipLimit, tileGridSize);
+    } else {
+        equalizer_->setClipLimit(clipLimit);
+        equalizer_->setTilesGridSize(tileGridSize);
+    }
+
+    if (image.channels() == 1) {
+        equalizer_->apply(image, image);
+    } else {
+        cv::cvtColor(image, lab_, cv::COLOR_BGR2Lab);
+        cv::split(lab_, planes_);
+        equalizer_->apply(planes_[0], planes_[0]);
+        cv::merge(planes_, lab_);
+        cv::cvtColor(lab_, image, cv::COLOR_Lab2BGR);
+    }
+}
+
+void Sharpen::apply(cv::Mat& image) {
+    if (kernel_.empty() || kernelStrength_ != strength) {
+        kernel_ = (cv::Mat_<float>(3, 3) <<
+            -1, -1, -1,
+            -1,  9, -1,
+            -1, -1, -1);
+        kernel_ *= strength;
+        kernelStrength_ = strength;
+    }
+
+    if (image.channels() == 1) {
+        cv::filter2D(image, image, -1, kernel_);
+    } else {
+        cv::split(image, planes_);
+        for (auto& plane : planes_) {
+            cv::filter2D(plane, plane, -1, kernel_);
+        }
+        cv::merge(planes_, image);
+    }
+}
+
+void UnsharpMask::apply(cv::Mat& image) {
+    if (image.channels() == 1) {
+        cv::GaussianBlur(image, blurred_, cv::Size(), sigma);
+        cv::addWeighted(image, 1.0 + strength, blurred_, -strength, 0, image);
+    } else {
+        cv::split(image, planes_);
+        for (auto& plane : planes_) {
+            cv::GaussianBlur(plane, blurred_, cv::Size(), sigma);
+            cv::addWeighted(plane, 1.0 + strength, blurred_, -strength, 0, plane);
+        }
+        cv::merge(planes_, image);
+    }
+}
+
+GaussianBlur::GaussianBlur(int kernelSize, double sigma) : kernelSize(kernelSize), sigma(sigma) {
+    checkKernelSize(kernelSize);
+}
+
+void GaussianBlur::apply(cv::Mat& image) {
+    cv::GaussianBlur(image, image, cv::Size(kernelSize, kernelSize), sigma);
+}
+
+MedianBlur::MedianBlur(int kernelSize) : kernelSize(kernelSize) {
+    checkKernelSize(kernelSize);
+}
+
+void MedianBlur::apply(cv::Mat& image) {
+    cv::medianBlur(image, image, kernelSize);
+}
+
+void CleanMask::apply(cv::Mat& image) {
+    if (image.type() != CV_8UC1) {
+        image.convertTo(image, CV_8UC1);
+    }
+    if (image.channels() == 1) {
+        erodeCross3x3(image, image);
+        dilateCross3x3(image, image);
+        dilateCross3x3(image, image);
+        erodeCross3x3(image, image);
+    } else {
+        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
+        cv::morphologyEx(image, image, cv::MORPH_OPEN, kernel);
+        cv::morphologyEx(image, image, cv::MORPH_CLOSE, kernel);
+    }
+}
+
+} // namespace stages
+
+} // namespace medical_vision
@@ -0,0 +1,355 @@
+/**
+ * @file task_scheduler.cpp
+ * @brief Implementation of the work-stealing scheduler
+ */
+
+#include "../include/medical_vision/task_scheduler.hpp"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#if __has_include(<opencv2/core/parallel/parallel_backend.hpp>)
+#include <opencv2/core/parallel/parallel_backend.hpp>
+#define MEDICAL_VISION_OPENCV_BACKEND 1
+#endif
+
+namespace medical_vision {
+
+namespace {
+
+thread_local const TaskScheduler* currentScheduler = nullptr;
+thread_local int currentIndex = -1;
+
+// Chunks per thread in parallelFor, a few more than one to balance uneven work
+constexpr int CHUNKS_PER_THREAD = 4;
+
+int resolveThreadCount(int threadCount) {
+    if (threadCount >= 0) return threadCount;
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+#ifdef MEDICAL_VISION_OPENCV_BACKEND
+// Runs OpenCV's parallel loops on the scheduler. OpenCV counts the calling
+// thread, so it sees one more thread than there are workers.
+class OpenCVBackend : public cv::parallel::ParallelForAPI {
+public:
+    explicit OpenCVBackend(TaskScheduler& scheduler) : scheduler_(scheduler) {}
+
+    void parallel_for(int tasks, FN_parallel_for_body_cb_t body, void* data) override {
+        scheduler_.parallelFor(0, tasks, [body, data](int begin, int end) {
+            body(begin, end, data);
+        });
+    }
+
+    int getThreadNum() const override {
+        return scheduler_.currentWorker() + 1;
+    }
+
+    int getNumThreads() const override {
+        return scheduler_.threadCount() + 1;
+    }
+
+    int setNumThreads(int threadCount) override {
+        // 0 disables OpenCV threading, one worker stays for async tasks
+        int workers = threadCount < 0 ? resolveThreadCount(-1) - 1 : threadCount - 1;
+        scheduler_.setThreadCount(std::max(1, workers));
+        return getNumThreads();
+    }
+
+    const char* getName() const override {
+        return "medical_vision";
+    }
+
+private:
+    TaskScheduler& scheduler_;
+};
+#endif
+
+} // namespace
+
+// ---------- TaskScheduler ----------
+
+TaskScheduler::TaskScheduler(int threadCount) {
+    threadCount = resolveThreadCount(threadCount);
+    resizeQueues(threadCount);
+    startThreads(threadCount);
+}
+
+TaskScheduler::~TaskScheduler() {
+    std::lock_guard<std::mutex> control(controlMutex_);
+    stopThreads();
+
+    // Nothing may be left waiting on a task that will never run
+    while (runPendingTask()) {}
+}
+
+TaskScheduler& TaskScheduler::instance() {
+    // Never destroyed: OpenCV may still use it as its backend during exit
+    static TaskScheduler* scheduler = []() {
+        auto* created = new TaskScheduler(std::max(1, cv::getNumThreads() - 1));
+#ifdef MEDICAL_VISION_OPENCV_BACKEND
+        cv::parallel::setParallelForBackend(std::make_shared<OpenCVBackend>(*created), false);
+#endif
+        return created;
+    }();
+    return *scheduler;
+}
+
+void TaskScheduler::submit(Task task) {
+    {
+        std::shared_lock<std::shared_mutex> queues(queuesMutex_);
+        int index = currentWorker();
+        size_t target = index >= 0 && static_cast<size_t>(index) < workers_.size()
+            ? static_cast<size_t>(index)
+            : nextQueue_++ % workers_.size();
+        std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+        workers_[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        ++pendingTasks_;
+    }
+    wake_.notify_one();
+}
+
+void TaskScheduler::parallelFor(int begin, int end,
+                                const std::function<void(int, int)>& body, int grain) {
+    if (end <= begin) return;
+
+    const int count = end - begin;
+    const int maxChunks = (threadCount() + 1) * CHUNKS_PER_THREAD;
+    const int chunks = std::min(maxChunks, std::max(1, count / std::max(grain, 1)));
+    if (chunks == 1) {
+        body(begin, end);
+        return;
+    }
+
+    auto chunkBegin = [&](int chunk) {
+        return begin + static_cast<int>(static_cast<long long>(count) * chunk / chunks);
+    };
+
+    TaskGroup group(*this);
+    for (int chunk = 1; chunk < chunks; ++chunk) {
+        int first = chunkBegin(chunk);
+        int last = chunkBegin(chunk + 1);
+        group.run([&body, first, last]() { body(first, last); });
+    }
+
+    // The caller takes the first chunk, then helps with the rest
+    std::exception_ptr error;
+    try {
+        body(begin, chunkBegin(1));
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    try {
+        group.wait();
+    }
+    catch (...) {
+        if (!error) error = std::current_exception();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool TaskScheduler::runPendingTask() {
+    Task task;
+    {
+        std::shared_lock<std::shared_mutex> queues(queuesMutex_);
+        if (!takeTask(currentWorker(), task)) return false;
+    }
+    task();
+    return true;
+}
+
+void TaskScheduler::setThreadCount(int threadCount) {
+    if (currentWorker() >= 0) {
+        throw std::logic_error("TaskScheduler cannot be resized from one of its workers");
+    }
+    threadCount = resolveThreadCount(threadCount);
+
+    std::lock_guard<std::mutex> control(controlMutex_);
+    if (threadCount == threadCount_.load()) return;
+    stopThreads();
+    resizeQueues(threadCount);
+    startThreads(threadCount);
+}
+
+int TaskScheduler::threadCount() const {
+    return threadCount_.load();
+}
+
+int TaskScheduler::currentWorker() const {
+    return currentScheduler == this ? currentIndex : -1;
+}
+
+void TaskScheduler::resizeQueues(int threadCount) {
+    std::unique_lock<std::shared_mutex> queues(queuesMutex_);
+
+    std::vector<Task> queued;
+    for (auto& worker : workers_) {
+        for (auto& task : worker->tasks) queued.push_back(std::move(task));
+    }
+
+    // One deque at least, so tasks can be queued and helped with
+    // even when no worker runs them
+    workers_.clear();
+    for (int i = 0; i < std::max(1, threadCount); ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < queued.size(); ++i) {
+        workers_[i % workers_.size()]->tasks.push_back(std::move(queued[i]));
+    }
+}
+
+// Called with controlMutex_ held
+void TaskScheduler::startThreads(int threadCount) {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        running_ = true;
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        threads_.emplace_back([this, i]() { workerLoop(i); });
+    }
+    threadCount_ = threadCount;
+}
+
+// Called with controlMutex_ held, running tasks finish first
+void TaskScheduler::stopThreads() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        running_ = false;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    threadCount_ = 0;
+}
+
+void TaskScheduler::workerLoop(int index) {
+    currentScheduler = this;
+    currentIndex = index;
+
+    while (true) {
+        Task task;
+        bool found;
+        {
+            std::shared_lock<std::shared_mutex> queues(queuesMutex_);
+            found = takeTask(index, task);
+        }
+        if (found) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this]() { return pendingTasks_ > 0 || !running_; });
+        if (!running_) break;
+    }
+
+    currentScheduler = nullptr;
+    currentIndex = -1;
+}
+
+// Own deque from the back, then steal from the front of the others.
+// Called with queuesMutex_ held.
+bool TaskScheduler::takeTask(int index, Task& task) {
+    const size_t count = workers_.size();
+    const bool ownsQueue = index >= 0 && static_cast<size_t>(index) < count;
+    const size_t start = ownsQueue ? static_cast<size_t>(index) + 1 : nextQueue_.load();
+    bool found = false;
+
+    if (ownsQueue) {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+
+    for (size_t k = 0; k < count && !found; ++k) {
+        Worker& victim = *workers_[(start + k) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+
+    if (found) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        --pendingTasks_;
+    }
+    return found;
+}
+
+// ---------- TaskGroup ----------
+
+TaskGroup::TaskGroup(TaskScheduler& scheduler)
+    : scheduler_(scheduler), state_(std::make_shared<State>()) {}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    }
+    catch (...) {
+        // Errors are only reported through an explicit wait()
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        ++state_->pending;
+    }
+
+    std::shared_ptr<State> state = state_;
+    scheduler_.submit([state, task = std::move(task)]() {
+        try {
+            task();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!state->error) state->error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (--state->pending == 0) {
+            state->done.notify_all();
+        }
+    });
+}
+
+void TaskGroup::wait() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (state_->pending == 0) break;
+        }
+
+        // Help instead of blocking, the awaited tasks may be queued behind us
+        if (scheduler_.runPendingTask()) continue;
+
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->done.wait_for(lock, std::chrono::microseconds(200),
+                              [this]() { return state_->pending == 0; });
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        std::swap(error, state_->error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace medical_vision
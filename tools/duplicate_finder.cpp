@@ -0,0 +1,221 @@
+/**
+ * @file duplicate_finder.cpp
+ * @brief Finds re-exports of the same film in an image archive
+ *
+ * Hashes every image under a folder in parallel (computeImageHashes),
+ * indexes the hashes in a DuplicateIndex and maps each image to the
+ * closest earlier representative, in path order, within --max-distance;
+ * images with none become representatives themselves. Groups are not
+ * chained, so every image is within the distance of its representative.
+ * The CSV output lists every image with its representative and their
+ * distance, so later runs can analyze the representatives only and reuse
+ * their results for the others.
+ *
+ * JPEG files are decoded at a quarter of their size, which leaves far
+ * more than the 32x32 pixels the hashes need.
+ *
+ * Usage: duplicate_finder [--data <dir>] [--max-distance <bits>]
+ *                         [--hash perceptual|difference] [--output <csv>]
+ */
+
+#include "../include/medical_vision/dicom_image.hpp"
+#include "../include/medical_vision/duplicate_index.hpp"
+#include "../include/medical_vision/image_cache.hpp"
+#include "../include/medical_vision/task_scheduler.hpp"
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using medical_vision::DuplicateIndex;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string dataDir = "data/test_samples";
+    int maxDistance = 6;
+    bool perceptual = true;
+    std::string outputPath;
+};
+
+double elapsedMs(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::string lowerExtension(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+// Decoded as the viewer shows it, at whatever resolution is cheapest
+cv::Mat loadForHashing(const std::string& path) {
+    const std::string extension = lowerExtension(path);
+    if (medical_vision::DicomImage::isDicomFile(path)) {
+        medical_vision::DicomImage dicom;
+        dicom.open(path);
+        return dicom.window();
+    }
+    if (medical_vision::isCacheImagePath(path)) {
+        return medical_vision::readCacheImage(path);
+    }
+    const bool isJpeg = extension == ".jpg" || extension == ".jpeg";
+    return cv::imread(path, isJpeg ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_UNCHANGED);
+}
+
+// Quote a path for a CSV field
+std::string csvField(const std::string& value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Usage: " << argv[0] << " [--data <dir>] [--max-distance <bits>]"
+                      << " [--hash perceptual|difference] [--output <csv>]" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--data") options.dataDir = value;
+        else if (option == "--max-distance") options.maxDistance = std::max(0, std::stoi(value));
+        else if (option == "--hash" && (value == "perceptual" || value == "difference")) {
+            options.perceptual = value == "perceptual";
+        }
+        else if (option == "--output") options.outputPath = value;
+        else {
+            std::cerr << "Unknown option: " << option << " " << value << std::endl;
+            return 1;
+        }
+    }
+
+    // Sorted so the first of a group is the same on every run
+    std::vector<std::string> files;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(options.dataDir, error);
+         !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (!it->is_regular_file(error)) continue;
+        const std::string extension = lowerExtension(it->path());
+        if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+            extension == ".tif" || extension == ".tiff" || extension == ".dcm" ||
+            extension == ".dicom" || extension == medical_vision::CACHE_IMAGE_EXTENSION) {
+            files.push_back(it->path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+        std::cerr << "No images found in " << options.dataDir << std::endl;
+        return 1;
+    }
+
+    // Decoding dominates, so files are hashed in parallel
+    auto start = Clock::now();
+    std::vector<uint64_t> hashes(files.size());
+    std::vector<char> readable(files.size(), 0);
+    medical_vision::TaskScheduler::instance().parallelFor(0, static_cast<int>(files.size()),
+        [&](int first, int last) {
+            for (int i = first; i < last; ++i) {
+                try {
+                    cv::Mat image = loadForHashing(files[i]);
+                    if (image.empty()) continue;
+                    auto imageHashes = medical_vision::computeImageHashes(image);
+                    hashes[i] = options.perceptual ? imageHashes.perceptual : imageHashes.difference;
+                    readable[i] = 1;
+                }
+                catch (const std::exception& e) {
+                    std::cerr << files[i] << ": " << e.what() << std::endl;
+                }
+            }
+        }, 16);
+    const double hashMs = elapsedMs(start, Clock::now());
+
+    // Index ids are the positions among readable files
+    start = Clock::now();
+    DuplicateIndex index;
+    std::vector<size_t> fileOf;
+    index.reserve(files.size());
+    fileOf.reserve(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (readable[i]) {
+            index.add(hashes[i]);
+            fileOf.push_back(i);
+        }
+    }
+    index.build();
+    const double buildMs = elapsedMs(start, Clock::now());
+
+    // Earlier images within the distance of each one, closest first;
+    // queries share the index read-only
+    start = Clock::now();
+    const int count = static_cast<int>(index.size());
+    std::vector<std::vector<int>> earlier(count);
+    medical_vision::TaskScheduler::instance().parallelFor(0, count, [&](int first, int last) {
+        for (int id = first; id < last; ++id) {
+            for (const auto& match : index.query(index.hash(id), options.maxDistance)) {
+                if (static_cast<int>(match.id) < id) {
+                    earlier[id].push_back(static_cast<int>(match.id));
+                }
+            }
+        }
+    }, 256);
+    const double queryMs = elapsedMs(start, Clock::now());
+
+    // Earlier images are resolved first; each image joins the closest
+    // earlier representative, never a member of its group, so groups do
+    // not grow past the distance by chaining
+    std::vector<int> representative(count);
+    size_t duplicates = 0;
+    for (int id = 0; id < count; ++id) {
+        representative[id] = id;
+        for (int candidate : earlier[id]) {
+            if (representative[candidate] == candidate) {
+                representative[id] = candidate;
+                ++duplicates;
+                break;
+            }
+        }
+    }
+
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            std::cerr << "Cannot write " << options.outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.outputPath.empty() ? std::cout : file;
+    out << "path,duplicate_of,distance\n";
+    for (int id = 0; id < count; ++id) {
+        out << csvField(files[fileOf[id]]) << ',';
+        if (representative[id] != id) {
+            out << csvField(files[fileOf[representative[id]]]) << ','
+                << medical_vision::hammingDistance(index.hash(id), index.hash(representative[id]));
+        } else {
+            out << ',';
+        }
+        out << '\n';
+    }
+
+    std::cerr << files.size() << " files, " << files.size() - count << " unreadable, "
+              << count - duplicates << " unique, " << duplicates << " near-duplicates\n"
+              << "hashing " << hashMs << " ms, index build " << buildMs << " ms, "
+              << (count > 0 ? queryMs * 1000.0 / count : 0.0) << " us per query" << std::endl;
+    return 0;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file inference_loadgen.cpp
+ * @brief Load generator for inference_server
+ *
+ * Runs closed-loop clients at increasing concurrency levels, each sending the
+ * same image repeatedly, and reports throughput against p50/p99 latency and
+ * the mean batch size chosen by the server.
+ *
+ * Usage: inference_loadgen --image <file> [--socket <path>] [--clients <max>]
+ *                          [--requests <per client>] [--shm 0|1]
+ */
+
+#include "inference_protocol.hpp"
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <csignal>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <vector>
+
+namespace protocol = medical_vision::protocol;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ClientStats {
+    std::vector<double> latenciesMs;
+    size_t batchSizeSum{0};
+    size_t failures{0};
+};
+
+int connectTo(const std::string& socketPath) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Read a response and skip its body, returns false on connection errors
+bool readResponse(int fd, protocol::ResponseHeader& header) {
+    if (!protocol::readFully(fd, &header, sizeof(header))) return false;
+    if (header.magic != protocol::RESPONSE_MAGIC) return false;
+
+    for (int i = 0; i < header.detectionCount; ++i) {
+        uint8_t length;
+        char skipped[255 + sizeof(float)];
+        if (!protocol::readFully(fd, &length, 1) ||
+            !protocol::readFully(fd, skipped, length + sizeof(float))) {
+            return false;
+        }
+    }
+    std::string error(header.errorLength, '\0');
+    return protocol::readFully(fd, &error[0], error.size());
+}
+
+void runClient(int clientIndex, const std::string& socketPath, const cv::Mat& image,
+               int requests, bool useSharedMemory, ClientStats& stats) {
+    int fd = connectTo(socketPath);
+    if (fd < 0) {
+        stats.failures += requests;
+        return;
+    }
+
+    const size_t imageBytes = image.total() * image.elemSize();
+    protocol::RequestHeader header;
+    header.rows = image.rows;
+    header.cols = image.cols;
+    header.channels = static_cast<uint16_t>(image.channels());
+
+    // With shared memory the image is written once and only its name is sent
+    std::string payload;
+    std::string shmName;
+    if (useSharedMemory) {
+        shmName = "/mv_loadgen_" + std::to_string(getpid()) + "_" + std::to_string(clientIndex);
+        int shmFd = shm_open(shmName.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+        void* mapping = MAP_FAILED;
+        if (shmFd >= 0 && ftruncate(shmFd, static_cast<off_t>(imageBytes)) == 0) {
+            mapping = mmap(nullptr, imageBytes, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+        }
+        if (shmFd >= 0) close(shmFd);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Cannot create shared memory " << shmName << std::endl;
+            shm_unlink(shmName.c_str());
+            close(fd);
+            stats.failures += requests;
+            return;
+        }
+        std::memcpy(mapping, image.data, imageBytes);
+        munmap(mapping, imageBytes);
+
+        header.type = static_cast<uint16_t>(protocol::RequestType::ANALYZE_SHARED_MEMORY);
+        payload = shmName;
+    } else {
+        header.type = static_cast<uint16_t>(protocol::RequestType::ANALYZE_INLINE);
+        payload.assign(reinterpret_cast<const char*>(image.data), imageBytes);
+    }
+    header.payloadSize = static_cast<uint32_t>(payload.size());
+
+    for (int i = 0; i < requests; ++i) {
+        header.requestId = static_cast<uint32_t>(i);
+        auto start = Clock::now();
+
+        protocol::ResponseHeader response;
+        if (!protocol::writeFully(fd, &header, sizeof(header)) ||
+            !protocol::writeFully(fd, payload.data(), payload.size()) ||
+            !readResponse(fd, response)) {
+            stats.failures += requests - i;
+            break;
+        }
+
+        auto end = Clock::now();
+        stats.latenciesMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        stats.batchSizeSum += response.batchSize;
+        if (!response.success) {
+            ++stats.failures;
+        }
+    }
+
+    if (!shmName.empty()) {
+        shm_unlink(shmName.c_str());
+    }
+    close(fd);
+}
+
+double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string socketPath = protocol::DEFAULT_SOCKET_PATH;
+    std::string imagePath;
+    int maxClients = 8;
+    int requests = 100;
+    bool useSharedMemory = true;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--image") imagePath = value;
+        else if (option == "--socket") socketPath = value;
+        else if (option == "--clients") maxClients = std::max(1, std::stoi(value));
+        else if (option == "--requests") requests = std::max(1, std::stoi(value));
+        else if (option == "--shm") useSharedMemory = value != "0";
+        else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+    if (imagePath.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --image <file> [--socket <path>] [--clients <max>]"
+                  << " [--requests <per client>] [--shm 0|1]" << std::endl;
+        return 1;
+    }
+
+    cv::Mat image = cv::imread(imagePath, cv::IMREAD_GRAYSCALE);
+    if (image.empty()) {
+        std::cerr << "Failed to load image: " << imagePath << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::printf("%8s %12s %10s %10s %10s %10s %9s\n",
+                "clients", "req/s", "mean ms", "p50 ms", "p99 ms", "batch", "failed");
+
+    // Concurrency doubles up to the requested maximum
+    for (int clients = 1; ; clients = std::min(clients * 2, maxClients)) {
+        std::vector<ClientStats> stats(clients);
+        std::vector<std::thread> threads;
+
+        auto start = Clock::now();
+        for (int c = 0; c < clients; ++c) {
+            threads.emplace_back(runClient, c, std::cref(socketPath), std::cref(image),
+                                 requests, useSharedMemory, std::ref(stats[c]));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<double> latencies;
+        size_t batchSizeSum = 0;
+        size_t failures = 0;
+        for (const auto& s : stats) {
+            latencies.insert(latencies.end(), s.latenciesMs.begin(), s.latenciesMs.end());
+            batchSizeSum += s.batchSizeSum;
+            failures += s.failures;
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        double mean = 0.0;
+        for (double l : latencies) mean += l;
+        mean = latencies.empty() ? 0.0 : mean / latencies.size();
+
+        std::printf("%8d %12.1f %10.2f %10.2f %10.2f %10.2f %9zu\n",
+                    clients, latencies.size() / seconds, mean,
+                    percentile(latencies, 0.50), percentile(latencies, 0.99),
+                    latencies.empty() ? 0.0 : batchSizeSum / static_cast<double>(latencies.size()),
+                    failures);
+
+        if (clients == maxClients) break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file inference_protocol.hpp
+ * @brief Wire format shared by inference_server and its clients
+ *
+ * Local-only protocol over a Unix domain socket, values in host byte order.
+ * A request is a RequestHeader followed by payloadSize bytes: either the
+ * tightly packed 8-bit pixels, or the name of a POSIX shared memory object
+ * holding them. A response is a ResponseHeader followed by detectionCount
+ * detections (uint8 name length, name, float confidence) and the error text.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+namespace medical_vision {
+namespace protocol {
+
+constexpr uint32_t REQUEST_MAGIC = 0x5249564D;   // "MVIR"
+constexpr uint32_t RESPONSE_MAGIC = 0x5349564D;  // "MVIS"
+constexpr const char* DEFAULT_SOCKET_PATH = "/tmp/medical_vision.sock";
+
+// Upper bound on inline payloads, larger images should use shared memory
+constexpr uint32_t MAX_PAYLOAD_SIZE = 256u * 1024u * 1024u;
+
+enum class RequestType : uint16_t {
+    ANALYZE_INLINE = 1,
+    ANALYZE_SHARED_MEMORY = 2
+};
+
+struct RequestHeader {
+    uint32_t magic{REQUEST_MAGIC};
+    uint32_t requestId{0};
+    uint16_t type{static_cast<uint16_t>(RequestType::ANALYZE_INLINE)};
+    uint16_t channels{1};
+    int32_t rows{0};
+    int32_t cols{0};
+    uint32_t payloadSize{0};
+};
+static_assert(sizeof(RequestHeader) == 24, "RequestHeader must stay packed");
+
+struct ResponseHeader {
+    uint32_t magic{RESPONSE_MAGIC};
+    uint32_t requestId{0};
+    uint8_t success{0};
+    uint8_t detectionCount{0};
+    uint16_t batchSize{0};       // Size of the batch the request ran in
+    float processingMs{0.0f};
+    uint32_t errorLength{0};
+};
+static_assert(sizeof(ResponseHeader) == 20, "ResponseHeader must stay packed");
+
+// Blocking helpers retrying on partial transfers and signals
+inline bool readFully(int fd, void* buffer, size_t size) {
+    auto* data = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+inline bool writeFully(int fd, const void* buffer, size_t size) {
+    const auto* data = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace protocol
+} // namespace medical_vision
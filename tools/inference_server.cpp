@@ -0,0 +1,257 @@
+/**
+ * @file inference_server.cpp
+ * @brief Daemon serving ChestXRayAnalyzer over a Unix domain socket
+ *
+ * Loads the model once and answers analyze requests from any number of local
+ * clients. Concurrent requests are grouped by BatchScheduler into batches
+ * that run as a single forward pass, scheduler metrics are printed every
+ * --stats-seconds. See inference_protocol.hpp for the format.
+ *
+ * Usage: inference_server --model <onnx> [--config <json>] [--socket <path>]
+ *                         [--max-batch <n>] [--max-wait-ms <ms>]
+ *                         [--latency-target-ms <ms>] [--stats-seconds <s>]
+ */
+
+#include "../include/medical_vision/batch_scheduler.hpp"
+#include "../include/medical_vision/buffer_pool.hpp"
+#include "inference_protocol.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <vector>
+
+using medical_vision::BatchScheduler;
+using medical_vision::BufferPool;
+using medical_vision::ChestXRayAnalyzer;
+namespace protocol = medical_vision::protocol;
+
+namespace {
+
+// One decoded request, owning the memory its image points into
+struct PendingRequest {
+    cv::Mat image;
+    std::vector<uchar> buffer;
+    void* mapping{nullptr};
+    size_t mappingSize{0};
+
+    ~PendingRequest() {
+        if (mapping) {
+            munmap(mapping, mappingSize);
+        }
+    }
+};
+
+// Fill request.image from the payload, returns an error message on failure
+std::string decodeRequest(const protocol::RequestHeader& header,
+                          std::vector<uchar> payload, PendingRequest& request) {
+    if (header.rows <= 0 || header.cols <= 0 ||
+        (header.channels != 1 && header.channels != 3)) {
+        return "Invalid image geometry";
+    }
+    const size_t imageBytes = static_cast<size_t>(header.rows) * header.cols * header.channels;
+    const int type = CV_8UC(header.channels);
+
+    if (header.type == static_cast<uint16_t>(protocol::RequestType::ANALYZE_INLINE)) {
+        if (payload.size() != imageBytes) return "Payload size does not match image";
+        request.buffer = std::move(payload);
+        request.image = cv::Mat(header.rows, header.cols, type, request.buffer.data());
+        return std::string();
+    }
+
+    if (header.type == static_cast<uint16_t>(protocol::RequestType::ANALYZE_SHARED_MEMORY)) {
+        // Pixels stay in the client's segment, mapped read-only without a copy
+        std::string name(payload.begin(), payload.end());
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return "Cannot open shared memory " + name;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < imageBytes) {
+            close(fd);
+            return "Shared memory smaller than image";
+        }
+        void* mapping = mmap(nullptr, imageBytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) return "Cannot map shared memory " + name;
+
+        request.mapping = mapping;
+        request.mappingSize = imageBytes;
+        request.image = cv::Mat(header.rows, header.cols, type, mapping);
+        return std::string();
+    }
+
+    return "Unknown request type";
+}
+
+bool sendResponse(int fd, uint32_t requestId, const BatchScheduler::Result& reply) {
+    const auto& result = reply.analysis;
+
+    protocol::ResponseHeader header;
+    header.requestId = requestId;
+    header.success = result.success ? 1 : 0;
+    header.detectionCount = static_cast<uint8_t>(std::min<size_t>(result.detections.size(), 255));
+    header.batchSize = static_cast<uint16_t>(reply.batchSize);
+    header.processingMs = static_cast<float>(result.processingTime * 1000.0);
+    header.errorLength = static_cast<uint32_t>(result.errorMessage.size());
+
+    std::string body;
+    for (size_t i = 0; i < header.detectionCount; ++i) {
+        const auto& detection = result.detections[i];
+        uint8_t length = static_cast<uint8_t>(std::min<size_t>(detection.pathology.size(), 255));
+        body.push_back(static_cast<char>(length));
+        body.append(detection.pathology, 0, length);
+        body.append(reinterpret_cast<const char*>(&detection.confidence), sizeof(float));
+    }
+    body += result.errorMessage;
+
+    return protocol::writeFully(fd, &header, sizeof(header)) &&
+           protocol::writeFully(fd, body.data(), body.size());
+}
+
+void serveConnection(int fd, BatchScheduler& scheduler) {
+    while (true) {
+        protocol::RequestHeader header;
+        if (!protocol::readFully(fd, &header, sizeof(header))) break;
+        if (header.magic != protocol::REQUEST_MAGIC ||
+            header.payloadSize > protocol::MAX_PAYLOAD_SIZE) {
+            std::cerr << "Malformed request, closing connection" << std::endl;
+            break;
+        }
+
+        std::vector<uchar> payload(header.payloadSize);
+        if (!protocol::readFully(fd, payload.data(), payload.size())) break;
+
+        PendingRequest request;
+        std::string error = decodeRequest(header, std::move(payload), request);
+
+        BatchScheduler::Result reply;
+        if (error.empty()) {
+            reply = scheduler.submit(request.image).get();
+        } else {
+            reply.analysis.errorMessage = error;
+        }
+
+        if (!sendResponse(fd, header.requestId, reply)) break;
+    }
+    close(fd);
+}
+
+// One line per interval, silent while idle
+void printMetrics(const BatchScheduler::Metrics& metrics, const BufferPool::Stats& buffers) {
+    if (metrics.requests == 0) return;
+    std::printf("requests %zu, batches %zu, mean batch %.2f, target %zu, "
+                "arrivals %.1f/s, queue %.2f ms (max %.2f), forward %.2f ms, "
+                "heap buffers %zu (pooled %zu)\n",
+                metrics.requests, metrics.batches, metrics.meanBatchSize,
+                metrics.targetBatchSize, metrics.arrivalRate, metrics.meanQueueTimeMs,
+                metrics.maxQueueTimeMs, metrics.meanForwardMs,
+                buffers.heapAllocations, buffers.pooledAllocations);
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ChestXRayAnalyzer::ModelConfig config;
+    std::string socketPath = protocol::DEFAULT_SOCKET_PATH;
+    BatchScheduler::Config schedulerConfig;
+    double maxWaitMs = 5.0;
+    double latencyTargetMs = 0.0;
+    int statsSeconds = 10;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--model") config.modelPath = value;
+        else if (option == "--config") config.configPath = value;
+        else if (option == "--socket") socketPath = value;
+        else if (option == "--max-batch") schedulerConfig.maxBatchSize = std::max(1, std::stoi(value));
+        else if (option == "--max-wait-ms") maxWaitMs = std::max(0.0, std::stod(value));
+        else if (option == "--latency-target-ms") latencyTargetMs = std::max(0.0, std::stod(value));
+        else if (option == "--stats-seconds") statsSeconds = std::max(0, std::stoi(value));
+        else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+    if (config.modelPath.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --model <onnx> [--config <json>] [--socket <path>]"
+                  << " [--max-batch <n>] [--max-wait-ms <ms>] [--latency-target-ms <ms>]"
+                  << " [--stats-seconds <s>]" << std::endl;
+        return 1;
+    }
+
+    BufferPool::instance().install();
+
+    ChestXRayAnalyzer analyzer;
+    try {
+        if (!analyzer.loadModel(config)) {
+            std::cerr << "Cannot load model " << config.modelPath << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // Clients disconnecting mid-response must not kill the daemon
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (listenFd < 0 || socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Cannot create socket " << socketPath << std::endl;
+        return 1;
+    }
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    schedulerConfig.maxWait = std::chrono::microseconds(static_cast<long long>(maxWaitMs * 1000.0));
+    schedulerConfig.latencyTarget =
+        std::chrono::microseconds(static_cast<long long>(latencyTargetMs * 1000.0));
+    BatchScheduler scheduler(analyzer, schedulerConfig);
+    std::cout << "Serving " << config.modelPath << " on " << socketPath
+              << " (max batch " << schedulerConfig.maxBatchSize
+              << ", max wait " << maxWaitMs << " ms)" << std::endl;
+
+    if (statsSeconds > 0) {
+        std::thread([&scheduler, statsSeconds]() {
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::seconds(statsSeconds));
+                printMetrics(scheduler.metrics(), BufferPool::instance().stats());
+                scheduler.resetMetrics();
+                BufferPool::instance().resetStats();
+            }
+        }).detach();
+    }
+
+    while (true) {
+        int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        std::thread(serveConnection, clientFd, std::ref(scheduler)).detach();
+    }
+
+    close(listenFd);
+    unlink(socketPath.c_str());
+    return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file orientation_check.cpp
+ * @brief Checks estimateOrientation against turned and inverted sample films
+ *
+ * Every chest film under the folder (ChestX-ray14 names, starting with a
+ * digit; the photos next to them are not films) is turned clockwise and
+ * counterclockwise, each also inverted, and the estimate must undo
+ * exactly that. Prints one line per case and exits with 1 on any miss.
+ *
+ * Usage: orientation_check [--data <dir>]
+ */
+
+#include "../include/medical_vision/orientation.hpp"
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using medical_vision::OrientationEstimate;
+
+int main(int argc, char* argv[]) {
+    std::string dataDir = "data/test_samples";
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--data" && i + 1 < argc) {
+            dataDir = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--data <dir>]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::string> files;
+    std::error_code error;
+    for (auto it = std::filesystem::directory_iterator(dataDir, error);
+         !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+        const std::string name = it->path().filename().string();
+        if (it->is_regular_file(error) && !name.empty() && std::isdigit(static_cast<unsigned char>(name[0])) &&
+            it->path().extension() == ".png") {
+            files.push_back(it->path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+        std::cerr << "No sample films found in " << dataDir << std::endl;
+        return 1;
+    }
+
+    // Rotation applied to the upright film and the quarter turns undoing it
+    struct Case {
+        const char* name;
+        int rotateCode;
+        int expectedTurns;
+    };
+    const Case cases[] = {
+        {"upright", -1, 0},
+        {"clockwise", cv::ROTATE_90_CLOCKWISE, 3},
+        {"counterclockwise", cv::ROTATE_90_COUNTERCLOCKWISE, 1},
+    };
+
+    int failures = 0;
+    for (const std::string& file : files) {
+        cv::Mat film = cv::imread(file, cv::IMREAD_GRAYSCALE);
+        if (film.empty()) {
+            std::cerr << "Cannot read " << file << std::endl;
+            ++failures;
+            continue;
+        }
+        for (const Case& test : cases) {
+            for (bool inverted : {false, true}) {
+                cv::Mat image = film;
+                if (test.rotateCode >= 0) cv::rotate(film, image, test.rotateCode);
+                if (inverted) cv::bitwise_not(image, image);
+
+                const OrientationEstimate estimate = medical_vision::estimateOrientation(image);
+                const bool ok = estimate.quarterTurns == test.expectedTurns && estimate.inverted == inverted;
+                failures += !ok;
+                std::cout << (ok ? "ok    " : "FAIL  ") << std::filesystem::path(file).filename().string()
+                          << ' ' << test.name << (inverted ? " inverted" : "")
+                          << ": turns " << estimate.quarterTurns << " (expected " << test.expectedTurns
+                          << "), inverted " << estimate.inverted
+                          << ", confidence rotation " << estimate.rotationConfidence
+                          << " direction " << estimate.directionConfidence
+                          << " inversion " << estimate.inversionConfidence << std::endl;
+            }
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file session_replay.cpp
+ * @brief Headless replay of GUI sessions recorded by MainWindow
+ *
+ * Drives the same ImagePreprocessor / FeatureDetector / Segmentation calls as
+ * MainWindow::processImage for every recorded event and reports latency
+ * percentiles per stage, next to the latencies measured in the recording,
+ * followed by the number of heap buffer allocations per run.
+ *
+ * Usage: session_replay <session.mvsl> [repetitions]
+ */
+
+#include "../include/medical_vision/buffer_pool.hpp"
+#include "../include/medical_vision/session_log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using medical_vision::SessionEvent;
+using medical_vision::SessionStage;
+
+namespace {
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(SessionStage::COUNT);
+
+// Latency samples per stage plus the end-to-end time of each event
+struct LatencySamples {
+    std::vector<std::vector<double>> stages = std::vector<std::vector<double>>(STAGE_COUNT);
+    std::vector<double> total;
+
+    void add(const SessionEvent::StageTimes& times, bool isNavigation) {
+        double sum = 0.0;
+        for (size_t i = 0; i < STAGE_COUNT; ++i) {
+            if (times[i] > 0.0f) {
+                stages[i].push_back(times[i]);
+                sum += times[i];
+            }
+        }
+        if (!isNavigation) {
+            total.push_back(sum);
+        }
+    }
+};
+
+template <typename Fn>
+float timeMs(Fn&& fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+// Same call sequence as MainWindow::processImage
+SessionEvent::StageTimes runSettings(const medical_vision::SessionSettings& settings,
+                                     medical_vision::ImagePreprocessor& processor,
+                                     medical_vision::FeatureDetector& featureDetector,
+                                     medical_vision::Segmentation& segmentation) {
+    SessionEvent::StageTimes times{};
+    auto slot = [&times](SessionStage stage) -> float& {
+        return times[static_cast<size_t>(stage)];
+    };
+
+    processor.reset();
+
+    if (settings.denoiseEnabled) {
+        slot(SessionStage::DENOISE) = timeMs([&] { processor.denoise(settings.denoiseMethod); });
+    }
+    if (settings.claheEnabled) {
+        slot(SessionStage::CLAHE) = timeMs([&] {
+            processor.histogramProcessing(
+                medical_vision::ImagePreprocessor::HistogramMethod::CLAHE);
+        });
+    }
+    if (settings.sharpenEnabled) {
+        slot(SessionStage::SHARPEN) = timeMs([&] { processor.sharpen(settings.sharpenStrength); });
+    }
+
+    cv::Mat displayImage = processor.getImage().clone();
+
+    if (settings.edgesEnabled) {
+        slot(SessionStage::EDGES) = timeMs([&] {
+            featureDetector.detectEdges(displayImage, settings.edgeMethod, settings.edgeParams);
+        });
+    }
+    if (settings.keypointsEnabled) {
+        slot(SessionStage::KEYPOINTS) = timeMs([&] {
+            auto keypoints = featureDetector.detectKeypoints(
+                displayImage, settings.keypointMethod, settings.keypointParams);
+            displayImage = featureDetector.drawKeypoints(displayImage, keypoints);
+        });
+    }
+    if (settings.segmentationEnabled) {
+        slot(SessionStage::SEGMENTATION) = timeMs([&] {
+            segmentation.segment(displayImage, settings.segmentationMethod);
+        });
+    }
+
+    return times;
+}
+
+void printReport(const std::string& title, const LatencySamples& samples) {
+    std::printf("\n%s\n", title.c_str());
+    std::printf("%-14s %8s %10s %10s %10s %10s\n", "stage", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+    auto printRow = [](const char* name, const std::vector<double>& values) {
+        if (values.empty()) return;
+        std::printf("%-14s %8zu %10.2f %10.2f %10.2f %10.2f\n", name, values.size(),
+                    percentile(values, 0.50), percentile(values, 0.90),
+                    percentile(values, 0.99), percentile(values, 1.0));
+    };
+
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        printRow(medical_vision::sessionStageName(static_cast<SessionStage>(i)), samples.stages[i]);
+    }
+    printRow("processing", samples.total);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <session.mvsl> [repetitions]" << std::endl;
+        return 1;
+    }
+
+    std::vector<SessionEvent> events;
+    try {
+        events = medical_vision::readSessionLog(argv[1]);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 1;
+
+    auto& bufferPool = medical_vision::BufferPool::instance();
+    bufferPool.install();
+
+    medical_vision::ImagePreprocessor processor;
+    medical_vision::FeatureDetector featureDetector;
+    medical_vision::Segmentation segmentation;
+
+    LatencySamples recorded;
+    LatencySamples replayed;
+    for (const auto& event : events) {
+        recorded.add(event.stageTimes, event.type == SessionEvent::Type::NAVIGATION);
+    }
+
+    // Heap buffer allocations of each run, after the first one a replay
+    // of same-size images should be served from the pool
+    std::vector<size_t> heapAllocations;
+    for (int r = 0; r < repetitions; ++r) {
+        bufferPool.resetStats();
+        for (const auto& event : events) {
+            SessionEvent::StageTimes times{};
+            try {
+                if (event.type == SessionEvent::Type::NAVIGATION) {
+                    bool loaded = false;
+                    times[static_cast<size_t>(SessionStage::LOAD)] =
+                        timeMs([&] { loaded = processor.loadImage(event.imagePath); });
+                    if (!loaded) {
+                        std::cerr << "Failed to load image: " << event.imagePath << std::endl;
+                    }
+                } else if (processor.isLoaded()) {
+                    times = runSettings(event.settings, processor, featureDetector, segmentation);
+                }
+            }
+            catch (const std::exception& e) {
+                // The GUI reports these too and goes on with the session
+                std::cerr << "Replay error: " << e.what() << std::endl;
+            }
+            replayed.add(times, event.type == SessionEvent::Type::NAVIGATION);
+        }
+        heapAllocations.push_back(bufferPool.stats().heapAllocations);
+    }
+
+    std::printf("Session: %s (%zu events", argv[1], events.size());
+    if (!events.empty()) {
+        std::printf(", %.1f s recorded", events.back().timestamp);
+    }
+    std::printf(")\n");
+
+    printReport("Recorded latencies", recorded);
+    printReport("Replayed latencies (" + std::to_string(repetitions) + " run(s))", replayed);
+
+    std::printf("\nHeap buffer allocations: %zu in the first run", heapAllocations.front());
+    if (heapAllocations.size() > 1) {
+        std::printf(", %zu in the last", heapAllocations.back());
+    }
+    std::printf(" (%.1f MiB pooled)\n", bufferPool.stats().cachedBytes / (1024.0 * 1024.0));
+    return 0;
+}
@@ -0,0 +1,477 @@
+/**
+ * @file throughput_bench.cpp
+ * @brief End-to-end throughput benchmark of the production path
+ *
+ * Replicates the images of a sample folder up to --images inputs and runs
+ * each through decode, the ImagePreprocessor chain (normalize, CLAHE,
+ * sharpen), Segmentation::otsuThreshold and ChestXRayAnalyzer::analyze,
+ * with 1, 2, 4, ... up to --max-threads images in flight. cv::setNumThreads
+ * is set to the same count, so the library's thread pool is sized with it.
+ * Every run reports images/sec, latency percentiles, peak RSS and buffer
+ * allocations as JSON on stdout or in --output.
+ *
+ * With --roi every thread count runs a second time restricted to the
+ * lungs: Segmentation::lungMask bounds the preprocessing region, the Otsu
+ * segmentation and the analyzed region, and the report gives the share of
+ * pixels kept and the time saved against the full frame run.
+ *
+ * With --store, the distinct samples are then processed once more,
+ * untimed, and their hashes, scores for every pathology (threshold 0),
+ * segmentation masks and ORB keypoints are appended to a feature store.
+ *
+ * Inputs are processed in the same order on every run and each worker
+ * processes the distinct samples once before timing starts, so results
+ * are comparable between builds on the same machine.
+ *
+ * Usage: throughput_bench [--data <dir>] [--images <n>] [--max-threads <n>]
+ *                         [--model <onnx>] [--config <json>] [--no-analyze]
+ *                         [--crop] [--roi] [--store <file>] [--output <json>]
+ */
+
+#include "../include/medical_vision/buffer_pool.hpp"
+#include "../include/medical_vision/chest_x_ray_analyzer.hpp"
+#include "../include/medical_vision/cpu_dispatch.hpp"
+#include "../include/medical_vision/duplicate_index.hpp"
+#include "../include/medical_vision/feature_detector.hpp"
+#include "../include/medical_vision/feature_store.hpp"
+#include "../include/medical_vision/image_preprocessor.hpp"
+#include "../include/medical_vision/segmentation.hpp"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using medical_vision::BufferPool;
+using medical_vision::ChestXRayAnalyzer;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum Stage { DECODE, ROI, PREPROCESS, SEGMENT, ANALYZE, STAGE_COUNT };
+const char* STAGE_NAMES[STAGE_COUNT] = { "decode", "roi", "preprocess", "segment", "analyze" };
+
+// Context kept around the lungs, in pixels
+constexpr int LUNG_MARGIN = 16;
+
+struct Options {
+    std::string dataDir = "data/test_samples";
+    int images = 2000;
+    int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::string modelPath = "data/models/densenet/densenet121.onnx";
+    std::string configPath = "data/models/densenet/densenet121-config.json";
+    bool analyze = true;
+    bool crop = false;          // ImagePreprocessor::autoCrop after decoding
+    bool roi = false;           // Also run restricted to the lungs
+    std::string storePath;      // Feature store filled after the runs
+    std::string outputPath;
+};
+
+// Timings of one image, in milliseconds
+struct Sample {
+    double stages[STAGE_COUNT]{};
+    double total{0.0};
+    double pixelFraction{1.0};  // Region pixels over image pixels
+    bool failed{false};
+};
+
+// Everything one image in flight needs, created before timing starts
+struct Worker {
+    medical_vision::ImagePreprocessor processor;
+    medical_vision::Segmentation segmentation;
+    medical_vision::FeatureDetector detector;
+    ChestXRayAnalyzer analyzer;
+};
+
+struct RunResult {
+    int threads{0};
+    bool roi{false};
+    double seconds{0.0};
+    std::vector<Sample> samples;
+    size_t peakRssBytes{0};
+    BufferPool::Stats allocations;
+};
+
+double elapsedMs(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+// Starts a new peak measurement where the OS allows it (Linux only)
+void resetPeakRss() {
+#if defined(__linux__)
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+}
+
+size_t peakRssBytes() {
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoull(line.substr(6)) * 1024;
+        }
+    }
+    return 0;
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#elif defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss);    // Bytes on macOS
+#elif defined(__unix__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#else
+    return 0;
+#endif
+}
+
+// The production path for one image, with roi restricted to the lungs.
+// With a record, also collects what the feature store keeps (untimed use).
+Sample processImage(Worker& worker, const std::string& path, const Options& options, bool roi,
+                    medical_vision::FeatureRecord* record = nullptr) {
+    Sample sample;
+    auto start = Clock::now();
+    auto mark = start;
+    auto lap = [&mark](double& slot) {
+        auto now = Clock::now();
+        slot = elapsedMs(mark, now);
+        mark = now;
+    };
+
+    try {
+        if (!worker.processor.loadImage(path)) {
+            sample.failed = true;
+            return sample;
+        }
+        if (options.crop) {
+            worker.processor.autoCrop();
+        }
+        lap(sample.stages[DECODE]);
+
+        // Empty when no lungs are found, which means the full frame
+        cv::Rect region;
+        cv::Mat lungs;
+        if (roi) {
+            lungs = worker.segmentation.lungMask(worker.processor.getImage());
+            worker.processor.setRegionOfInterest(lungs, LUNG_MARGIN);
+            region = worker.processor.getRegionOfInterest();
+            const cv::Size size = worker.processor.getImage().size();
+            if (!region.empty()) {
+                sample.pixelFraction = static_cast<double>(region.area()) / size.area();
+            }
+            lap(sample.stages[ROI]);
+        }
+
+        worker.processor.normalize();
+        worker.processor.clahe(2.0);
+        worker.processor.sharpen(1.2);
+        lap(sample.stages[PREPROCESS]);
+
+        const cv::Mat& image = worker.processor.getImage();
+        cv::Mat mask = worker.segmentation.otsuThreshold(region.empty() ? image : image(region));
+        lap(sample.stages[SEGMENT]);
+
+        std::vector<ChestXRayAnalyzer::Detection> detections;
+        if (options.analyze) {
+            auto result = worker.analyzer.analyze(image, region);
+            sample.failed = !result.success;
+            detections = std::move(result.detections);
+            lap(sample.stages[ANALYZE]);
+        }
+
+        if (record) {
+            record->imageId = path;
+            record->hashes = medical_vision::computeImageHashes(image);
+            record->setPredictions(detections, worker.analyzer.getAvailablePathologies());
+            if (region.empty()) {
+                record->mask = mask;
+            } else {
+                record->mask = cv::Mat::zeros(image.size(), CV_8UC1);
+                mask.copyTo(record->mask(region));
+            }
+            record->keypoints = worker.detector.detectKeypoints(
+                image, medical_vision::FeatureDetector::KeypointDetector::ORB,
+                medical_vision::FeatureDetector::KeypointParams(), lungs);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << path << ": " << e.what() << std::endl;
+        sample.failed = true;
+    }
+    sample.total = elapsedMs(start, Clock::now());
+    return sample;
+}
+
+RunResult runBenchmark(const Options& options, const std::vector<std::string>& files,
+                       std::vector<std::unique_ptr<Worker>>& workers, int threads, bool roi) {
+    cv::setNumThreads(threads);
+
+    // Warm up every worker on the distinct samples: models, caches and
+    // the buffer pool reach their steady state before timing starts
+    for (int t = 0; t < threads; ++t) {
+        for (const auto& file : files) {
+            processImage(*workers[t], file, options, roi);
+        }
+    }
+
+    RunResult result;
+    result.threads = threads;
+    result.roi = roi;
+    result.samples.resize(options.images);
+
+    BufferPool::instance().resetStats();
+    resetPeakRss();
+
+    std::atomic<int> next{0};
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            for (int i = next++; i < options.images; i = next++) {
+                result.samples[i] = processImage(*workers[t], files[i % files.size()], options, roi);
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    result.peakRssBytes = peakRssBytes();
+    result.allocations = BufferPool::instance().stats();
+    return result;
+}
+
+std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void writeReport(std::ostream& out, const Options& options, size_t sampleCount,
+                 const std::vector<RunResult>& runs) {
+    char number[64];
+    auto fixed = [&number](double value) {
+        std::snprintf(number, sizeof(number), "%.3f", value);
+        return std::string(number);
+    };
+
+    out << "{\n";
+    out << "  \"dataset\": { \"path\": " << jsonString(options.dataDir)
+        << ", \"samples\": " << sampleCount << ", \"images\": " << options.images << " },\n";
+    out << "  \"environment\": { \"opencv\": " << jsonString(CV_VERSION)
+        << ", \"cpu_level\": " << jsonString(medical_vision::cpuLevelName(medical_vision::cpuLevel()))
+        << ", \"hardware_threads\": " << std::thread::hardware_concurrency() << " },\n";
+    out << "  \"analyze\": " << (options.analyze ? "true" : "false") << ",\n";
+    out << "  \"crop\": " << (options.crop ? "true" : "false") << ",\n";
+    out << "  \"roi\": " << (options.roi ? "true" : "false") << ",\n";
+    out << "  \"runs\": [\n";
+
+    for (size_t r = 0; r < runs.size(); ++r) {
+        const RunResult& run = runs[r];
+        std::vector<double> totals;
+        std::vector<std::vector<double>> stages(STAGE_COUNT);
+        size_t failed = 0;
+        double pixelFraction = 0.0;
+        for (const Sample& sample : run.samples) {
+            if (sample.failed) {
+                ++failed;
+                continue;
+            }
+            totals.push_back(sample.total);
+            pixelFraction += sample.pixelFraction;
+            for (int s = 0; s < STAGE_COUNT; ++s) {
+                stages[s].push_back(sample.stages[s]);
+            }
+        }
+
+        out << "    {\n";
+        out << "      \"threads\": " << run.threads << ",\n";
+        out << "      \"roi\": " << (run.roi ? "true" : "false") << ",\n";
+        if (run.roi) {
+            // Against the full frame run with as many threads, just before
+            const RunResult& full = runs[r - 1];
+            out << "      \"roi_pixel_fraction\": "
+                << fixed(totals.empty() ? 0.0 : pixelFraction / totals.size()) << ",\n";
+            out << "      \"roi_time_saved_fraction\": "
+                << fixed(full.seconds > 0.0 ? 1.0 - run.seconds / full.seconds : 0.0) << ",\n";
+        }
+        out << "      \"failed\": " << failed << ",\n";
+        out << "      \"seconds\": " << fixed(run.seconds) << ",\n";
+        out << "      \"images_per_second\": "
+            << fixed(run.seconds > 0.0 ? totals.size() / run.seconds : 0.0) << ",\n";
+        out << "      \"latency_ms\": { \"p50\": " << fixed(percentile(totals, 0.50))
+            << ", \"p99\": " << fixed(percentile(totals, 0.99))
+            << ", \"max\": " << fixed(percentile(totals, 1.0)) << " },\n";
+        out << "      \"stage_p50_ms\": {";
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            if ((s == ANALYZE && !options.analyze) || (s == ROI && !run.roi)) continue;
+            out << (s ? ", " : " ") << "\"" << STAGE_NAMES[s] << "\": " << fixed(percentile(stages[s], 0.50));
+        }
+        out << " },\n";
+        out << "      \"peak_rss_bytes\": " << run.peakRssBytes << ",\n";
+        out << "      \"heap_allocations\": " << run.allocations.heapAllocations << ",\n";
+        out << "      \"pooled_allocations\": " << run.allocations.pooledAllocations << "\n";
+        out << "    }" << (r + 1 < runs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--no-analyze") {
+            options.analyze = false;
+            continue;
+        }
+        if (option == "--crop") {
+            options.crop = true;
+            continue;
+        }
+        if (option == "--roi") {
+            options.roi = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Usage: " << argv[0] << " [--data <dir>] [--images <n>] [--max-threads <n>]"
+                      << " [--model <onnx>] [--config <json>] [--no-analyze] [--crop] [--roi]"
+                      << " [--store <file>] [--output <json>]"
+                      << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--data") options.dataDir = value;
+        else if (option == "--images") options.images = std::max(1, std::stoi(value));
+        else if (option == "--max-threads") options.maxThreads = std::max(1, std::stoi(value));
+        else if (option == "--model") options.modelPath = value;
+        else if (option == "--config") options.configPath = value;
+        else if (option == "--output") options.outputPath = value;
+        else if (option == "--store") options.storePath = value;
+        else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    // Sorted so every run sees the images in the same order
+    std::vector<std::string> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(options.dataDir, error)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+            extension == ".tif" || extension == ".tiff" || extension == ".dcm") {
+            files.push_back(entry.path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+        std::cerr << "No images found in " << options.dataDir << std::endl;
+        return 1;
+    }
+
+    BufferPool::instance().install();
+
+    ChestXRayAnalyzer::ModelConfig modelConfig;
+    modelConfig.modelPath = options.modelPath;
+    modelConfig.configPath = options.configPath;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<RunResult> runs;
+    try {
+        for (int threads = 1; ; threads = std::min(threads * 2, options.maxThreads)) {
+            while (static_cast<int>(workers.size()) < threads) {
+                workers.push_back(std::make_unique<Worker>());
+                if (options.analyze && !workers.back()->analyzer.loadModel(modelConfig)) {
+                    std::cerr << "Cannot load model " << options.modelPath
+                              << ", use --no-analyze to benchmark preprocessing only" << std::endl;
+                    return 1;
+                }
+            }
+            std::cerr << "Running " << options.images << " images on " << threads << " thread(s)" << std::endl;
+            runs.push_back(runBenchmark(options, files, workers, threads, false));
+            if (options.roi) {
+                std::cerr << "Running " << options.images << " images on " << threads
+                          << " thread(s), lungs only" << std::endl;
+                runs.push_back(runBenchmark(options, files, workers, threads, true));
+            }
+            if (threads == options.maxThreads) break;
+        }
+
+        if (!options.storePath.empty()) {
+            // Every score is kept, thresholds are chosen later from the store
+            Worker& worker = *workers.front();
+            worker.analyzer.setConfidenceThreshold(0.0f);
+            medical_vision::FeatureStoreWriter store(options.storePath,
+                                                     worker.analyzer.getAvailablePathologies());
+            for (const auto& file : files) {
+                medical_vision::FeatureRecord record;
+                if (!processImage(worker, file, options, options.roi, &record).failed) {
+                    store.append(record);
+                }
+            }
+            store.flush();
+            std::cerr << "Stored " << store.size() << " records in " << options.storePath << std::endl;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (options.outputPath.empty()) {
+        writeReport(std::cout, options, files.size(), runs);
+    } else {
+        std::ofstream out(options.outputPath);
+        writeReport(out, options, files.size(), runs);
+        if (!out) {
+            std::cerr << "Cannot write " << options.outputPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}